@@ -1,30 +1,22 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
-#include "oled.h"
 #include "menu.h"
-#include "joystick.h" 
-#include "hardware/rtc.h"
-#include "hardware/gpio.h"
-#include "rtc.h"
-#include "buzzer.h"
-#include "matrix.h"
-#include "wifi_time.h"
+#include "boot.h"
+#include "console.h"
+#include "telemetry.h"
+#include "time_link.h"
+#include "net.h"
 
 int main() {
-    stdio_init_all();
-    oled_init();
-    oled_display_text("Initializing\n\n     Alarm", 12, 20);
-    joystick_init();
-    rtc_init_custom();
-    buzzer_init();  // Initialize buzzer
-    matrix_init();  // Initialize LED matrix
-    wifi_time_init();  // Initialize WiFi and fetch time
-    oled_clear();
-    rtc_set_time(0, 0, 0, 0, 0, 0);
-    
+    boot_run(); // UI peripherals up, Wi-Fi/NTP continue in the background
+
     while (1) {
         menu_navigation(); // Keeps the menu running
         check_alarm();     // Check for alarm
         update_time_display(); // Update time display
+        console_poll();    // Diagnostic commands over USB
+        telemetry_poll();  // Loop latency and periodic metrics for MQTT
+        time_link_poll();  // Time frames from the UART link, if enabled
+        net_poll();        // Deferred flash writes of the network side
     }
 }
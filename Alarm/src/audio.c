@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+
+#include "audio.h"
+#include "buzzer.h"
+
+// 256 samples per block: 16 ms at 16 kHz between decode bursts
+#define AUDIO_BLOCK_SAMPLES 256
+#define AUDIO_PWM_WRAP 255      // 8-bit levels, ~488 kHz carrier at 125 MHz
+#define AUDIO_DMA_IRQ DMA_IRQ_1
+
+typedef struct {
+    int32_t predictor;
+    int32_t index;
+} ima_state_t;
+
+static const int16_t ima_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t ima_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static uint audio_slice;
+static uint level_shift;              // 0 for PWM channel A, 16 for B
+static uint32_t cc_keep;              // Other channel's level, rewritten unchanged
+static int dma_chan[2] = { -1, -1 };
+static int dma_timer = -1;
+
+// Ping-pong buffers of ready-made CC register values
+static uint32_t buffers[2][AUDIO_BLOCK_SAMPLES];
+
+// Playback state (touched by the DMA IRQ while playing)
+static const sound_clip_t *clip = NULL;
+static uint32_t next_sample = 0;
+static ima_state_t ima;
+static volatile bool playing = false;
+static volatile int final_buffer = -1; // Buffer holding the last real samples
+
+// Decode load accounting
+static uint32_t decode_us_total = 0;
+static uint32_t decode_us_peak = 0;
+static uint32_t blocks_decoded = 0;
+
+static inline int32_t ima_decode(ima_state_t *st, uint8_t nibble) {
+    int32_t step = ima_step_table[st->index];
+    int32_t diff = step >> 3;
+
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    st->predictor += (nibble & 8) ? -diff : diff;
+    if (st->predictor > 32767) st->predictor = 32767;
+    if (st->predictor < -32768) st->predictor = -32768;
+
+    st->index += ima_index_table[nibble];
+    if (st->index < 0) st->index = 0;
+    if (st->index > 88) st->index = 88;
+    return st->predictor;
+}
+
+// Decodes the next block into a buffer, padding with silence at the end.
+// Returns the number of real samples written.
+static uint fill_block(uint32_t *buf) {
+    uint32_t start = time_us_32();
+    uint count = 0;
+
+    while (count < AUDIO_BLOCK_SAMPLES && next_sample < clip->num_samples) {
+        uint32_t level;
+        if (clip->format == SOUND_FORMAT_PCM8) {
+            level = clip->data[next_sample];
+        } else {
+            uint8_t byte = clip->data[next_sample >> 1];
+            uint8_t nibble = (next_sample & 1) ? (byte >> 4) : (byte & 0x0F);
+            level = (uint32_t)((ima_decode(&ima, nibble) >> 8) + 128);
+        }
+        buf[count++] = (level << level_shift) | cc_keep;
+        next_sample++;
+    }
+    for (uint i = count; i < AUDIO_BLOCK_SAMPLES; i++) {
+        buf[i] = cc_keep; // Silence
+    }
+
+    uint32_t elapsed = time_us_32() - start;
+    decode_us_total += elapsed;
+    if (elapsed > decode_us_peak) decode_us_peak = elapsed;
+    blocks_decoded++;
+    return count;
+}
+
+// Refills one ping-pong buffer, remembering which one carries the end of
+// the clip. Once the clip is exhausted the buffers just get silence.
+static void refill(int i) {
+    if (final_buffer >= 0) {
+        fill_block(buffers[i]);
+    } else if (fill_block(buffers[i]) < AUDIO_BLOCK_SAMPLES) {
+        final_buffer = i;
+    }
+}
+
+// RP2040-E13: aborting a channel that chains to another can start the other
+// one and raise its IRQ anyway. Point each channel's chain at itself and
+// mask the IRQs first, abort both at once, then clear what got raised.
+static void audio_halt(void) {
+    for (int i = 0; i < 2; i++) {
+        dma_channel_set_irq1_enabled(dma_chan[i], false);
+        hw_write_masked(&dma_hw->ch[dma_chan[i]].al1_ctrl,
+                        (uint32_t)dma_chan[i] << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB,
+                        DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS);
+    }
+    uint32_t mask = (1u << dma_chan[0]) | (1u << dma_chan[1]);
+    dma_hw->abort = mask;
+    while (dma_hw->abort & mask) {
+        tight_loop_contents();
+    }
+    for (int i = 0; i < 2; i++) {
+        dma_channel_acknowledge_irq1(dma_chan[i]);
+    }
+    pwm_set_gpio_level(BUZZER_PIN, 0);
+    playing = false;
+}
+
+// One buffer finished and the chain already moved to the other one:
+// refill this one and rewind its read pointer.
+static void audio_dma_irq_handler(void) {
+    for (int i = 0; i < 2; i++) {
+        if (dma_chan[i] < 0 || !dma_channel_get_irq1_status(dma_chan[i])) continue;
+        dma_channel_acknowledge_irq1(dma_chan[i]);
+        if (!playing) continue;
+
+        if (final_buffer == i) {
+            audio_halt(); // Last samples are out
+            return;
+        }
+        refill(i);
+        dma_channel_set_read_addr(dma_chan[i], buffers[i], false);
+    }
+}
+
+static void configure_channel(int index, uint32_t transfer_dreq) {
+    uint ch = dma_chan[index];
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, transfer_dreq);
+    channel_config_set_chain_to(&c, dma_chan[index ^ 1]);
+    dma_channel_configure(ch, &c, &pwm_hw->slice[audio_slice].cc, buffers[index],
+                          AUDIO_BLOCK_SAMPLES, false);
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Timer rate is clk_sys * num / den with 16-bit num/den
+static void set_sample_rate(uint32_t rate) {
+    uint32_t sys = clock_get_hz(clk_sys);
+    uint32_t g = gcd(rate, sys);
+    uint32_t num = rate / g;
+    uint32_t den = sys / g;
+
+    if (num > 0xFFFF || den > 0xFFFF) {
+        num = (uint32_t)(((uint64_t)rate * 0xFFFF + sys / 2) / sys);
+        den = 0xFFFF;
+    }
+    dma_timer_set_fraction(dma_timer, num, den);
+}
+
+void audio_init(void) {
+    audio_slice = pwm_gpio_to_slice_num(BUZZER_PIN);
+    level_shift = pwm_gpio_to_channel(BUZZER_PIN) == PWM_CHAN_B ? 16 : 0;
+    dma_chan[0] = dma_claim_unused_channel(true);
+    dma_chan[1] = dma_claim_unused_channel(true);
+    dma_timer = dma_claim_unused_timer(true);
+
+    irq_add_shared_handler(AUDIO_DMA_IRQ, audio_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(AUDIO_DMA_IRQ, true);
+}
+
+bool audio_play(const sound_clip_t *new_clip) {
+    if (dma_timer < 0 || new_clip == NULL || new_clip->num_samples == 0) return false;
+
+    audio_stop();
+    buzzer_stop();
+
+    clip = new_clip;
+    next_sample = 0;
+    ima.predictor = 0;
+    ima.index = 0;
+    final_buffer = -1;
+    decode_us_total = 0;
+    decode_us_peak = 0;
+    blocks_decoded = 0;
+
+    // The DMA writes the whole CC register; carry the other channel's level
+    // along so a clip only ever changes the buzzer channel
+    cc_keep = pwm_hw->slice[audio_slice].cc & (0xFFFFu << (16 - level_shift));
+
+    // Prime both buffers before the first DREQ
+    refill(0);
+    refill(1);
+
+    pwm_set_clkdiv_int_frac(audio_slice, 1, 0);
+    pwm_set_wrap(audio_slice, AUDIO_PWM_WRAP);
+    set_sample_rate(clip->sample_rate);
+
+    uint dreq = dma_get_timer_dreq(dma_timer);
+    configure_channel(0, dreq);
+    configure_channel(1, dreq);
+    dma_channel_acknowledge_irq1(dma_chan[0]);
+    dma_channel_acknowledge_irq1(dma_chan[1]);
+    dma_channel_set_irq1_enabled(dma_chan[0], true);
+    dma_channel_set_irq1_enabled(dma_chan[1], true);
+
+    playing = true;
+    dma_channel_start(dma_chan[0]);
+    return true;
+}
+
+void audio_stop(void) {
+    if (playing) {
+        audio_halt();
+    }
+}
+
+bool audio_is_playing(void) {
+    return playing;
+}
+
+void audio_print_stats(void) {
+    if (clip == NULL || blocks_decoded == 0) {
+        printf("Audio: nothing played yet\n");
+        return;
+    }
+
+    // Time budget per block is the time the DMA takes to drain it
+    uint32_t block_us = (uint32_t)((uint64_t)AUDIO_BLOCK_SAMPLES * 1000000 / clip->sample_rate);
+    uint32_t avg_us = decode_us_total / blocks_decoded;
+    printf("Audio '%s': %u blocks, decode avg %u us / peak %u us per %u us block (%u.%u%% CPU)\n",
+           clip->name, (unsigned)blocks_decoded, (unsigned)avg_us, (unsigned)decode_us_peak,
+           (unsigned)block_us, (unsigned)(avg_us * 100 / block_us),
+           (unsigned)((avg_us * 1000 / block_us) % 10));
+}
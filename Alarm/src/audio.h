@@ -0,0 +1,22 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdbool.h>
+#include "sounds.h"
+
+// Sampled audio on the buzzer pin: the PWM compare register is fed by DMA
+// at the clip's sample rate, and clips are decoded from flash block by
+// block in the DMA completion IRQ.
+
+// Claims the DMA channels and pacing timer (call after buzzer_init)
+void audio_init(void);
+
+// Starts a clip in the background (stops any tone melody first)
+bool audio_play(const sound_clip_t *clip);
+void audio_stop(void);
+bool audio_is_playing(void);
+
+// Prints decode CPU load for the last clip (console key 'a')
+void audio_print_stats(void);
+
+#endif // AUDIO_H
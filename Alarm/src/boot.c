@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "boot.h"
+#include "console.h"
+#include "oled.h"
+#include "joystick.h"
+#include "input.h"
+#include "debounce.h"
+#include "rtc.h"
+#include "buzzer.h"
+#include "audio.h"
+#include "matrix.h"
+#include "led_fx.h"
+#include "net.h"
+#include "time_link.h"
+
+#define CORE1_BOOT_DONE 0xB007u
+
+typedef struct {
+    const char *name;
+    uint64_t start_us;
+    uint64_t end_us;
+    uint8_t core;
+} boot_stage_info_t;
+
+static boot_stage_info_t stages[BOOT_STAGE_COUNT] = {
+    [BOOT_STAGE_STDIO]        = { "stdio" },
+    [BOOT_STAGE_OLED]         = { "oled" },
+    [BOOT_STAGE_JOYSTICK]     = { "joystick" },
+    [BOOT_STAGE_RTC]          = { "rtc" },
+    [BOOT_STAGE_BUZZER]       = { "buzzer" },
+    [BOOT_STAGE_MATRIX]       = { "matrix" },
+    [BOOT_STAGE_WIFI_INIT]    = { "wifi init" },
+    [BOOT_STAGE_UI_READY]     = { "ui ready" },
+    [BOOT_STAGE_WIFI_CONNECT] = { "wifi connect" },
+    [BOOT_STAGE_NTP_SYNC]     = { "ntp sync" },
+};
+
+void boot_stage_begin(boot_stage_t stage) {
+    stages[stage].start_us = time_us_64();
+    stages[stage].end_us = 0;
+    stages[stage].core = get_core_num();
+}
+
+void boot_stage_end(boot_stage_t stage) {
+    stages[stage].end_us = time_us_64();
+}
+
+void boot_report_print(void) {
+    printf("Boot stages (us since reset):\n");
+    printf("  %-13s core %10s %10s %10s\n", "stage", "start", "end", "duration");
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        const boot_stage_info_t *s = &stages[i];
+        if (s->start_us == 0) {
+            printf("  %-13s   -  %10s\n", s->name, "not run");
+        } else if (s->end_us == 0) {
+            printf("  %-13s   %d  %10llu %10s\n", s->name, s->core, s->start_us, "running");
+        } else {
+            printf("  %-13s   %d  %10llu %10llu %10llu\n", s->name, s->core,
+                   s->start_us, s->end_us, s->end_us - s->start_us);
+        }
+    }
+}
+
+static void play_chime(void) {
+    audio_play(&sound_clips[SOUND_CHIME]);
+}
+
+// Core 1: the display only needs I2C, so it comes up while core 0 loads
+// the CYW43 firmware. No IRQs are enabled here, core 1 is reset afterwards.
+static void core1_boot(void) {
+    boot_stage_begin(BOOT_STAGE_OLED);
+    oled_init();
+    oled_display_text("Initializing\n\n     Alarm", 12, 20);
+    boot_stage_end(BOOT_STAGE_OLED);
+
+    multicore_fifo_push_blocking(CORE1_BOOT_DONE);
+    while (1) {
+        tight_loop_contents();
+    }
+}
+
+void boot_run(void) {
+    boot_stage_begin(BOOT_STAGE_STDIO);
+    stdio_init_all();
+    boot_stage_end(BOOT_STAGE_STDIO);
+
+    multicore_launch_core1(core1_boot);
+
+    boot_stage_begin(BOOT_STAGE_JOYSTICK);
+    joystick_init();
+    input_init();
+    boot_stage_end(BOOT_STAGE_JOYSTICK);
+
+    boot_stage_begin(BOOT_STAGE_RTC);
+    rtc_init_custom();
+    rtc_set_time(2025, 1, 1, 0, 0, 0); // Placeholder until NTP arrives
+    boot_stage_end(BOOT_STAGE_RTC);
+
+    boot_stage_begin(BOOT_STAGE_BUZZER);
+    buzzer_init();
+    audio_init();
+    boot_stage_end(BOOT_STAGE_BUZZER);
+
+    boot_stage_begin(BOOT_STAGE_MATRIX);
+    matrix_init();
+    led_fx_init();
+    boot_stage_end(BOOT_STAGE_MATRIX);
+
+    boot_stage_begin(BOOT_STAGE_WIFI_INIT);
+    net_start(); // Connect + NTP continue in the background
+    boot_stage_end(BOOT_STAGE_WIFI_INIT);
+
+#if ALARM_TIME_LINK
+    time_link_start(); // Serves or follows the clock over UART0 + PPS
+#endif
+
+    // Join core 1 and free it for later use
+    multicore_fifo_pop_blocking();
+    multicore_reset_core1();
+
+    oled_clear();
+    console_register('b', "boot stage timing report", boot_report_print);
+    console_register('c', "play the chime clip", play_chime);
+    console_register('a', "audio decode CPU load", audio_print_stats);
+    console_register('e', "button edge counters", debounce_print_stats);
+    net_register_console();
+#if ALARM_TIME_LINK
+    console_register('l', "UART time link status", time_link_print_stats);
+#endif
+
+    boot_stage_begin(BOOT_STAGE_UI_READY);
+    boot_stage_end(BOOT_STAGE_UI_READY);
+}
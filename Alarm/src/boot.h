@@ -0,0 +1,32 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+
+// Startup stages, in the order they are reported
+typedef enum {
+    BOOT_STAGE_STDIO,
+    BOOT_STAGE_OLED,        // core 1, overlaps the core 0 stages below
+    BOOT_STAGE_JOYSTICK,
+    BOOT_STAGE_RTC,
+    BOOT_STAGE_BUZZER,
+    BOOT_STAGE_MATRIX,
+    BOOT_STAGE_WIFI_INIT,   // CYW43 firmware download
+    BOOT_STAGE_UI_READY,
+    BOOT_STAGE_WIFI_CONNECT, // background
+    BOOT_STAGE_NTP_SYNC,     // background
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+// Records the start/end of a stage (time_us_64 timestamps)
+void boot_stage_begin(boot_stage_t stage);
+void boot_stage_end(boot_stage_t stage);
+
+// Prints the per-stage start/end table (console key 'b')
+void boot_report_print(void);
+
+// Brings up every peripheral, overlapping independent inits, and returns
+// as soon as the UI can run. Wi-Fi and NTP continue in the background.
+void boot_run(void);
+
+#endif // BOOT_H
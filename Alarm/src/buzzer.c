@@ -1,76 +1,151 @@
 #include "buzzer.h"
+#include "audio.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
 #include <stdio.h>
 
 #define BUZZER_PIN 21  // Define the pin for the buzzer
+#define NOTE_GAP_MS 50 // Silence between notes
 
-// Ringtones
-static const uint ringtone1[] = {262, 294, 330, 349, 392, 440, 494, 523}; // Simple scale
-static const uint ringtone2[] = {659, 698, 784, 880, 988}; // Higher tones
-static const uint ringtone3[] = {330, 330, 330, 262, 392, 523, 330}; // Short Star Wars melody
+// Ringtones come from ringtones/*.rtttl, compiled by tools/rtttl2c.py into
+// per-note PWM wrap/level records for RINGTONE_SYS_CLK_HZ.
 
-// Note durations (uniform for all ringtones)
-static const uint note_durations[] = {200, 200, 200, 200, 200, 200, 200, 200};
+// Sequencer state, advanced from the alarm IRQ
+static uint buzzer_slice;
+static uint buzzer_channel;
+static const ringtone_t *seq_tune = NULL;
+static volatile uint seq_index = 0;
+static volatile bool seq_in_gap = false;
+static volatile bool seq_loop = false;
+static volatile alarm_id_t seq_alarm = 0;
+static volatile bool seq_playing = false; // Cleared by the IRQ when a tune ends
+
+// Single note for play_tone, built at runtime
+static ringtone_note_t single_note;
+static ringtone_t single_tune = { "tone", 1, 0, 1, &single_note };
 
 // Initialize PWM for the buzzer
 void buzzer_init() {
     gpio_set_function(BUZZER_PIN, GPIO_FUNC_PWM);
-    uint slice_num = pwm_gpio_to_slice_num(BUZZER_PIN);
+    buzzer_slice = pwm_gpio_to_slice_num(BUZZER_PIN);
+    buzzer_channel = pwm_gpio_to_channel(BUZZER_PIN);
     pwm_config config = pwm_get_default_config();
-    pwm_config_set_clkdiv(&config, 4.0f);
-    pwm_init(slice_num, &config, true);
+    pwm_init(buzzer_slice, &config, true);
     pwm_set_gpio_level(BUZZER_PIN, 0);
+
+    if (clock_get_hz(clk_sys) != RINGTONE_SYS_CLK_HZ) {
+        printf("Buzzer: ringtones built for %u Hz but clk_sys is %u Hz, pitch will be off\n",
+               RINGTONE_SYS_CLK_HZ, (unsigned)clock_get_hz(clk_sys));
+    }
+}
+
+// Two register writes per note: TOP and the compare level (0 is a rest)
+static inline void note_on(const ringtone_note_t *note) {
+    pwm_set_wrap(buzzer_slice, note->wrap);
+    pwm_set_chan_level(buzzer_slice, buzzer_channel, note->level);
+}
+
+// Alternates note / gap; the negative return value re-arms the alarm
+// relative to its previous target, so note boundaries do not drift.
+static int64_t sequencer_alarm_cb(alarm_id_t id, void *user_data) {
+    if (!seq_in_gap) {
+        pwm_set_gpio_level(BUZZER_PIN, 0);
+        seq_in_gap = true;
+        return -(int64_t)NOTE_GAP_MS * 1000;
+    }
+
+    seq_in_gap = false;
+    if (++seq_index >= seq_tune->length) {
+        if (!seq_loop) {
+            seq_playing = false;
+            return 0; // Done
+        }
+        seq_index = 0;
+    }
+
+    const ringtone_note_t *note = &seq_tune->notes[seq_index];
+    note_on(note);
+    return -(int64_t)note->duration_ms * 1000;
 }
 
-// Play a single tone
+// Start playing a ringtone in the background
+bool buzzer_start(const ringtone_t *tune, bool loop) {
+    audio_stop(); // A clip owns the same pin and PWM slice
+    buzzer_stop();
+    if (tune == NULL || tune->length == 0) {
+        return false;
+    }
+
+    seq_tune = tune;
+    seq_index = 0;
+    seq_in_gap = false;
+    seq_loop = loop;
+
+    // The divider is fixed for the whole tune, notes only change TOP/level
+    pwm_set_clkdiv_int_frac(buzzer_slice, tune->div_int, tune->div_frac);
+    note_on(&tune->notes[0]);
+    // Marked as playing before arming: a short tune can end in the IRQ
+    // before add_alarm_in_ms() even returns
+    seq_playing = true;
+    alarm_id_t id = add_alarm_in_ms(tune->notes[0].duration_ms, sequencer_alarm_cb, NULL, true);
+    if (id <= 0) {
+        seq_playing = false;
+        pwm_set_gpio_level(BUZZER_PIN, 0);
+        return false;
+    }
+    seq_alarm = id;
+    return true;
+}
+
+// Stop the sequencer and silence the buzzer
+void buzzer_stop(void) {
+    if (seq_alarm > 0) {
+        cancel_alarm(seq_alarm); // Harmless if the tune already ended
+        seq_alarm = 0;
+    }
+    seq_playing = false;
+    pwm_set_gpio_level(BUZZER_PIN, 0);
+}
+
+bool buzzer_is_playing(void) {
+    return seq_playing;
+}
+
+// Play a single tone (returns immediately). Unlike the compiled ringtones
+// this works out divider and wrap at runtime.
 void play_tone(uint frequency, uint duration_ms) {
     if (frequency == 0) {
         return; // Avoid division by zero if an invalid frequency is passed
     }
 
-    uint slice_num = pwm_gpio_to_slice_num(BUZZER_PIN);
+    // Smallest 8.4 divider that keeps the wrap within 16 bits
     uint32_t clock_freq = clock_get_hz(clk_sys);
-    uint32_t top = (clock_freq / frequency) - 1;
-
-    pwm_set_wrap(slice_num, top);
-    pwm_set_gpio_level(BUZZER_PIN, top / 2); // 50% duty cycle
+    uint32_t div16 = (uint32_t)(((uint64_t)clock_freq * 16 + (uint64_t)frequency * 65536 - 1) /
+                                ((uint64_t)frequency * 65536));
+    if (div16 < 16) div16 = 16;
+    if (div16 > 0xFFF) div16 = 0xFFF;
+    uint32_t top = (uint32_t)((uint64_t)clock_freq * 16 / (div16 * frequency)) - 1;
+    if (top > 0xFFFF) top = 0xFFFF;
 
-    sleep_ms(duration_ms);
-
-    pwm_set_gpio_level(BUZZER_PIN, 0); // Turn off buzzer
-    sleep_ms(50); // Short pause between notes
+    single_note.wrap = top;
+    single_note.level = (top + 1) / 2; // 50% duty cycle
+    single_note.duration_ms = duration_ms;
+    single_tune.div_int = div16 >> 4;
+    single_tune.div_frac = div16 & 0xF;
+    buzzer_start(&single_tune, false);
 }
 
-// Play a selected ringtone
-void play_ringtone(int ringtone_option) {
-    const uint *notes = NULL;
-    int length = 0;
-
-    switch (ringtone_option) {
-        case 0:
-            notes = ringtone1;
-            length = sizeof(ringtone1) / sizeof(ringtone1[0]);
-            break;
-        case 1:
-            notes = ringtone2;
-            length = sizeof(ringtone2) / sizeof(ringtone2[0]);
-            break;
-        case 2:
-            notes = ringtone3;
-            length = sizeof(ringtone3) / sizeof(ringtone3[0]);
-            break;
-        default:
-            printf("Invalid ringtone option: %d\n", ringtone_option);
-            return; // Exit if invalid option
+// Play a selected ringtone (returns immediately)
+void play_ringtone(int ringtone_option, bool repeat) {
+    if (ringtone_option < 0 || ringtone_option >= RINGTONE_COUNT) {
+        printf("Invalid ringtone option: %d\n", ringtone_option);
+        return; // Exit if invalid option
     }
 
-    for (int i = 0; i < length; i++) {
-        play_tone(notes[i], note_durations[i % (sizeof(note_durations) / sizeof(note_durations[0]))]);
-    }
+    buzzer_start(&ringtones[ringtone_option], repeat);
 }
 
 // Stop the buzzer
 void stop_buzzer() {
-    pwm_set_gpio_level(BUZZER_PIN, 0);
+    buzzer_stop();
 }
@@ -2,14 +2,23 @@
 #define BUZZER_H
 
 #include "pico/stdlib.h"
+#include "ringtones.h"
 
 // Buzzer pin definition
 #define BUZZER_PIN 21
 
 // Function prototypes
 void buzzer_init();
+
+// Non-blocking sequencer: notes are advanced from a hardware alarm IRQ,
+// so these calls return immediately. The tune must stay valid while it
+// plays.
+bool buzzer_start(const ringtone_t *tune, bool loop);
+void buzzer_stop(void);
+bool buzzer_is_playing(void);
+
 void play_tone(uint frequency, uint duration_ms);
-void play_ringtone(int ringtone_option);
+void play_ringtone(int ringtone_option, bool repeat);
 void stop_buzzer();
 
 #endif
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "console.h"
+
+#define CONSOLE_MAX_COMMANDS 16
+
+typedef struct {
+    char key;
+    const char *help;
+    console_handler_t handler;
+} console_command_t;
+
+static console_command_t commands[CONSOLE_MAX_COMMANDS];
+static int num_commands = 0;
+
+void console_register(char key, const char *help, console_handler_t handler) {
+    if (num_commands >= CONSOLE_MAX_COMMANDS) {
+        printf("Console: no room for command '%c'\n", key);
+        return;
+    }
+    commands[num_commands].key = key;
+    commands[num_commands].help = help;
+    commands[num_commands].handler = handler;
+    num_commands++;
+}
+
+static void console_print_help(void) {
+    printf("Commands:\n");
+    for (int i = 0; i < num_commands; i++) {
+        printf("  %c  %s\n", commands[i].key, commands[i].help);
+    }
+}
+
+void console_poll(void) {
+    int c = getchar_timeout_us(0);
+    if (c == PICO_ERROR_TIMEOUT) return;
+
+    for (int i = 0; i < num_commands; i++) {
+        if (commands[i].key == c) {
+            commands[i].handler();
+            return;
+        }
+    }
+    if (c == '?') {
+        console_print_help();
+    }
+}
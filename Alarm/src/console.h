@@ -0,0 +1,13 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+// Single-key diagnostic commands over USB stdio. Type '?' for the list.
+typedef void (*console_handler_t)(void);
+
+// Registers a command (call during init)
+void console_register(char key, const char *help, console_handler_t handler);
+
+// Non-blocking: handles at most one pending key press
+void console_poll(void);
+
+#endif // CONSOLE_H
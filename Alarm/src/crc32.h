@@ -0,0 +1,15 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE 802.3, same result as zlib's crc32). Start with crc = 0 and
+// feed the data in as many pieces as needed.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+static inline uint32_t crc32(const void *data, size_t len) {
+    return crc32_update(0, data, len);
+}
+
+#endif // CRC32_H
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include "debounce.h"
+#include "hardware/pio.h"
+#include "hardware/irq.h"
+#include "debounce.pio.h"
+
+static PIO db_pio;
+static uint db_sm;
+static uint db_base_pin;
+static uint32_t db_window_ms;
+static debounce_callback_t db_callback;
+
+static uint32_t levels;
+static volatile uint32_t edge_count[debounce_PIN_COUNT];
+
+// One FIFO word per confirmed change: the new levels of all pins
+static void debounce_irq_handler(void) {
+    uint32_t time_ms = to_ms_since_boot(get_absolute_time()) - db_window_ms;
+
+    while (!pio_sm_is_rx_fifo_empty(db_pio, db_sm)) {
+        uint32_t now = pio_sm_get(db_pio, db_sm);
+        uint32_t changed = now ^ levels;
+        levels = now;
+
+        for (uint i = 0; i < debounce_PIN_COUNT; i++) {
+            if (changed & (1u << i)) {
+                edge_count[i]++;
+                if (db_callback) {
+                    db_callback(i, !(now & (1u << i)), time_ms);
+                }
+            }
+        }
+    }
+}
+
+bool debounce_init(uint base_pin, uint32_t window_ms, debounce_callback_t callback) {
+    db_pio = pio0;
+    if (!pio_can_add_program(db_pio, &debounce_program)) {
+        db_pio = pio1;
+        if (!pio_can_add_program(db_pio, &debounce_program)) {
+            printf("Debounce: no PIO program space\n");
+            return false;
+        }
+    }
+    int sm = pio_claim_unused_sm(db_pio, false);
+    if (sm < 0) {
+        printf("Debounce: no free state machine\n");
+        return false;
+    }
+    db_sm = sm;
+    db_base_pin = base_pin;
+    db_window_ms = window_ms;
+    db_callback = callback;
+    levels = (1u << debounce_PIN_COUNT) - 1; // All released
+
+    uint offset = pio_add_program(db_pio, &debounce_program);
+    debounce_program_init(db_pio, db_sm, offset, base_pin, window_ms);
+
+    uint irq = (db_pio == pio0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+    irq_add_shared_handler(irq, debounce_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    pio_set_irq0_source_enabled(db_pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + db_sm), true);
+    irq_set_enabled(irq, true);
+    return true;
+}
+
+uint32_t debounce_edge_count(uint index) {
+    return index < debounce_PIN_COUNT ? edge_count[index] : 0;
+}
+
+void debounce_print_stats(void) {
+    for (uint i = 0; i < debounce_PIN_COUNT; i++) {
+        printf("GPIO %u: %u edges\n", db_base_pin + i, (unsigned)edge_count[i]);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+// Hardware button debouncing: a PIO state machine watches consecutive
+// active-low pins and only reports levels that stayed stable for the
+// debounce window. The CPU is interrupted once per real edge.
+
+// Called from the PIO IRQ. time_ms is when the edge happened (the IRQ
+// arrives one debounce window later).
+typedef void (*debounce_callback_t)(uint index, bool pressed, uint32_t time_ms);
+
+// Debounces debounce_PIN_COUNT (2) pins starting at base_pin
+bool debounce_init(uint base_pin, uint32_t window_ms, debounce_callback_t callback);
+
+// Debounced edges (press + release) seen on a pin since init
+uint32_t debounce_edge_count(uint index);
+
+// Prints the per-pin edge counters (console key 'e')
+void debounce_print_stats(void);
+
+#endif // DEBOUNCE_H
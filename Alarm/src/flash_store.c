@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+
+#include "flash_store.h"
+#include "crc32.h"
+
+#define FLASH_STORE_MAGIC 0x414C5253u // "SRLA"
+#define FLASH_STORE_LOCKOUT_MS 100
+
+typedef struct {
+    uint32_t magic;
+    uint32_t len;
+    uint32_t crc;
+    uint8_t data[FLASH_STORE_MAX_LEN];
+} flash_record_t;
+
+static_assert(sizeof(flash_record_t) == FLASH_PAGE_SIZE, "record must fill exactly one flash page");
+
+typedef struct {
+    uint32_t offset;
+    const flash_record_t *record; // NULL to erase only
+} flash_op_t;
+
+static uint32_t slot_offset(flash_store_slot_t slot) {
+    return PICO_FLASH_SIZE_BYTES - (slot + 1) * FLASH_SECTOR_SIZE;
+}
+
+static const flash_record_t *slot_contents(flash_store_slot_t slot) {
+    return (const flash_record_t *)(XIP_BASE + slot_offset(slot));
+}
+
+// Runs with interrupts off (and the other core parked) via flash_safe_execute
+static void flash_op(void *param) {
+    const flash_op_t *op = (const flash_op_t *)param;
+
+    flash_range_erase(op->offset, FLASH_SECTOR_SIZE);
+    if (op->record) {
+        flash_range_program(op->offset, (const uint8_t *)op->record, FLASH_PAGE_SIZE);
+    }
+}
+
+bool flash_store_load(flash_store_slot_t slot, void *data, size_t len) {
+    if (slot >= FLASH_STORE_SLOT_COUNT || len > FLASH_STORE_MAX_LEN) return false;
+
+    const flash_record_t *rec = slot_contents(slot);
+    if (rec->magic != FLASH_STORE_MAGIC || rec->len != len) return false;
+    if (crc32(rec->data, len) != rec->crc) return false;
+
+    memcpy(data, rec->data, len);
+    return true;
+}
+
+bool flash_store_save(flash_store_slot_t slot, const void *data, size_t len) {
+    if (slot >= FLASH_STORE_SLOT_COUNT || len > FLASH_STORE_MAX_LEN) return false;
+
+    const flash_record_t *current = slot_contents(slot);
+    if (current->magic == FLASH_STORE_MAGIC && current->len == len &&
+        memcmp(current->data, data, len) == 0) {
+        return true; // Already stored
+    }
+
+    static flash_record_t record;
+    memset(&record, 0xFF, sizeof(record));
+    record.magic = FLASH_STORE_MAGIC;
+    record.len = len;
+    record.crc = crc32(data, len);
+    memcpy(record.data, data, len);
+
+    flash_op_t op = { .offset = slot_offset(slot), .record = &record };
+    if (flash_safe_execute(flash_op, &op, FLASH_STORE_LOCKOUT_MS) != PICO_OK) {
+        printf("Flash store: failed to write slot %d\n", slot);
+        return false;
+    }
+    return true;
+}
+
+bool flash_store_erase(flash_store_slot_t slot) {
+    if (slot >= FLASH_STORE_SLOT_COUNT) return false;
+    if (slot_contents(slot)->magic != FLASH_STORE_MAGIC) return true;
+
+    flash_op_t op = { .offset = slot_offset(slot), .record = NULL };
+    return flash_safe_execute(flash_op, &op, FLASH_STORE_LOCKOUT_MS) == PICO_OK;
+}
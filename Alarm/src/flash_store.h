@@ -0,0 +1,29 @@
+#ifndef FLASH_STORE_H
+#define FLASH_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/flash.h"
+
+// Small persistent records, one flash sector per slot, packed at the very end
+// of the flash so they never collide with the program image.
+typedef enum {
+    FLASH_STORE_WIFI_CACHE = 0,
+    FLASH_STORE_SLOT_COUNT
+} flash_store_slot_t;
+
+// Largest payload a slot can hold (one flash page minus the record header)
+#define FLASH_STORE_MAX_LEN (FLASH_PAGE_SIZE - 12)
+
+// Copies the record into data. Fails if the slot is empty, corrupt or was
+// written with a different length.
+bool flash_store_load(flash_store_slot_t slot, void *data, size_t len);
+
+// Writes the record. A write identical to what is stored is skipped to
+// save flash wear.
+bool flash_store_save(flash_store_slot_t slot, const void *data, size_t len);
+
+// Invalidates the record
+bool flash_store_erase(flash_store_slot_t slot);
+
+#endif // FLASH_STORE_H
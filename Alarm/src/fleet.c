@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/async_context.h"
+#include "pico/unique_id.h"
+#include "pico/rand.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+#include "lwip/netif.h"
+
+#include "fleet.h"
+#include "crc32.h"
+#include "settings.h"
+#include "timekeeper.h"
+
+#define FLEET_GROUP "239.255.42.99"
+#define FLEET_ANNOUNCE_MS 60000
+#define FLEET_CHECK_MS 2000           // Group membership check
+#define FLEET_REPLY_JITTER_MS 500
+
+// All state is touched only from the cyw43 async context (lwIP lock held)
+static struct udp_pcb *pcb = NULL;
+static ip_addr_t group_addr;
+static pico_unique_board_id_t device_id;
+static async_at_time_worker_t announce_worker;
+static absolute_time_t next_announce;
+static async_at_time_worker_t reply_worker;
+static ip_addr_t reply_addr;          // Pending DISCOVER answer
+static u16_t reply_port;
+static bool reply_pending = false;
+
+static bool have_config = false;
+static uint32_t config_seq = 0;       // Last CONFIG applied
+
+static uint32_t rx_packets = 0;
+static uint32_t rx_bad = 0;           // Wrong magic, version, length or CRC
+static uint32_t configs_applied = 0;
+static uint32_t configs_duplicate = 0;
+static uint32_t configs_invalid = 0;
+static uint32_t announces = 0;
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    *p++ = v >> 8;
+    *p++ = v & 0xFF;
+    return p;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, v >> 16);
+    return put_u16(p, v & 0xFFFF);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)get_u16(p) << 16 | get_u16(p + 2);
+}
+
+// Adds the header and CRC around payload_len bytes already at
+// packet + FLEET_HEADER_LEN, and sends it
+static void send_packet(uint8_t *packet, fleet_msg_t type, uint32_t seq, uint16_t payload_len,
+                        const ip_addr_t *addr, u16_t port) {
+    memcpy(packet, FLEET_MAGIC, 4);
+    packet[4] = FLEET_VERSION;
+    packet[5] = type;
+    packet[6] = 0;
+    packet[7] = 0;
+    put_u32(packet + 8, seq);
+    memcpy(packet + 12, device_id.id, sizeof(device_id.id));
+    put_u16(packet + 20, payload_len);
+    uint16_t len = FLEET_HEADER_LEN + payload_len;
+    put_u32(packet + len, crc32(packet, len));
+    len += 4;
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (!p) {
+        printf("Fleet: no pbuf for reply\n");
+        return;
+    }
+    pbuf_take(p, packet, len);
+    udp_sendto(pcb, p, addr, port);
+    pbuf_free(p);
+}
+
+static uint8_t *put_settings(uint8_t *p, const settings_t *s) {
+    *p++ = FLEET_TLV_ALARM;
+    *p++ = 3;
+    *p++ = s->alarm_hour;
+    *p++ = s->alarm_minute;
+    *p++ = s->alarm_set;
+    *p++ = FLEET_TLV_RINGTONE;
+    *p++ = 1;
+    *p++ = s->ringtone;
+    *p++ = FLEET_TLV_COLOR;
+    *p++ = 1;
+    *p++ = s->color;
+    *p++ = FLEET_TLV_BRIGHTNESS;
+    *p++ = 1;
+    *p++ = s->brightness;
+    return p;
+}
+
+static void send_announce(const ip_addr_t *addr, u16_t port) {
+    uint8_t packet[64];
+    settings_t s;
+    settings_get(&s);
+
+    uint8_t *p = packet + FLEET_HEADER_LEN;
+    p = put_u32(p, (uint32_t)(time_us_64() / 1000000));
+    *p++ = timekeeper_synced() ? 1 : 0;
+    p = put_u32(p, config_seq);
+    p = put_settings(p, &s);
+    send_packet(packet, FLEET_ANNOUNCE, 0, p - (packet + FLEET_HEADER_LEN), addr, port);
+    announces++;
+}
+
+static void send_ack(uint32_t seq, fleet_ack_t status, uint8_t applied,
+                     const ip_addr_t *addr, u16_t port) {
+    uint8_t packet[FLEET_HEADER_LEN + 2 + 4];
+    packet[FLEET_HEADER_LEN] = status;
+    packet[FLEET_HEADER_LEN + 1] = applied;
+    send_packet(packet, FLEET_ACK, seq, 2, addr, port);
+}
+
+// Applies the TLVs to a copy of the settings; false on any bad TLV
+static bool apply_tlvs(const uint8_t *p, const uint8_t *end, settings_t *s, uint8_t *applied) {
+    *applied = 0;
+    while (p < end) {
+        if (end - p < 2 || end - p - 2 < p[1]) return false;
+        uint8_t type = p[0];
+        uint8_t len = p[1];
+        const uint8_t *v = p + 2;
+        p += 2 + len;
+
+        switch (type) {
+            case FLEET_TLV_ALARM:
+                if (len != 3 || v[2] > 1) return false;
+                s->alarm_hour = v[0];
+                s->alarm_minute = v[1];
+                s->alarm_set = v[2];
+                break;
+            case FLEET_TLV_RINGTONE:
+                if (len != 1) return false;
+                s->ringtone = v[0];
+                break;
+            case FLEET_TLV_COLOR:
+                if (len != 1) return false;
+                s->color = v[0];
+                break;
+            case FLEET_TLV_BRIGHTNESS:
+                if (len != 1) return false;
+                s->brightness = v[0];
+                break;
+            default:
+                continue; // Newer tool: skip what we do not know
+        }
+        (*applied)++;
+    }
+    return true;
+}
+
+static void handle_config(uint32_t seq, const uint8_t *payload, uint16_t len,
+                          const ip_addr_t *addr, u16_t port) {
+    if (len < 1 || len < 1 + 8 * payload[0]) {
+        rx_bad++;
+        return;
+    }
+
+    // Addressed to a list of devices: stay quiet if we are not on it
+    int targets = payload[0];
+    const uint8_t *ids = payload + 1;
+    bool for_us = targets == 0;
+    for (int i = 0; i < targets && !for_us; i++) {
+        for_us = memcmp(ids + 8 * i, device_id.id, 8) == 0;
+    }
+    if (!for_us) return;
+
+    if (have_config && (int32_t)(seq - config_seq) <= 0) {
+        configs_duplicate++;
+        send_ack(seq, FLEET_ACK_DUPLICATE, 0, addr, port);
+        return;
+    }
+
+    settings_t s;
+    settings_get(&s);
+    uint8_t applied;
+    if (!apply_tlvs(ids + 8 * targets, payload + len, &s, &applied) || !settings_set(&s)) {
+        configs_invalid++;
+        printf("Fleet: rejected config %lu from %s\n", (unsigned long)seq, ipaddr_ntoa(addr));
+        send_ack(seq, FLEET_ACK_INVALID, 0, addr, port);
+        return;
+    }
+
+    have_config = true;
+    config_seq = seq;
+    configs_applied++;
+    printf("Fleet: applied config %lu from %s (%d settings)\n",
+           (unsigned long)seq, ipaddr_ntoa(addr), applied);
+    send_ack(seq, FLEET_ACK_APPLIED, applied, addr, port);
+}
+
+static void fleet_recv_cb(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                          const ip_addr_t *addr, u16_t port) {
+    uint8_t packet[FLEET_MAX_PACKET];
+    uint16_t len = p->tot_len;
+    bool fits = len >= FLEET_HEADER_LEN + 4 && len <= sizeof(packet);
+    if (fits) {
+        pbuf_copy_partial(p, packet, len, 0);
+    }
+    pbuf_free(p);
+    rx_packets++;
+
+    if (!fits || memcmp(packet, FLEET_MAGIC, 4) != 0 || packet[4] != FLEET_VERSION ||
+        FLEET_HEADER_LEN + get_u16(packet + 20) + 4 != len ||
+        crc32(packet, len - 4) != get_u32(packet + len - 4)) {
+        rx_bad++;
+        return;
+    }
+
+    uint32_t seq = get_u32(packet + 8);
+    const uint8_t *payload = packet + FLEET_HEADER_LEN;
+    uint16_t payload_len = len - FLEET_HEADER_LEN - 4;
+
+    switch (packet[5]) {
+        case FLEET_DISCOVER:
+            // Spread the answers of a whole site over the jitter window
+            reply_addr = *addr;
+            reply_port = port;
+            if (!reply_pending) {
+                reply_pending = true;
+                async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &reply_worker,
+                                                       get_rand_32() % FLEET_REPLY_JITTER_MS);
+            }
+            break;
+        case FLEET_CONFIG:
+            handle_config(seq, payload, payload_len, addr, port);
+            break;
+        default:
+            break; // Other devices' ANNOUNCE and ACK traffic
+    }
+}
+
+static void reply_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    reply_pending = false;
+    send_announce(&reply_addr, reply_port);
+}
+
+static void announce_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    // A duty-cycled radio re-creates the interface on every wake, which
+    // drops its group memberships
+    struct netif *n = netif_default;
+    if (n && netif_is_up(n) && !igmp_lookfor_group(n, ip_2_ip4(&group_addr))) {
+        igmp_joingroup_netif(n, ip_2_ip4(&group_addr));
+    }
+
+    if (time_reached(next_announce)) {
+        send_announce(&group_addr, FLEET_PORT);
+        next_announce = make_timeout_time_ms(FLEET_ANNOUNCE_MS);
+    }
+    async_context_add_at_time_worker_in_ms(context, worker, FLEET_CHECK_MS);
+}
+
+bool fleet_start(void) {
+    if (pcb) return true;
+
+    pico_get_unique_board_id(&device_id);
+    ipaddr_aton(FLEET_GROUP, &group_addr);
+
+    pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+    if (!pcb) {
+        printf("Fleet: failed to create UDP PCB\n");
+        return false;
+    }
+    if (udp_bind(pcb, IP_ANY_TYPE, FLEET_PORT) != ERR_OK) {
+        printf("Fleet: failed to bind port %d\n", FLEET_PORT);
+        udp_remove(pcb);
+        pcb = NULL;
+        return false;
+    }
+    udp_set_multicast_ttl(pcb, 1); // Stay on the local network
+    udp_recv(pcb, fleet_recv_cb, NULL);
+
+    // Reports go out once the interface is up, and again after reconnects
+    if (igmp_joingroup(IP4_ADDR_ANY4, ip_2_ip4(&group_addr)) != ERR_OK) {
+        printf("Fleet: failed to join %s\n", FLEET_GROUP);
+    }
+
+    reply_worker.do_work = reply_worker_fn;
+    announce_worker.do_work = announce_worker_fn;
+    next_announce = make_timeout_time_ms(FLEET_ANNOUNCE_MS / 4 + get_rand_32() % FLEET_REPLY_JITTER_MS);
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &announce_worker, FLEET_CHECK_MS);
+    return true;
+}
+
+void fleet_print_stats(void) {
+    printf("Fleet: %s, group %s:%d\n", pcb ? "listening" : "not running", FLEET_GROUP, FLEET_PORT);
+    printf("  %lu packets, %lu bad, %lu announces sent\n",
+           (unsigned long)rx_packets, (unsigned long)rx_bad, (unsigned long)announces);
+    printf("  configs: %lu applied, %lu duplicate, %lu invalid, last seq %lu\n",
+           (unsigned long)configs_applied, (unsigned long)configs_duplicate,
+           (unsigned long)configs_invalid, (unsigned long)config_seq);
+}
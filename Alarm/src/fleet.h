@@ -0,0 +1,70 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Site-wide discovery and configuration over UDP multicast
+// (239.255.42.99:4242, TTL 1). tools/fleet_push.py is the host side.
+//
+// Every datagram, all integers big endian:
+//   0  magic "ALRM"
+//   4  version (1)
+//   5  type (fleet_msg_t)
+//   6  reserved (2 bytes, zero)
+//   8  seq            u32
+//  12  device id      8 bytes (board unique id; zero from the host)
+//  20  payload length u16
+//  22  payload
+//  ..  CRC-32 of everything before it (same as zlib.crc32)
+// The CRC only catches corruption; it does not authenticate the sender.
+//
+// Payloads:
+//   DISCOVER  empty. Devices answer with a unicast ANNOUNCE after a random
+//             delay of up to 500 ms.
+//   ANNOUNCE  uptime_s u32, flags u8 (bit 0 = NTP synced), config seq u32,
+//             then the current settings as TLVs. Also multicast every
+//             60 s.
+//   CONFIG    target count u8, that many device ids (0 = every device),
+//             then settings TLVs. The header seq identifies the batch.
+//   ACK       status u8 (fleet_ack_t), TLVs applied u8; seq echoes the
+//             CONFIG. Unicast to the sender.
+//
+// A CONFIG is applied all or nothing and only if its seq is higher than
+// the last one applied, so the host can resend the same batch until every
+// device has acked it. The last seq is kept in RAM only, like the settings.
+
+#define FLEET_PORT 4242
+#define FLEET_MAGIC "ALRM"
+#define FLEET_VERSION 1
+#define FLEET_HEADER_LEN 22
+#define FLEET_MAX_PACKET 512
+
+typedef enum {
+    FLEET_DISCOVER = 1,
+    FLEET_ANNOUNCE = 2,
+    FLEET_CONFIG = 3,
+    FLEET_ACK = 4
+} fleet_msg_t;
+
+// Settings TLVs: type u8, length u8, value. Unknown types are skipped.
+typedef enum {
+    FLEET_TLV_ALARM = 1,      // hour u8, minute u8, enabled u8
+    FLEET_TLV_RINGTONE = 2,   // u8 index
+    FLEET_TLV_COLOR = 3,      // u8 palette index
+    FLEET_TLV_BRIGHTNESS = 4  // u8 0..LED_BRIGHTNESS_MAX
+} fleet_tlv_t;
+
+typedef enum {
+    FLEET_ACK_APPLIED = 0,
+    FLEET_ACK_DUPLICATE = 1,  // seq already applied, nothing changed
+    FLEET_ACK_INVALID = 2     // Bad TLV or value out of range, nothing changed
+} fleet_ack_t;
+
+// Joins the group and starts announcing; call with the lwIP lock held
+bool fleet_start(void);
+
+// Prints message counters (console key 'f')
+void fleet_print_stats(void);
+
+#endif // FLEET_H
@@ -0,0 +1,541 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/rtc.h"
+#include "pico/util/datetime.h"
+
+#include "lwip/tcp.h"
+
+#include "http_server.h"
+#include "settings.h"
+#include "timekeeper.h"
+#include "ringtones.h"
+#include "web_assets.h"
+#include "radio.h"
+
+#define HTTP_PORT 80
+#define HTTP_MAX_CONNS 4
+#define HTTP_REQ_MAX 1024               // Request line, headers and body
+#define HTTP_RESP_MAX 512               // Header and JSON body of an API response
+#define HTTP_MAX_INFLIGHT (2 * TCP_MSS) // Unacked bytes per connection
+#define HTTP_POLL_INTERVAL 2            // tcp_poll period, in 500 ms ticks
+#define HTTP_IDLE_TIMEOUT_POLLS 10      // Drop a connection after 10 s without progress
+
+typedef struct {
+    const void *data;
+    uint32_t len;
+} http_part_t;
+
+typedef struct {
+    struct tcp_pcb *pcb;          // NULL = slot free
+    uint16_t req_len;
+    bool responding;
+    uint8_t idle_polls;
+    http_part_t parts[2];         // Header and body, sent in order
+    uint8_t num_parts;
+    uint8_t part;
+    uint32_t part_off;
+    uint32_t unacked;             // Written to lwIP but not yet acked
+    char req[HTTP_REQ_MAX + 1];
+    char resp[HTTP_RESP_MAX];     // API responses are built here
+} http_conn_t;
+
+// Responses are handed to tcp_write without TCP_WRITE_FLAG_COPY: assets
+// point into flash and API responses into the connection slot, which is
+// not reused before everything is acked (or the pcb is aborted). Only the
+// TCP headers come from the lwIP heap, and each connection keeps at most
+// HTTP_MAX_INFLIGHT bytes outstanding, so all slots fit in MEM_SIZE.
+// Received pbufs are copied into req and freed straight away, so a slow
+// client never holds on to the PBUF_POOL.
+
+// All state is touched only from the cyw43 async context (lwIP lock held)
+static struct tcp_pcb *listen_pcb = NULL;
+static http_conn_t conns[HTTP_MAX_CONNS];
+static int active = 0;
+
+static uint32_t accepted = 0;
+static uint32_t rejected = 0;       // Pool full
+static uint32_t requests = 0;
+static uint32_t bad_requests = 0;   // 4xx
+static uint32_t not_modified = 0;
+static uint32_t timeouts = 0;
+static uint32_t errors = 0;         // Reset or aborted by lwIP
+static uint32_t write_stalls = 0;   // tcp_write ran out of memory, retried later
+static uint32_t bytes_sent = 0;
+static int peak_active = 0;
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        default:  return "Internal Server Error";
+    }
+}
+
+// -------------------------------------------------------------------------
+// Connection handling
+// -------------------------------------------------------------------------
+
+static err_t conn_close(http_conn_t *c, bool abort) {
+    struct tcp_pcb *pcb = c->pcb;
+    err_t result = ERR_OK;
+
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    c->pcb = NULL;
+    if (--active == 0) radio_release(RADIO_USER_HTTP);
+
+    // Data still queued points into this slot, so it has to go with the pcb
+    if (abort || c->unacked != 0 || tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        result = ERR_ABRT;
+    }
+    return result;
+}
+
+// Queues as much of the response as the send buffer and the in-flight
+// limit allow; the rest follows from the sent and poll callbacks
+static err_t conn_send(http_conn_t *c) {
+    while (c->part < c->num_parts) {
+        const http_part_t *part = &c->parts[c->part];
+        uint32_t n = part->len - c->part_off;
+        uint32_t room = tcp_sndbuf(c->pcb);
+        if (room > HTTP_MAX_INFLIGHT - c->unacked) room = HTTP_MAX_INFLIGHT - c->unacked;
+        if (n > room) n = room;
+        if (n == 0 || tcp_sndqueuelen(c->pcb) >= TCP_SND_QUEUELEN) break;
+
+        bool last = c->part + 1 == c->num_parts && c->part_off + n == part->len;
+        err_t err = tcp_write(c->pcb, (const uint8_t *)part->data + c->part_off, n,
+                              last ? 0 : TCP_WRITE_FLAG_MORE);
+        if (err == ERR_MEM) {
+            write_stalls++;
+            break;
+        }
+        if (err != ERR_OK) {
+            return conn_close(c, true);
+        }
+        c->unacked += n;
+        c->part_off += n;
+        if (c->part_off == part->len) {
+            c->part++;
+            c->part_off = 0;
+        }
+    }
+
+    if (c->part == c->num_parts && c->unacked == 0) {
+        return conn_close(c, false);
+    }
+    tcp_output(c->pcb);
+    return ERR_OK;
+}
+
+static err_t start_response(http_conn_t *c, const void *head, uint32_t head_len,
+                            const void *body, uint32_t body_len) {
+    c->responding = true;
+    c->parts[0] = (http_part_t){head, head_len};
+    c->parts[1] = (http_part_t){body, body_len};
+    c->num_parts = body_len ? 2 : 1;
+    c->part = 0;
+    c->part_off = 0;
+    return conn_send(c);
+}
+
+// Small responses: header and body are formatted into the slot
+static err_t respond(http_conn_t *c, int status, const char *extra_headers, const char *body) {
+    if (status >= 400) bad_requests++;
+    int len = snprintf(c->resp, sizeof(c->resp),
+                       "HTTP/1.1 %d %s\r\n%sContent-Length: %u\r\n"
+                       "Cache-Control: no-store\r\nConnection: close\r\n\r\n%s",
+                       status, status_text(status), extra_headers, (unsigned)strlen(body), body);
+    if (len >= (int)sizeof(c->resp)) {
+        printf("HTTP: response truncated (%d bytes)\n", len);
+        len = sizeof(c->resp) - 1;
+    }
+    return start_response(c, c->resp, len, NULL, 0);
+}
+
+static err_t respond_json(http_conn_t *c, int status, const char *json) {
+    return respond(c, status, "Content-Type: application/json\r\n", json);
+}
+
+static err_t respond_error(http_conn_t *c, int status) {
+    char json[48];
+    snprintf(json, sizeof(json), "{\"error\":\"%s\"}", status_text(status));
+    return respond_json(c, status, json);
+}
+
+// -------------------------------------------------------------------------
+// Request parsing
+// -------------------------------------------------------------------------
+
+// Value of a request header (name is case-insensitive), NULL if absent.
+// headers points at the "\r\n" ending the request line, which stays valid
+// after the request line is split in place. The value runs up to the next
+// "\r\n".
+static const char *header_value(const char *headers, const char *hdr_end, const char *name) {
+    size_t n = strlen(name);
+    for (const char *line = headers; line && line < hdr_end; line = strstr(line + 2, "\r\n")) {
+        const char *h = line + 2;
+        if (strncasecmp(h, name, n) == 0 && h[n] == ':') {
+            h += n + 1;
+            while (*h == ' ') h++;
+            return h;
+        }
+    }
+    return NULL;
+}
+
+// Start of the value of "key" in a flat JSON object, NULL if absent
+static const char *json_value(const char *json, const char *key) {
+    size_t n = strlen(key);
+    for (const char *p = strchr(json, '"'); p; p = strchr(p + 1, '"')) {
+        if (strncmp(p + 1, key, n) != 0 || p[n + 1] != '"') continue;
+        const char *v = p + n + 2;
+        while (*v == ' ' || *v == '\t' || *v == '\r' || *v == '\n') v++;
+        if (*v != ':') continue;
+        v++;
+        while (*v == ' ' || *v == '\t' || *v == '\r' || *v == '\n') v++;
+        return v;
+    }
+    return NULL;
+}
+
+// Optional fields: *out is left alone if the key is missing; false only if
+// it is present but not valid
+static bool json_get_int(const char *json, const char *key, long min, long max, long *out) {
+    const char *v = json_value(json, key);
+    if (!v) return true;
+    char *end;
+    long value = strtol(v, &end, 10);
+    if (end == v || value < min || value > max) return false;
+    *out = value;
+    return true;
+}
+
+static bool json_get_bool(const char *json, const char *key, bool *out) {
+    const char *v = json_value(json, key);
+    if (!v) return true;
+    if (strncmp(v, "true", 4) == 0) {
+        *out = true;
+    } else if (strncmp(v, "false", 5) == 0) {
+        *out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool json_is_object(const char *json) {
+    while (*json == ' ' || *json == '\t' || *json == '\r' || *json == '\n') json++;
+    return *json == '{';
+}
+
+// -------------------------------------------------------------------------
+// API
+// -------------------------------------------------------------------------
+
+static int api_alarm(bool put, const char *body, char *out, size_t out_len) {
+    settings_t s;
+    settings_get(&s);
+
+    if (put) {
+        long hour = s.alarm_hour;
+        long minute = s.alarm_minute;
+        bool enabled = s.alarm_set;
+        if (!json_is_object(body) ||
+            !json_get_int(body, "hour", 0, 23, &hour) ||
+            !json_get_int(body, "minute", 0, 59, &minute) ||
+            !json_get_bool(body, "enabled", &enabled)) {
+            return 400;
+        }
+        s.alarm_hour = hour;
+        s.alarm_minute = minute;
+        s.alarm_set = enabled;
+        if (!settings_set(&s)) return 400;
+        printf("HTTP: alarm %02d:%02d %s\n", s.alarm_hour, s.alarm_minute, s.alarm_set ? "on" : "off");
+    }
+
+    snprintf(out, out_len, "{\"hour\":%d,\"minute\":%d,\"enabled\":%s}",
+             s.alarm_hour, s.alarm_minute, s.alarm_set ? "true" : "false");
+    return 200;
+}
+
+static int api_ringtone(bool put, const char *body, char *out, size_t out_len) {
+    settings_t s;
+    settings_get(&s);
+
+    if (put) {
+        long selected = s.ringtone;
+        if (!json_is_object(body) || !json_get_int(body, "selected", 0, RINGTONE_COUNT - 1, &selected)) {
+            return 400;
+        }
+        s.ringtone = selected;
+        if (!settings_set(&s)) return 400;
+        printf("HTTP: ringtone %d\n", s.ringtone);
+    }
+
+    int len = snprintf(out, out_len, "{\"selected\":%d,\"options\":[", s.ringtone);
+    for (int i = 0; i < RINGTONE_COUNT && len < (int)out_len; i++) {
+        len += snprintf(out + len, out_len - len, "%s\"%s\"", i ? "," : "", ringtones[i].name);
+    }
+    if (len < (int)out_len) {
+        snprintf(out + len, out_len - len, "]}");
+    }
+    return 200;
+}
+
+static int api_time(char *out, size_t out_len) {
+    datetime_t now;
+    rtc_get_datetime(&now);
+    int64_t unix_us;
+    bool synced = timekeeper_now_us(&unix_us);
+
+    char unix_ms[24] = "null";
+    if (synced) {
+        snprintf(unix_ms, sizeof(unix_ms), "%lld", (long long)(unix_us / 1000));
+    }
+    snprintf(out, out_len,
+             "{\"synced\":%s,\"unix_ms\":%s,\"local\":\"%04d-%02d-%02dT%02d:%02d:%02d\","
+             "\"utc_offset_s\":%d,\"drift_ppb\":%ld}",
+             synced ? "true" : "false", unix_ms, now.year, now.month, now.day,
+             now.hour, now.min, now.sec, TIMEKEEPER_UTC_OFFSET_S, (long)timekeeper_drift_ppb());
+    return 200;
+}
+
+static int api_health(char *out, size_t out_len) {
+    int32_t rssi = 0;
+    cyw43_wifi_get_rssi(&cyw43_state, &rssi);
+    snprintf(out, out_len,
+             "{\"uptime_s\":%lu,\"synced\":%s,\"rssi\":%ld,\"connections\":%d,"
+             "\"requests\":%lu,\"rejected\":%lu}",
+             (unsigned long)(time_us_64() / 1000000), timekeeper_synced() ? "true" : "false",
+             (long)rssi, active, (unsigned long)requests, (unsigned long)rejected);
+    return 200;
+}
+
+static err_t handle_api(http_conn_t *c, const char *method, const char *path, const char *body) {
+    bool get = strcmp(method, "GET") == 0;
+    bool put = strcmp(method, "PUT") == 0 || strcmp(method, "POST") == 0;
+    char json[256];
+    int status;
+
+    if (strcmp(path, "/api/alarm") == 0 && (get || put)) {
+        status = api_alarm(put, body, json, sizeof(json));
+    } else if (strcmp(path, "/api/ringtone") == 0 && (get || put)) {
+        status = api_ringtone(put, body, json, sizeof(json));
+    } else if (strcmp(path, "/api/time") == 0 && get) {
+        status = api_time(json, sizeof(json));
+    } else if (strcmp(path, "/api/health") == 0 && get) {
+        status = api_health(json, sizeof(json));
+    } else if (strcmp(path, "/api/alarm") == 0 || strcmp(path, "/api/ringtone") == 0 ||
+               strcmp(path, "/api/time") == 0 || strcmp(path, "/api/health") == 0) {
+        status = 405;
+    } else {
+        status = 404;
+    }
+
+    if (status != 200) return respond_error(c, status);
+    return respond_json(c, 200, json);
+}
+
+static err_t handle_asset(http_conn_t *c, const char *method, const char *path,
+                          const char *headers, const char *hdr_end) {
+    if (strcmp(path, "/") == 0) path = "/index.html";
+
+    const web_asset_t *asset = NULL;
+    for (int i = 0; i < WEB_ASSET_COUNT; i++) {
+        if (strcmp(web_assets[i].path, path) == 0) {
+            asset = &web_assets[i];
+            break;
+        }
+    }
+    if (!asset) return respond_error(c, 404);
+    if (strcmp(method, "GET") != 0) return respond_error(c, 405);
+
+    const char *etag = header_value(headers, hdr_end, "If-None-Match");
+    if (etag && strncmp(etag, asset->etag, strlen(asset->etag)) == 0) {
+        char headers[48];
+        snprintf(headers, sizeof(headers), "ETag: %s\r\n", asset->etag);
+        not_modified++;
+        return respond(c, 304, headers, "");
+    }
+
+    // Header and gzip body both go out straight from flash
+    return start_response(c, asset->header, asset->header_len, asset->data, asset->length);
+}
+
+// Handles the request once it is complete; ERR_INPROGRESS while it is not
+static err_t handle_request(http_conn_t *c, bool overflow) {
+    char *hdr_end = strstr(c->req, "\r\n\r\n");
+    if (!hdr_end) {
+        return overflow ? respond_error(c, 413) : ERR_INPROGRESS;
+    }
+
+    // hdr_end was found, so the request line has its "\r\n"
+    const char *headers = strstr(c->req, "\r\n");
+    const char *length_hdr = header_value(headers, hdr_end, "Content-Length");
+    long content_length = length_hdr ? strtol(length_hdr, NULL, 10) : 0;
+    char *body = hdr_end + 4;
+    long received = c->req + c->req_len - body;
+    if (content_length < 0 || content_length > HTTP_REQ_MAX - (body - c->req)) {
+        return respond_error(c, 413);
+    }
+    if (received < content_length) {
+        return overflow ? respond_error(c, 413) : ERR_INPROGRESS;
+    }
+    body[content_length] = '\0';
+    requests++;
+
+    // Request line: METHOD SP PATH[?query] SP VERSION
+    char *method = c->req;
+    char *path = strchr(method, ' ');
+    if (!path || path > hdr_end) return respond_error(c, 400);
+    *path++ = '\0';
+    char *version = strchr(path, ' ');
+    if (!version || version > hdr_end) return respond_error(c, 400);
+    *version = '\0';
+    char *query = strchr(path, '?');
+    if (query) *query = '\0';
+
+    if (strncmp(path, "/api/", 5) == 0) {
+        return handle_api(c, method, path, body);
+    }
+    return handle_asset(c, method, path, headers, hdr_end);
+}
+
+static err_t conn_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    http_conn_t *c = arg;
+    if (!p) {
+        // Peer closed its side: finish sending whatever is under way
+        return c->responding ? ERR_OK : conn_close(c, false);
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    c->idle_polls = 0;
+    if (c->responding) {
+        pbuf_free(p); // One request per connection
+        return ERR_OK;
+    }
+
+    uint16_t room = HTTP_REQ_MAX - c->req_len;
+    uint16_t n = p->tot_len < room ? p->tot_len : room;
+    bool overflow = n < p->tot_len;
+    pbuf_copy_partial(p, c->req + c->req_len, n, 0);
+    pbuf_free(p);
+    c->req_len += n;
+    c->req[c->req_len] = '\0';
+
+    err_t result = handle_request(c, overflow);
+    return result == ERR_INPROGRESS ? ERR_OK : result;
+}
+
+static err_t conn_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    http_conn_t *c = arg;
+    c->unacked -= len;
+    c->idle_polls = 0;
+    bytes_sent += len;
+    return conn_send(c);
+}
+
+static err_t conn_poll(void *arg, struct tcp_pcb *pcb) {
+    http_conn_t *c = arg;
+    if (++c->idle_polls >= HTTP_IDLE_TIMEOUT_POLLS) {
+        timeouts++;
+        return conn_close(c, true);
+    }
+    // Picks up writes that failed with ERR_MEM
+    return c->responding ? conn_send(c) : ERR_OK;
+}
+
+// The pcb is already gone when this is called
+static void conn_err(void *arg, err_t err) {
+    http_conn_t *c = arg;
+    if (c && c->pcb) {
+        c->pcb = NULL;
+        if (--active == 0) radio_release(RADIO_USER_HTTP);
+        errors++;
+    }
+}
+
+static err_t http_accept(void *arg, struct tcp_pcb *newpcb, err_t err) {
+    if (err != ERR_OK || !newpcb) return ERR_VAL;
+
+    http_conn_t *c = NULL;
+    for (int i = 0; i < HTTP_MAX_CONNS; i++) {
+        if (!conns[i].pcb) {
+            c = &conns[i];
+            break;
+        }
+    }
+    if (!c) {
+        rejected++;
+        tcp_abort(newpcb);
+        return ERR_ABRT;
+    }
+
+    c->pcb = newpcb;
+    c->req_len = 0;
+    c->req[0] = '\0';
+    c->responding = false;
+    c->idle_polls = 0;
+    c->num_parts = 0;
+    c->part = 0;
+    c->part_off = 0;
+    c->unacked = 0;
+
+    tcp_arg(newpcb, c);
+    tcp_recv(newpcb, conn_recv);
+    tcp_sent(newpcb, conn_sent);
+    tcp_err(newpcb, conn_err);
+    tcp_poll(newpcb, conn_poll, HTTP_POLL_INTERVAL);
+
+    accepted++;
+    if (++active > peak_active) peak_active = active;
+    radio_request(RADIO_USER_HTTP); // Full power while a client is talking to us
+    return ERR_OK;
+}
+
+bool http_server_start(void) {
+    if (listen_pcb) return true;
+
+    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        printf("HTTP: failed to create TCP PCB\n");
+        return false;
+    }
+    if (tcp_bind(pcb, IP_ANY_TYPE, HTTP_PORT) != ERR_OK) {
+        printf("HTTP: failed to bind port %d\n", HTTP_PORT);
+        tcp_close(pcb);
+        return false;
+    }
+    listen_pcb = tcp_listen(pcb);
+    if (!listen_pcb) {
+        printf("HTTP: failed to listen\n");
+        tcp_close(pcb);
+        return false;
+    }
+    tcp_accept(listen_pcb, http_accept);
+
+    printf("HTTP server listening on port %d (%d assets)\n", HTTP_PORT, WEB_ASSET_COUNT);
+    return true;
+}
+
+void http_server_print_stats(void) {
+    printf("HTTP server: %s\n", listen_pcb ? "listening" : "not running");
+    printf("  connections %d active, %d peak, %lu accepted, %lu rejected (pool of %d)\n",
+           active, peak_active, (unsigned long)accepted, (unsigned long)rejected, HTTP_MAX_CONNS);
+    printf("  requests    %lu, %lu errors, %lu not modified\n",
+           (unsigned long)requests, (unsigned long)bad_requests, (unsigned long)not_modified);
+    printf("  closed      %lu timeouts, %lu resets\n", (unsigned long)timeouts, (unsigned long)errors);
+    printf("  sent        %lu bytes, %lu write stalls\n", (unsigned long)bytes_sent, (unsigned long)write_stalls);
+}
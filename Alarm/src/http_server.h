@@ -0,0 +1,23 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <stdbool.h>
+
+// HTTP/1.1 control API on TCP 80 (lwIP raw API, cyw43 async context).
+// Serves the gzipped web UI from flash and a small JSON API:
+//   GET     /api/time      local time, UTC and sync state
+//   GET     /api/health    uptime, RSSI, server counters
+//   GET/PUT /api/alarm     {"hour":7,"minute":30,"enabled":true}
+//   GET/PUT /api/ringtone  {"selected":1} (GET also lists the options)
+// PUT takes a flat JSON object; fields left out keep their value.
+// Every response is sent with "Connection: close".
+// Enabled with the ALARM_HTTP_SERVER CMake option.
+
+// Starts listening; call with the lwIP lock held. The listener survives
+// Wi-Fi reconnects.
+bool http_server_start(void);
+
+// Prints connection and request counters (console key 'h')
+void http_server_print_stats(void);
+
+#endif // HTTP_SERVER_H
@@ -19,10 +19,18 @@ void ssd1306_send_command(uint8_t command) {
     i2c_write_blocking(i2c1, ssd1306_i2c_address, buffer, 2, false);
 }
 
-// Envia uma lista de comandos ao hardware
+// Envia uma lista de comandos ao hardware numa única transação
+// (byte de controle 0x00 seguido de todos os comandos)
 void ssd1306_send_command_list(uint8_t *ssd, int number) {
-    for (int i = 0; i < number; i++) {
-        ssd1306_send_command(ssd[i]);
+    uint8_t buffer[32];
+
+    while (number > 0) {
+        int chunk = number < (int)sizeof(buffer) - 1 ? number : (int)sizeof(buffer) - 1;
+        buffer[0] = 0x00;
+        memcpy(buffer + 1, ssd, chunk);
+        i2c_write_blocking(i2c1, ssd1306_i2c_address, buffer, chunk + 1, false);
+        ssd += chunk;
+        number -= chunk;
     }
 }
 
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "input.h"
+#include "joystick.h"
+#include "debounce.h"
+
+#define INPUT_SCAN_MS 5
+#define INPUT_DEBOUNCE_MS 10
+#define INPUT_QUEUE_SIZE 32    // Power of two
+
+// Producers are the scan timer and the debounce PIO IRQ, both on core 0 at
+// the same priority so they never preempt each other; the consumer is the
+// main loop. head is only written by producers and tail by the consumer,
+// so no lock is needed.
+static input_event_t queue[INPUT_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0;
+static volatile uint32_t queue_tail = 0;
+static volatile uint32_t dropped = 0;
+static volatile uint32_t last_event_ms = 0;
+
+typedef struct {
+    input_repeat_config_t config;
+    bool down;
+    uint32_t pressed_ms;
+    uint32_t next_repeat_ms;
+    uint32_t interval_ms;
+    uint16_t repeats;
+    bool long_sent;
+} key_state_t;
+
+static key_state_t keys[INPUT_KEY_COUNT];
+static volatile uint32_t down_mask = 0;
+static repeating_timer_t scan_timer;
+
+// Joystick: hold to scroll, faster the longer it is held
+static const input_repeat_config_t joystick_repeat = {
+    .delay_ms = 400, .interval_ms = 150, .min_interval_ms = 30, .accel_percent = 85, .long_press_ms = 0
+};
+// Buttons: no repeat, long press after one second
+static const input_repeat_config_t button_repeat = {
+    .delay_ms = 0, .interval_ms = 0, .min_interval_ms = 0, .accel_percent = 100, .long_press_ms = 1000
+};
+
+static void push(input_event_type_t type, input_key_t key, uint16_t value, uint32_t time_ms) {
+    uint32_t head = queue_head;
+    last_event_ms = time_ms;
+    if (head - queue_tail >= INPUT_QUEUE_SIZE) {
+        dropped++;
+        return;
+    }
+    input_event_t *e = &queue[head % INPUT_QUEUE_SIZE];
+    e->time_ms = time_ms;
+    e->type = type;
+    e->key = key;
+    e->value = value;
+    __compiler_memory_barrier(); // Event contents before the new head
+    queue_head = head + 1;
+}
+
+static bool read_joystick(input_key_t key) {
+    switch (key) {
+        case INPUT_KEY_UP:    return joystick_up();
+        case INPUT_KEY_DOWN:  return joystick_down();
+        case INPUT_KEY_LEFT:  return joystick_left();
+        case INPUT_KEY_RIGHT: return joystick_right();
+        default:              return false;
+    }
+}
+
+static void key_changed(input_key_t key, key_state_t *k, bool down, uint32_t when_ms) {
+    k->down = down;
+    if (!down) {
+        down_mask &= ~INPUT_KEY_MASK(key);
+        push(INPUT_RELEASE, key, 0, when_ms);
+        return;
+    }
+
+    uint32_t others = down_mask;
+    down_mask |= INPUT_KEY_MASK(key);
+    k->pressed_ms = when_ms;
+    k->next_repeat_ms = when_ms + k->config.delay_ms;
+    k->interval_ms = k->config.interval_ms;
+    k->repeats = 0;
+    k->long_sent = false;
+    push(INPUT_PRESS, key, 0, when_ms);
+    if (others) {
+        push(INPUT_CHORD, key, down_mask, when_ms);
+    }
+}
+
+static void key_held(input_key_t key, key_state_t *k, uint32_t now_ms) {
+    const input_repeat_config_t *cfg = &k->config;
+
+    if (cfg->long_press_ms && !k->long_sent && now_ms - k->pressed_ms >= cfg->long_press_ms) {
+        k->long_sent = true;
+        push(INPUT_LONG_PRESS, key, 0, now_ms);
+    }
+
+    if (cfg->interval_ms && (int32_t)(now_ms - k->next_repeat_ms) >= 0) {
+        push(INPUT_REPEAT, key, ++k->repeats, now_ms);
+        k->next_repeat_ms += k->interval_ms;
+        uint32_t next = k->interval_ms * cfg->accel_percent / 100;
+        k->interval_ms = next < cfg->min_interval_ms ? cfg->min_interval_ms : next;
+    }
+}
+
+static bool scan_timer_cb(repeating_timer_t *rt) {
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+
+    for (int i = 0; i < INPUT_KEY_COUNT; i++) {
+        key_state_t *k = &keys[i];
+
+        // The joystick is already averaged and has hysteresis; button
+        // edges arrive from the debounce IRQ
+        if (i >= INPUT_KEY_UP) {
+            bool raw = read_joystick(i);
+            if (raw != k->down) {
+                key_changed(i, k, raw, now_ms);
+                continue;
+            }
+        }
+        if (k->down) {
+            key_held(i, k, now_ms);
+        }
+    }
+    return true;
+}
+
+// Button A and B are pins 0 and 1 of the debouncer, same order as the keys
+static void button_edge_cb(uint index, bool pressed, uint32_t time_ms) {
+    input_key_t key = INPUT_KEY_A + index;
+    if (key <= INPUT_KEY_B && keys[key].down != pressed) {
+        key_changed(key, &keys[key], pressed, time_ms);
+    }
+}
+
+void input_init(void) {
+    for (int i = 0; i < INPUT_KEY_COUNT; i++) {
+        keys[i].config = (i >= INPUT_KEY_UP) ? joystick_repeat : button_repeat;
+    }
+    debounce_init(BUTTON_A_PIN, INPUT_DEBOUNCE_MS, button_edge_cb);
+    add_repeating_timer_ms(INPUT_SCAN_MS, scan_timer_cb, NULL, &scan_timer);
+}
+
+void input_set_repeat(input_key_t key, const input_repeat_config_t *config) {
+    if (key >= INPUT_KEY_COUNT) return;
+    uint32_t irq = save_and_disable_interrupts();
+    keys[key].config = *config;
+    restore_interrupts(irq);
+}
+
+bool input_poll(input_event_t *event) {
+    uint32_t tail = queue_tail;
+    if (tail == queue_head) return false;
+    __compiler_memory_barrier(); // New head before the event contents
+    *event = queue[tail % INPUT_QUEUE_SIZE];
+    queue_tail = tail + 1;
+    return true;
+}
+
+bool input_wait(input_event_t *event, uint32_t timeout_ms) {
+    absolute_time_t deadline = make_timeout_time_ms(timeout_ms);
+    while (!input_poll(event)) {
+        if (time_reached(deadline)) return false;
+        tight_loop_contents();
+    }
+    return true;
+}
+
+void input_flush(void) {
+    queue_tail = queue_head;
+}
+
+bool input_key_down(input_key_t key) {
+    return key < INPUT_KEY_COUNT && (down_mask & INPUT_KEY_MASK(key));
+}
+
+uint32_t input_dropped(void) {
+    return dropped;
+}
+
+uint32_t input_last_event_ms(void) {
+    return last_event_ms;
+}
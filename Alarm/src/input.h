@@ -0,0 +1,70 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    INPUT_KEY_A,
+    INPUT_KEY_B,
+    INPUT_KEY_UP,
+    INPUT_KEY_DOWN,
+    INPUT_KEY_LEFT,
+    INPUT_KEY_RIGHT,
+    INPUT_KEY_COUNT
+} input_key_t;
+
+typedef enum {
+    INPUT_PRESS,
+    INPUT_RELEASE,
+    INPUT_REPEAT,     // Key still held, value = repeat number (1, 2, ...)
+    INPUT_LONG_PRESS, // Key held for long_press_ms, sent once per press
+    INPUT_CHORD       // A key went down while others were held, value = mask of held keys
+} input_event_type_t;
+
+typedef struct {
+    uint32_t time_ms; // When the key changed state (ms since boot)
+    uint8_t type;     // input_event_type_t
+    uint8_t key;      // input_key_t
+    uint16_t value;
+} input_event_t;
+
+// Auto-repeat: first repeat after delay_ms, then every interval, which
+// shrinks by accel_percent per repeat down to min_interval_ms.
+// interval_ms = 0 disables repeat, long_press_ms = 0 disables long press.
+typedef struct {
+    uint16_t delay_ms;
+    uint16_t interval_ms;
+    uint16_t min_interval_ms;
+    uint8_t accel_percent;
+    uint16_t long_press_ms;
+} input_repeat_config_t;
+
+#define INPUT_KEY_MASK(key) (1u << (key))
+
+// Starts the button debouncer and the scan timer (call after joystick_init)
+void input_init(void);
+
+// Replace the repeat/long-press behaviour of one key
+void input_set_repeat(input_key_t key, const input_repeat_config_t *config);
+
+// Non-blocking: pops the oldest event, false if the queue is empty
+bool input_poll(input_event_t *event);
+
+// Waits up to timeout_ms for an event
+bool input_wait(input_event_t *event, uint32_t timeout_ms);
+
+// Drops queued events, e.g. after showing a message screen
+void input_flush(void);
+
+// Debounced level of a key
+bool input_key_down(input_key_t key);
+
+// Events lost because the queue was full
+uint32_t input_dropped(void);
+
+// Time of the most recent event (ms since boot, 0 = none yet); lets
+// background work stay out of the way while someone uses the clock
+uint32_t input_last_event_ms(void);
+
+#endif // INPUT_H
@@ -2,104 +2,110 @@
 #include "pico/stdlib.h"
 #include "hardware/irq.h"
 #include "hardware/adc.h"
+#include "hardware/dma.h"
 #include <stdio.h>
 
 // Joystick ADC pins
 #define JOYSTICK_X_PIN 27
 #define JOYSTICK_Y_PIN 26
 
-// Threshold values for movement detection
-#define JOYSTICK_THRESHOLD_LEFT 500
-#define JOYSTICK_THRESHOLD_RIGHT 3900
-#define JOYSTICK_THRESHOLD_UP 3900
-#define JOYSTICK_THRESHOLD_DOWN 500
-
-// Button pins
-#define BUTTON_A_PIN 5
-#define BUTTON_B_PIN 6
-
-// Debounce time in milliseconds
-#define DEBOUNCE_TIME_MS 250
-
-// Button press flags
-static volatile bool button_a_flag = false;
-static volatile bool button_b_flag = false;
-
-// Last press timestamps (milliseconds)
-static volatile uint32_t last_press_a = 0;
-static volatile uint32_t last_press_b = 0;
+// ADC inputs for each axis (ADC0 = GPIO26, ADC1 = GPIO27)
+#define JOYSTICK_Y_INPUT 0
+#define JOYSTICK_X_INPUT 1
+
+// Threshold values for movement detection. A direction becomes active past
+// the PRESS threshold and is only released back inside RELEASE.
+#define JOYSTICK_THRESHOLD_LOW_PRESS 500
+#define JOYSTICK_THRESHOLD_LOW_RELEASE 1000
+#define JOYSTICK_THRESHOLD_HIGH_PRESS 3900
+#define JOYSTICK_THRESHOLD_HIGH_RELEASE 3400
+
+// Free-running sampling: both axes round-robin at 2 kHz total, written by
+// DMA into a ring of 32 samples per axis (~32 ms averaging window).
+#define JOYSTICK_SAMPLE_RATE_HZ 2000
+#define JOYSTICK_RING_BITS 7 // 128 bytes = 64 x uint16_t
+#define JOYSTICK_RING_SAMPLES ((1u << JOYSTICK_RING_BITS) / sizeof(uint16_t))
+
+// Even slots hold ADC0 (Y), odd slots ADC1 (X). The DMA write ring must be
+// aligned to its size.
+static uint16_t adc_ring[JOYSTICK_RING_SAMPLES] __attribute__((aligned(1u << JOYSTICK_RING_BITS)));
+static int adc_dma_chan;
+static int adc_ctrl_chan;
+static uint32_t adc_dma_count = 0xFFFFFFFFu; // Re-armed by adc_ctrl_chan
+
+// Hysteresis state per direction
+static bool left_active, right_active, up_active, down_active;
+
+// Initialize the joystick axes (buttons are handled by debounce.c)
+void joystick_init(void) {
+    // Initialize ADC for joystick axes
+    adc_init();
+    adc_gpio_init(JOYSTICK_X_PIN);
+    adc_gpio_init(JOYSTICK_Y_PIN);
 
-// Interrupt handler for button presses
-static void gpio_callback(uint gpio, uint32_t events) {
-    uint32_t now = time_us_32() / 1000; // Get current time in ms
+    // Round-robin over both axes; each conversion is pushed to the FIFO
+    adc_select_input(JOYSTICK_Y_INPUT);
+    adc_set_round_robin((1u << JOYSTICK_Y_INPUT) | (1u << JOYSTICK_X_INPUT));
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(48000000.f / JOYSTICK_SAMPLE_RATE_HZ - 1);
+
+    // Data channel: ADC FIFO -> ring, forever
+    adc_dma_chan = dma_claim_unused_channel(true);
+    adc_ctrl_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(adc_dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, JOYSTICK_RING_BITS);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    channel_config_set_chain_to(&c, adc_ctrl_chan);
+    dma_channel_configure(adc_dma_chan, &c, adc_ring, &adc_hw->fifo, adc_dma_count, false);
+
+    // Control channel: when the count ever runs out, reload it and retrigger
+    dma_channel_config cc = dma_channel_get_default_config(adc_ctrl_chan);
+    channel_config_set_transfer_data_size(&cc, DMA_SIZE_32);
+    channel_config_set_read_increment(&cc, false);
+    channel_config_set_write_increment(&cc, false);
+    dma_channel_configure(adc_ctrl_chan, &cc, &dma_hw->ch[adc_dma_chan].al1_transfer_count_trig,
+                          &adc_dma_count, 1, false);
+
+    dma_channel_start(adc_dma_chan);
+    adc_run(true);
 
-    if (gpio == BUTTON_A_PIN && (now - last_press_a > DEBOUNCE_TIME_MS)) {
-        last_press_a = now;
-        button_a_flag = true;
-    }
+}
 
-    if (gpio == BUTTON_B_PIN && (now - last_press_b > DEBOUNCE_TIME_MS)) {
-        last_press_b = now;
-        button_b_flag = true;
+// Average of the latest samples of one axis, straight from the ring
+static uint16_t axis_average(uint input) {
+    uint32_t sum = 0;
+    for (uint i = input; i < JOYSTICK_RING_SAMPLES; i += 2) {
+        sum += adc_ring[i];
     }
+    return sum / (JOYSTICK_RING_SAMPLES / 2);
 }
 
-// Initialize joystick and buttons
-void joystick_init(void) {
-    sleep_ms(500); // Small delay to stabilize initialization
-    
-    // Initialize ADC for joystick axes
-    adc_init();
-    adc_gpio_init(JOYSTICK_X_PIN);
-    adc_gpio_init(JOYSTICK_Y_PIN);
+static bool below(bool *active, uint16_t value) {
+    *active = value < (*active ? JOYSTICK_THRESHOLD_LOW_RELEASE : JOYSTICK_THRESHOLD_LOW_PRESS);
+    return *active;
+}
 
-    // Initialize button A
-    gpio_init(BUTTON_A_PIN);
-    gpio_set_dir(BUTTON_A_PIN, GPIO_IN);
-    gpio_pull_up(BUTTON_A_PIN);
-    gpio_set_irq_enabled_with_callback(BUTTON_A_PIN, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
-
-    // Initialize button B
-    gpio_init(BUTTON_B_PIN);
-    gpio_set_dir(BUTTON_B_PIN, GPIO_IN);
-    gpio_pull_up(BUTTON_B_PIN);
-    gpio_set_irq_enabled_with_callback(BUTTON_B_PIN, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
+static bool above(bool *active, uint16_t value) {
+    *active = value > (*active ? JOYSTICK_THRESHOLD_HIGH_RELEASE : JOYSTICK_THRESHOLD_HIGH_PRESS);
+    return *active;
 }
 
 // Read joystick movement
 bool joystick_left(void) {
-    adc_select_input(1);
-    return adc_read() < JOYSTICK_THRESHOLD_LEFT;
+    return below(&left_active, axis_average(JOYSTICK_X_INPUT));
 }
 
 bool joystick_right(void) {
-    adc_select_input(1);
-    return adc_read() > JOYSTICK_THRESHOLD_RIGHT;
+    return above(&right_active, axis_average(JOYSTICK_X_INPUT));
 }
 
 bool joystick_up(void) {
-    adc_select_input(0);
-    return adc_read() > JOYSTICK_THRESHOLD_UP;
+    return above(&up_active, axis_average(JOYSTICK_Y_INPUT));
 }
 
 bool joystick_down(void) {
-    adc_select_input(0);
-    return adc_read() < JOYSTICK_THRESHOLD_DOWN;
-}
-
-// Read button states
-bool button_a_pressed(void) {
-    if (button_a_flag) {
-        button_a_flag = false;
-        return true;
-    }
-    return false;
-}
-
-bool button_b_pressed(void) {
-    if (button_b_flag) {
-        button_b_flag = false;
-        return true;
-    }
-    return false;
+    return below(&down_active, axis_average(JOYSTICK_Y_INPUT));
 }
@@ -3,7 +3,11 @@
 
 #include <stdbool.h>
 
-// Initialize joystick and buttons
+// Button pins (consecutive, debounced together by the PIO)
+#define BUTTON_A_PIN 5
+#define BUTTON_B_PIN 6
+
+// Initialize the joystick axes
 void joystick_init(void);
 
 // Joystick movement detection
@@ -12,8 +16,4 @@ bool joystick_right(void);
 bool joystick_up(void);
 bool joystick_down(void);
 
-// Button press detection
-bool button_a_pressed(void);
-bool button_b_pressed(void);
-
 #endif // JOYSTICK_H
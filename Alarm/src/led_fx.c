@@ -0,0 +1,164 @@
+#include "pico/stdlib.h"
+#include "led_fx.h"
+#include "matrix.h"
+
+#define LED_FX_FRAME_MS 20 // 50 Hz render rate
+#define CHASE_TAIL 3
+
+// Sunrise keyframes, position in 1/1024 of the duration
+typedef struct {
+    uint16_t pos;
+    led_color_t color;
+} led_keyframe_t;
+
+static const led_keyframe_t sunrise_keys[] = {
+    {0,    {0, 0, 0}},
+    {300,  {60, 4, 0}},
+    {600,  {180, 50, 4}},
+    {850,  {255, 140, 40}},
+    {1024, {255, 210, 150}},
+};
+
+static const led_color_t palette[] = {
+    {255, 255, 255}, // White
+    {255, 160, 60},  // Warm
+    {255, 0, 0},     // Red
+    {0, 255, 0},     // Green
+    {0, 0, 255},     // Blue
+};
+#define PALETTE_SIZE (sizeof(palette) / sizeof(palette[0]))
+
+// Effect parameters (written by led_fx_start with IRQs off)
+static volatile led_fx_t fx = LED_FX_OFF;
+static led_color_t fx_color;
+static led_color_t fx_from;
+static uint32_t fx_period_ms = 1;
+static uint32_t fx_start_ms;
+static volatile int brightness = LED_BRIGHTNESS_MAX;
+
+// Last linear frame, the start point for fades
+static led_color_t frame[LED_COUNT];
+// Temporal dithering: fractional output carried per LED channel
+static uint8_t dither[LED_COUNT][3];
+static bool frame_dirty = true;
+static repeating_timer_t fx_timer;
+
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint32_t t_q8) {
+    return (uint8_t)(a + (((int32_t)b - a) * (int32_t)t_q8 >> 8));
+}
+
+static led_color_t lerp_color(led_color_t a, led_color_t b, uint32_t t_q8) {
+    led_color_t c = { lerp8(a.r, b.r, t_q8), lerp8(a.g, b.g, t_q8), lerp8(a.b, b.b, t_q8) };
+    return c;
+}
+
+static led_color_t scale_color(led_color_t c, uint32_t k_q8) {
+    led_color_t s = { (uint8_t)(c.r * k_q8 >> 8), (uint8_t)(c.g * k_q8 >> 8), (uint8_t)(c.b * k_q8 >> 8) };
+    return s;
+}
+
+// Linear 8-bit -> gamma/brightness LUT (8.8) -> dithered 8-bit
+static inline uint8_t output_channel(uint8_t value, uint8_t *err) {
+    uint32_t v = led_level_lut[brightness][value] + *err;
+    *err = v & 0xFF;
+    return (uint8_t)(v >> 8);
+}
+
+static led_color_t sunrise_at(uint32_t pos) {
+    for (uint i = 1; i < sizeof(sunrise_keys) / sizeof(sunrise_keys[0]); i++) {
+        if (pos <= sunrise_keys[i].pos) {
+            const led_keyframe_t *a = &sunrise_keys[i - 1];
+            const led_keyframe_t *b = &sunrise_keys[i];
+            uint32_t t_q8 = ((pos - a->pos) << 8) / (b->pos - a->pos);
+            return lerp_color(a->color, b->color, t_q8);
+        }
+    }
+    return sunrise_keys[0].color;
+}
+
+static void render(uint32_t now_ms) {
+    uint32_t elapsed = now_ms - fx_start_ms;
+    led_color_t all = {0, 0, 0};
+
+    switch (fx) {
+        case LED_FX_SOLID:
+            all = fx_color;
+            break;
+        case LED_FX_FADE: {
+            uint32_t t_q8 = elapsed >= fx_period_ms ? 256 : (elapsed << 8) / fx_period_ms;
+            all = lerp_color(fx_from, fx_color, t_q8);
+            break;
+        }
+        case LED_FX_PULSE: {
+            uint32_t phase = ((elapsed % fx_period_ms) << 9) / fx_period_ms; // 0..511
+            uint32_t tri = phase < 256 ? phase : 511 - phase;
+            all = scale_color(fx_color, tri);
+            break;
+        }
+        case LED_FX_SUNRISE: {
+            uint32_t pos = elapsed >= fx_period_ms ? 1024 : (elapsed << 10) / fx_period_ms;
+            all = sunrise_at(pos);
+            break;
+        }
+        default:
+            break;
+    }
+
+    if (fx == LED_FX_CHASE) {
+        uint32_t head = (elapsed / fx_period_ms) % LED_COUNT;
+        for (uint i = 0; i < LED_COUNT; i++) {
+            uint32_t behind = (head + LED_COUNT - i) % LED_COUNT;
+            frame[i] = behind <= CHASE_TAIL ? scale_color(fx_color, 256 >> behind) : all;
+        }
+    } else {
+        for (uint i = 0; i < LED_COUNT; i++) {
+            frame[i] = all;
+        }
+    }
+
+    for (uint i = 0; i < LED_COUNT; i++) {
+        npSetLED(i, output_channel(frame[i].r, &dither[i][0]),
+                    output_channel(frame[i].g, &dither[i][1]),
+                    output_channel(frame[i].b, &dither[i][2]));
+    }
+    matrix_update();
+}
+
+static bool fx_timer_cb(repeating_timer_t *rt) {
+    // Once off, render one black frame and then stay idle
+    if (fx != LED_FX_OFF || frame_dirty) {
+        frame_dirty = (fx != LED_FX_OFF);
+        render(to_ms_since_boot(get_absolute_time()));
+    }
+    return true;
+}
+
+void led_fx_init(void) {
+    add_repeating_timer_ms(LED_FX_FRAME_MS, fx_timer_cb, NULL, &fx_timer);
+}
+
+void led_fx_start(led_fx_t new_fx, led_color_t color, uint32_t period_ms) {
+    uint32_t irq = save_and_disable_interrupts();
+    fx_from = frame[0];
+    fx_color = color;
+    fx_period_ms = period_ms ? period_ms : 1;
+    fx_start_ms = to_ms_since_boot(get_absolute_time());
+    fx = new_fx;
+    frame_dirty = true;
+    restore_interrupts(irq);
+}
+
+void led_fx_set_brightness(int level) {
+    if (level < 0) level = 0;
+    if (level > LED_BRIGHTNESS_MAX) level = LED_BRIGHTNESS_MAX;
+    brightness = level;
+}
+
+led_color_t led_fx_palette(int index) {
+    if (index < 0 || index >= (int)PALETTE_SIZE) index = 0;
+    return palette[index];
+}
+
+int led_fx_palette_size(void) {
+    return PALETTE_SIZE;
+}
@@ -0,0 +1,33 @@
+#ifndef LED_FX_H
+#define LED_FX_H
+
+#include <stdint.h>
+#include "led_lut.h"
+
+typedef struct {
+    uint8_t r, g, b;
+} led_color_t;
+
+typedef enum {
+    LED_FX_OFF,
+    LED_FX_SOLID,
+    LED_FX_FADE,     // From the last rendered color to `color` over period_ms
+    LED_FX_PULSE,    // Breathing, one cycle per period_ms
+    LED_FX_SUNRISE,  // Black -> red -> orange -> warm white over period_ms
+    LED_FX_CHASE     // One LED with a fading tail, period_ms per step
+} led_fx_t;
+
+// Starts the periodic render timer (call after matrix_init)
+void led_fx_init(void);
+
+// Switches effect; returns immediately, rendering happens in the timer IRQ
+void led_fx_start(led_fx_t fx, led_color_t color, uint32_t period_ms);
+
+// 0..LED_BRIGHTNESS_MAX, applied through the gamma LUT
+void led_fx_set_brightness(int level);
+
+// Menu color index -> RGB
+led_color_t led_fx_palette(int index);
+int led_fx_palette_size(void);
+
+#endif // LED_FX_H
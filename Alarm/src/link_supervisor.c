@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/async_context.h"
+#include "pico/rand.h"
+
+#include "lwip/netif.h"
+
+#include "link_supervisor.h"
+#include "radio.h"
+#include "wifi_time.h"
+#include "time_sync.h"
+
+#define SUPERVISOR_TICK_MS 250
+#define RECONNECT_MIN_MS 1000
+#define RECONNECT_MAX_MS (2 * 60 * 1000)
+#define NTP_RETRY_MS 60000            // Boot sync failed: try again this often
+#define NTP_RETRY_HOLD_MS 30000       // Longest the radio is held for one try
+
+// All state is touched only from the cyw43 async context (lwIP lock held);
+// the netif callbacks run there too
+static bool started = false;
+static async_at_time_worker_t tick_worker;
+static netif_status_callback_fn prev_status_cb = NULL;
+static netif_status_callback_fn prev_link_cb = NULL;
+
+static bool link_up = false;
+static uint64_t up_since_us = 0;
+static uint64_t up_total_us = 0;
+static uint64_t outage_since_us = 0;  // 0 = no outage
+static uint32_t outages = 0;
+static uint32_t last_outage_ms = 0;
+static uint32_t longest_outage_ms = 0;
+
+static bool reconnecting = false;
+static uint32_t backoff_ms = RECONNECT_MIN_MS;
+static absolute_time_t next_attempt;
+static uint32_t attempts = 0;
+static uint32_t attempt_failures = 0;
+static uint32_t resyncs = 0;          // Triggered after an outage
+static uint32_t sync_retries = 0;     // Boot-sync retries; stops growing once synced
+
+static bool sync_pending = false;     // Holding the radio for a boot-sync retry
+static bool sync_started = false;
+static absolute_time_t sync_deadline;
+static absolute_time_t next_sync;
+
+// +-25% so a site that lost its AP together does not reconnect in step
+static uint32_t jittered(uint32_t ms) {
+    return ms - ms / 4 + get_rand_32() % (ms / 2 + 1);
+}
+
+static void start_outage(uint64_t now) {
+    outages++;
+    outage_since_us = now;
+    reconnecting = false;
+    backoff_ms = RECONNECT_MIN_MS;
+    next_attempt = make_timeout_time_ms(jittered(backoff_ms));
+    printf("Wi-Fi: link lost\n");
+}
+
+static void update_link(void) {
+    bool up = wifi_time_link_up();
+    if (up == link_up) return;
+
+    uint64_t now = time_us_64();
+    link_up = up;
+    if (!up) {
+        up_total_us += now - up_since_us;
+        // A radio powering down on purpose is not an outage
+        if (radio_link_expected()) start_outage(now);
+        return;
+    }
+
+    up_since_us = now;
+    reconnecting = false;
+    if (outage_since_us) {
+        last_outage_ms = (uint32_t)((now - outage_since_us) / 1000);
+        if (last_outage_ms > longest_outage_ms) longest_outage_ms = last_outage_ms;
+        outage_since_us = 0;
+        printf("Wi-Fi: link back after %lu ms\n", (unsigned long)last_outage_ms);
+        // The clock ran on its drift model meanwhile; check it now
+        if (wifi_time_synced()) {
+            time_sync_now();
+            resyncs++;
+        }
+    }
+}
+
+static void status_cb(struct netif *n) {
+    if (prev_status_cb) prev_status_cb(n);
+    update_link();
+}
+
+static void link_cb(struct netif *n) {
+    if (prev_link_cb) prev_link_cb(n);
+    update_link();
+}
+
+// netif_add() clears the callbacks, and the interface is added again
+// every time the radio manager powers it back up
+static void install_callbacks(void) {
+    struct netif *n = &cyw43_state.netif[CYW43_ITF_STA];
+    if (n->status_callback != status_cb) {
+        prev_status_cb = n->status_callback;
+        netif_set_status_callback(n, status_cb);
+    }
+    if (n->link_callback != link_cb) {
+        prev_link_cb = n->link_callback;
+        netif_set_link_callback(n, link_cb);
+    }
+}
+
+static void supervise_reconnect(void) {
+    if (wifi_time_busy()) return; // Our attempt (or a radio wake) still running
+
+    if (reconnecting) {
+        // The attempt finished without a link
+        reconnecting = false;
+        attempt_failures++;
+        backoff_ms = backoff_ms * 2 > RECONNECT_MAX_MS ? RECONNECT_MAX_MS : backoff_ms * 2;
+        uint32_t wait_ms = jittered(backoff_ms);
+        next_attempt = make_timeout_time_ms(wait_ms);
+        printf("Wi-Fi: reconnect failed, next try in %lu ms\n", (unsigned long)wait_ms);
+        return;
+    }
+
+    if (time_reached(next_attempt)) {
+        attempts++;
+        reconnecting = wifi_time_reconnect();
+        if (!reconnecting) {
+            attempt_failures++;
+            next_attempt = make_timeout_time_ms(jittered(backoff_ms));
+        }
+    }
+}
+
+// The boot sync failed, so time_sync never started: run the whole DNS +
+// NTP sequence again, holding the radio for it. Once synced, time_sync
+// owns the schedule and this never holds the radio again.
+static void supervise_sync(void) {
+    if (!sync_pending) {
+        if (!wifi_time_synced() && time_reached(next_sync)) {
+            sync_pending = true;
+            sync_started = false;
+            sync_deadline = make_timeout_time_ms(NTP_RETRY_HOLD_MS);
+            radio_request(RADIO_USER_TIME_SYNC);
+        }
+        return;
+    }
+
+    if (!sync_started && link_up && !wifi_time_busy() && !wifi_time_synced()) {
+        sync_started = wifi_time_resync();
+        if (sync_started) sync_retries++;
+    }
+    if ((sync_started && !wifi_time_busy()) || wifi_time_synced() || time_reached(sync_deadline)) {
+        sync_pending = false;
+        radio_release(RADIO_USER_TIME_SYNC);
+        next_sync = make_timeout_time_ms(NTP_RETRY_MS);
+    }
+}
+
+static void tick_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    install_callbacks();
+    update_link(); // Also catches anything that changed before the callbacks were in
+
+    if (!radio_link_expected()) {
+        // Powered down or waking: the radio manager owns the link
+        outage_since_us = 0;
+        reconnecting = false;
+    } else if (!link_up) {
+        if (!outage_since_us) start_outage(time_us_64());
+        supervise_reconnect();
+    }
+    supervise_sync();
+
+    async_context_add_at_time_worker_in_ms(context, worker, SUPERVISOR_TICK_MS);
+}
+
+void link_supervisor_start(void) {
+    if (started) return;
+    started = true;
+
+    link_up = wifi_time_link_up();
+    up_since_us = time_us_64();
+    next_sync = get_absolute_time();
+    install_callbacks();
+
+    tick_worker.do_work = tick_worker_fn;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &tick_worker, SUPERVISOR_TICK_MS);
+}
+
+void link_supervisor_print_stats(void) {
+    // Snapshot under the lock, print outside it
+    cyw43_arch_lwip_begin();
+    uint64_t now = time_us_64();
+    bool up = link_up;
+    uint64_t up_us = up_total_us + (link_up ? now - up_since_us : 0);
+    uint64_t current_us = link_up ? now - up_since_us : 0;
+    uint64_t down_us = outage_since_us ? now - outage_since_us : 0;
+    uint32_t backoff = backoff_ms;
+    cyw43_arch_lwip_end();
+
+    if (!started) {
+        printf("Wi-Fi link: boot connect still running\n");
+        return;
+    }
+    if (up) {
+        printf("Wi-Fi link: up for %llu s\n", (unsigned long long)(current_us / 1000000));
+    } else if (down_us) {
+        printf("Wi-Fi link: down for %llu s, reconnecting (backoff %lu ms)\n",
+               (unsigned long long)(down_us / 1000000), (unsigned long)backoff);
+    } else {
+        printf("Wi-Fi link: down (radio off)\n");
+    }
+    printf("  up %llu s in total, %lu outages (last %lu ms, longest %lu ms)\n",
+           (unsigned long long)(up_us / 1000000), (unsigned long)outages,
+           (unsigned long)last_outage_ms, (unsigned long)longest_outage_ms);
+    printf("  %lu reconnect attempts, %lu failed, %lu resyncs after outages\n",
+           (unsigned long)attempts, (unsigned long)attempt_failures, (unsigned long)resyncs);
+    printf("  NTP %s, %lu boot-sync retries\n", wifi_time_synced() ? "synced" : "not synced",
+           (unsigned long)sync_retries);
+}
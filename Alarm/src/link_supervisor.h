@@ -0,0 +1,17 @@
+#ifndef LINK_SUPERVISOR_H
+#define LINK_SUPERVISOR_H
+
+// Watches the STA interface through the lwIP netif link/status callbacks
+// and, whenever the link drops while the radio manager expects it up,
+// reconnects in the background with jittered exponential backoff
+// (1 s up to 2 min). After an outage it triggers an immediate NTP resync;
+// if the boot sync never succeeded it keeps retrying that instead.
+// Everything runs in the cyw43 async context, never in the UI loop.
+
+// Called by wifi_time once the boot connect has finished
+void link_supervisor_start(void);
+
+// Link uptime, outages and reconnect attempts (console key 'w')
+void link_supervisor_print_stats(void);
+
+#endif // LINK_SUPERVISOR_H
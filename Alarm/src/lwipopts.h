@@ -23,6 +23,8 @@
 #define MEMP_NUM_TCP_SEG            32
 #define MEMP_NUM_ARP_QUEUE          10
 #define PBUF_POOL_SIZE              24
+#define MEMP_NUM_UDP_PCB            6   // DHCP, DNS, NTP client, SNTP server, fleet + spare
+#define MEMP_NUM_TCP_PCB            7   // HTTP pool (4), MQTT, OTA + one in TIME_WAIT
 #define LWIP_ARP                    1
 #define LWIP_ETHERNET               1
 #define LWIP_ICMP                   1
@@ -46,8 +48,11 @@
 #define LWIP_TCP                    1
 #define LWIP_UDP                    1
 #define LWIP_DNS                    1
+#define LWIP_IGMP                   1   // Fleet multicast group (fleet.c)
 #define LWIP_TCP_KEEPALIVE          1
-#define LWIP_NETIF_TX_SINGLE_PBUF   1
+// 0 so tcp_write can queue flash data by reference (http_server.c); with 1
+// lwIP forces TCP_WRITE_FLAG_COPY. The cyw43 driver copies pbuf chains itself.
+#define LWIP_NETIF_TX_SINGLE_PBUF   0
 #define DHCP_DOES_ARP_CHECK         0
 #define LWIP_DHCP_DOES_ACD_CHECK    0
 
@@ -1,38 +1,107 @@
 #include "matrix.h"
 #include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include <string.h>
 #include "ws2818b.pio.h"
 
-// LED structure (GRB format)
-typedef struct {
-    uint8_t G, R, B;
-} npLED_t;
+#define MATRIX_DMA_IRQ DMA_IRQ_0
 
-static npLED_t leds[LED_COUNT];
+// After the DMA finishes, the joined TX FIFO (8 words) plus the word already
+// pulled into the OSR still have to shift out at 30 us per LED, then the
+// line must idle low for the reset/latch (280 us for the WS2812B).
+#define MATRIX_FIFO_DRAIN_US ((8 + 1) * 30)
+#define MATRIX_LATCH_US 300
+
+// LED buffers: one packed word per LED, GRB in bits 31..8 (the PIO shifts
+// out MSB first and autopulls every 24 bits).
+//   back:  written by npSetLED, never seen by the DMA
+//   ready: snapshot taken by matrix_update, waiting for the line to be free
+//   front: being streamed by the DMA
+// ready and front are swapped by pointer, so a frame is shown whole or not
+// at all.
+static uint32_t buffers[3][LED_COUNT];
+static uint32_t *back = buffers[0];
+static uint32_t *ready = buffers[1];
+static uint32_t *front = buffers[2];
+static volatile bool frame_pending = false;
 static PIO np_pio;
 static uint sm;
+static int dma_chan = -1;
+
+// True from the start of a frame until its latch time has elapsed
+static volatile bool frame_busy = false;
+
+// Call with interrupts disabled
+static void start_frame(void) {
+    uint32_t *t = front;
+    front = ready;
+    ready = t;
+    frame_pending = false;
+    frame_busy = true;
+    dma_channel_set_read_addr(dma_chan, front, true);
+}
+
+// Latch interval is over: the line is free for the next frame
+static int64_t latch_done_cb(alarm_id_t id, void *user_data) {
+    uint32_t irq = save_and_disable_interrupts();
+    frame_busy = false;
+    if (frame_pending) {
+        start_frame();
+    }
+    restore_interrupts(irq);
+    return 0;
+}
+
+// DMA finished feeding the FIFO: time the drain + latch on a hardware alarm
+static void matrix_dma_irq_handler(void) {
+    if (dma_chan < 0 || !dma_channel_get_irq0_status(dma_chan)) return;
+    dma_channel_acknowledge_irq0(dma_chan);
+
+    // 0 means latch_done_cb already ran; only a missing slot needs the call
+    if (add_alarm_in_us(MATRIX_FIFO_DRAIN_US + MATRIX_LATCH_US, latch_done_cb, NULL, true) < 0) {
+        latch_done_cb(0, NULL);
+    }
+}
 
 // Initialize the LED matrix
 void matrix_init() {
     uint offset = pio_add_program(pio0, &ws2818b_program);
     np_pio = pio0;
 
-    sm = pio_claim_unused_sm(np_pio, false);
-    if (sm < 0) {
+    int claimed = pio_claim_unused_sm(np_pio, false);
+    if (claimed < 0) {
         np_pio = pio1;
-        sm = pio_claim_unused_sm(np_pio, true);
+        offset = pio_add_program(np_pio, &ws2818b_program);
+        claimed = pio_claim_unused_sm(np_pio, true);
     }
+    sm = claimed;
 
     ws2818b_program_init(np_pio, sm, offset, LED_PIN, 800000.f);
+
+    // One DMA transfer per LED, paced by the state machine's TX FIFO
+    dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(np_pio, sm, true));
+    dma_channel_configure(dma_chan, &c, &np_pio->txf[sm], front, LED_COUNT, false);
+
+    irq_add_shared_handler(MATRIX_DMA_IRQ, matrix_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    dma_channel_set_irq0_enabled(dma_chan, true);
+    irq_set_enabled(MATRIX_DMA_IRQ, true);
+
     matrix_clear();
 }
 
 // Set an individual LED color
 void npSetLED(uint index, uint8_t r, uint8_t g, uint8_t b) {
     if (index < LED_COUNT) {
-        leds[index].R = r;
-        leds[index].G = g;
-        leds[index].B = b;
+        back[index] = ((uint32_t)g << 24) | ((uint32_t)r << 16) | ((uint32_t)b << 8);
     }
 }
 
@@ -44,14 +113,17 @@ void matrix_set_color(uint8_t r, uint8_t g, uint8_t b) {
     matrix_update();
 }
 
-// Send the buffer data to LEDs
+// Queue the current back buffer for display. Never blocks: if a frame is
+// still streaming or latching, the snapshot is sent from the latch callback
+// (a newer update before then replaces it).
 void matrix_update() {
-    for (uint i = 0; i < LED_COUNT; i++) {
-        pio_sm_put_blocking(np_pio, sm, leds[i].G);
-        pio_sm_put_blocking(np_pio, sm, leds[i].R);
-        pio_sm_put_blocking(np_pio, sm, leds[i].B);
+    uint32_t irq = save_and_disable_interrupts();
+    memcpy(ready, back, sizeof(buffers[0]));
+    frame_pending = true;
+    if (!frame_busy) {
+        start_frame();
     }
-    sleep_us(100);
+    restore_interrupts(irq);
 }
 
 // Turn off all LEDs
@@ -0,0 +1,8 @@
+#ifndef MBEDTLS_CONFIG_H
+#define MBEDTLS_CONFIG_H
+
+// mbedtls as built by pico_mbedtls: only the SHA-256 that ota.c uses for
+// image digests and the HMAC
+#define MBEDTLS_SHA256_C
+
+#endif // MBEDTLS_CONFIG_H
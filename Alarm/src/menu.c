@@ -3,33 +3,21 @@
 #include "pico/stdlib.h"      // For sleep_ms, stdio_init_all, etc.
 #include "oled.h"             // For OLED display functions
 #include "joystick.h"         // For joystick navigation
+#include "input.h"            // For button/joystick events
 #include "menu.h"             // (Assumed to have menu declarations)
 #include "hardware/rtc.h"     // For RTC access
 #include "pico/util/datetime.h" // For datetime_t and rtc_get_datetime
 #include "buzzer.h"           // For buzzer control
 #include "matrix.h"           // For LED matrix control
+#include "led_fx.h"           // For LED matrix effects
+#include "settings.h"         // Alarm, ringtone and color (shared with the HTTP API)
+#include "telemetry.h"        // Counts alarm fires
 
 // -------------------------------------------------------------------------
 // Default settings and constants
 // -------------------------------------------------------------------------
 #define BUZZER_PIN 21             
 
-#define DEFAULT_ALARM_HOUR 12
-#define DEFAULT_ALARM_MINUTE 0
-#define DEFAULT_RINGTONE 0
-#define DEFAULT_COLOR 0
-#define DEFAULT_BRIGHTNESS 10
-
-// -------------------------------------------------------------------------
-// Global variables to store user settings
-// -------------------------------------------------------------------------
-static int alarm_hour = DEFAULT_ALARM_HOUR;
-static int alarm_minute = DEFAULT_ALARM_MINUTE;
-static int alarm_second = 0;
-static int ringtone = DEFAULT_RINGTONE;
-static int color = DEFAULT_COLOR;
-static int brightness = DEFAULT_BRIGHTNESS;
-
 // Menu options strings
 const char *menu_options[] = {
     "1 Alarm",
@@ -42,20 +30,21 @@ const char *menu_options[] = {
 static int menu_context = 0;               // 0: Main menu, 1: Alarm config, etc.
 static int last_selected_option = -1;      // Tracks last drawn selection index
 static bool clear_display = false;         // Flag for forcing a display clear
+static uint32_t drawn_settings = 0;        // settings_version() the menu was drawn with
 
-// Ringtone options
-const char *ringtone_options[] = {
-    "1 Simple",
-    "2 Tones",
-    "3 Star"
-};
-#define NUM_RINGTONES (sizeof(ringtone_options) / sizeof(ringtone_options[0]))
-static int selected_ringtone = 0;          // Currently selected ringtone
+// Ringtone list lines that fit under the title; longer lists scroll
+#define RINGTONE_ROWS 5
 
-static int selected_color = 0;             // Currently selected color (unused in active code)
+// Underscore blink period while editing the alarm time
+#define BLINK_MS 300
 
-// Alarm state
-static bool alarm_set = false;             // true if alarm is active
+/*
+ * key_event: True for a press or an auto-repeat of the given key, so holding
+ * the joystick scrolls (faster the longer it is held).
+ */
+static bool key_event(const input_event_t *ev, input_key_t key) {
+    return ev->key == key && (ev->type == INPUT_PRESS || ev->type == INPUT_REPEAT);
+}
 
 // -------------------------------------------------------------------------
 // SECTION: MENU DISPLAY FUNCTIONS
@@ -96,7 +85,10 @@ void draw_menu(int selected_option) {
         }
 
         // Indicate alarm state: display a checkmark if alarm is set
-        if (alarm_set) {
+        settings_t settings;
+        settings_get(&settings);
+        drawn_settings = settings_version();
+        if (settings.alarm_set) {
             oled_display_text("(V)", 73, 0);
         } else {
             oled_display_text("   ", 73, 0);
@@ -133,22 +125,25 @@ void update_time_display() {
 /*
  * configure_alarm: Allows the user to set the alarm time.
  *
- * The user can select hours and minutes using the joystick, with a blinking
- * underscore indicating the current editing field. The alarm is confirmed with
- * Button A and canceled with Button B.
+ * The user can select hours and minutes using the joystick (hold to scroll),
+ * with a blinking underscore indicating the current editing field. The alarm
+ * is confirmed with Button A and canceled with Button B.
  */
 void configure_alarm() {
     printf("Configuring alarm...\n");
 
     // Initialize temporary values for hours and minutes
-    int hours = alarm_hour;
-    int minutes = alarm_minute;
+    settings_t settings;
+    settings_get(&settings);
+    int hours = settings.alarm_hour;
+    int minutes = settings.alarm_minute;
     bool editing_hours = true;  // Start by editing hours
 
     oled_clear();
     oled_draw_line(0, 40, 120, 40);
     oled_display_text("SEL A", 0, 50);
 
+    bool show_underscore = true;
     while (1) {
         char time_str[6];
         snprintf(time_str, sizeof(time_str), "%02d:%02d", hours, minutes);
@@ -156,7 +151,6 @@ void configure_alarm() {
         oled_display_text(time_str, 30, 20);
 
         // Blinking underscore to indicate active editing field
-        static bool show_underscore = true;
         if (show_underscore) {
             if (editing_hours) {
                 oled_display_text("__", 30, 30);  // Underscore below hours
@@ -164,27 +158,33 @@ void configure_alarm() {
                 oled_display_text("__", 53, 30);  // Underscore below minutes
             }
         }
-        show_underscore = !show_underscore; // Toggle blinking
+
+        // No input within the blink period: just toggle the underscore
+        input_event_t ev;
+        if (!input_wait(&ev, BLINK_MS)) {
+            show_underscore = !show_underscore;
+            continue;
+        }
 
         // Use joystick to adjust hours or minutes
-        if (joystick_up()) {
+        if (key_event(&ev, INPUT_KEY_UP)) {
             if (editing_hours) {
                 hours = (hours + 1) % 24;
             } else {
                 minutes = (minutes + 1) % 60;
             }
-        } else if (joystick_down()) {
+        } else if (key_event(&ev, INPUT_KEY_DOWN)) {
             if (editing_hours) {
                 hours = (hours - 1 + 24) % 24;
             } else {
                 minutes = (minutes - 1 + 60) % 60;
             }
-        } else if (joystick_left()) {
+        } else if (key_event(&ev, INPUT_KEY_LEFT)) {
             // Switch to editing hours
             editing_hours = true;
             oled_display_text("__", 30, 30);  // Show underscore under hours
             oled_display_text("  ", 53, 30);   // Clear underscore under minutes
-        } else if (joystick_right()) {
+        } else if (key_event(&ev, INPUT_KEY_RIGHT)) {
             // Switch to editing minutes
             oled_display_text("  ", 30, 30);   // Clear underscore under hours
             oled_display_text("__", 53, 30);    // Show underscore under minutes
@@ -192,16 +192,18 @@ void configure_alarm() {
         }
 
         // Confirm with Button A: set alarm
-        if (button_a_pressed()) {
-            alarm_set = true;
-            alarm_hour = hours;
-            alarm_minute = minutes;
-            sleep_ms(300);
-            printf("Alarm set for %02d:%02d\n", alarm_hour, alarm_minute);
+        if (key_event(&ev, INPUT_KEY_A)) {
+            settings_get(&settings); // May have changed over HTTP meanwhile
+            settings.alarm_set = true;
+            settings.alarm_hour = hours;
+            settings.alarm_minute = minutes;
+            settings_set(&settings);
+            printf("Alarm set for %02d:%02d\n", hours, minutes);
             menu_context = 0;
             oled_clear();
             oled_display_text("Alarm Set!", 10, 25);
             sleep_ms(1000);
+            input_flush();  // Ignore presses made while the message was shown
             oled_clear();
             draw_menu(-1);
             clear_display = false;
@@ -209,7 +211,7 @@ void configure_alarm() {
         }
 
         // Cancel with Button B: return to main menu
-        if (button_b_pressed()) {
+        if (key_event(&ev, INPUT_KEY_B)) {
             printf("Exiting alarm setup.\n");
             menu_context = 0;
             oled_clear();
@@ -217,57 +219,55 @@ void configure_alarm() {
             clear_display = false;
             break;
         }
-        sleep_ms(300);  // Delay for blinking and smooth navigation
     }
 }
 
 /*
  * check_alarm: Checks if the alarm time matches the current RTC time.
  *
- * When the alarm is triggered, it plays a ringtone, blinks the LED matrix,
+ * When the alarm is triggered, it plays a ringtone, pulses the LED matrix,
  * and allows the user to stop the alarm using Button B.
  */
 void check_alarm() {
-    if (!alarm_set) return;
+    settings_t settings;
+    settings_get(&settings);
+    if (!settings.alarm_set) return;
 
     datetime_t now;
     rtc_get_datetime(&now);
 
     // Trigger the alarm exactly when hour, minute match and second is zero.
-    if (alarm_set && now.hour == alarm_hour && now.min == alarm_minute && now.sec == 0) {
+    if (now.hour == settings.alarm_hour && now.min == settings.alarm_minute && now.sec == 0) {
         printf("ALARM TRIGGERED at %02d:%02d!\n", now.hour, now.min);
+        telemetry_alarm_fired();
 
         oled_clear();
         oled_display_text("ALARM!!!", 30, 20);
         oled_display_text("Sel B to Stop", 10, 40);
 
-        int blink_count = 0;
-        while (1) {
-            play_ringtone(selected_ringtone);  // Play ringtone sound
-
-            // Blink LED matrix three times
-            if (blink_count < 3) {
-                for (uint i = 0; i < LED_COUNT; i++) {
-                    npSetLED(i, 100, 100, 100);  // Set a dim white light
-                }
-                matrix_update();
-                sleep_ms(500);
-                matrix_clear();
-                matrix_update();
-                sleep_ms(500);
-                blink_count++;
-            }
+        play_ringtone(settings.ringtone, true);  // Loops in the background
+
+        // Breathing light in the chosen color, rendered by the led_fx timer
+        led_fx_set_brightness(settings.brightness);
+        led_fx_start(LED_FX_PULSE, led_fx_palette(settings.color), 1000);
 
+        input_flush();
+        while (1) {
             // Stop alarm when Button B is pressed
-            if (button_b_pressed()) {
+            input_event_t ev;
+            if (input_wait(&ev, 100) && key_event(&ev, INPUT_KEY_B)) {
                 stop_buzzer();  // Stop playing ringtone
+                led_fx_start(LED_FX_OFF, led_fx_palette(settings.color), 0);
                 printf("Alarm Stopped\n");
                 oled_clear();
                 oled_display_text("Alarm Stopped", 10, 20);
                 sleep_ms(1000);
+                input_flush();
                 oled_clear();
+                settings_get(&settings);
+                settings.alarm_set = false;  // Reset alarm flag
+                settings_set(&settings);
                 draw_menu(-1);
-                alarm_set = false;  // Reset alarm flag
                 clear_display = false;
                 break;
             }
@@ -289,35 +289,53 @@ void configure_ringtone() {
     printf("Configurando o ringtone...\n");
     oled_clear();
 
+    settings_t settings;
+    settings_get(&settings);
+    int selected_ringtone = settings.ringtone;
+    if (selected_ringtone < 0 || selected_ringtone >= RINGTONE_COUNT) {
+        selected_ringtone = 0;
+    }
+    char label[24];
+
     while (1) {
         oled_display_text("Select Ringtone:", 0, 0);
 
-        // Display ringtone options with selection indicator
-        for (int i = 0; i < NUM_RINGTONES; i++) {
+        // Display ringtone options with selection indicator, the list
+        // comes from the compiled ringtones (ringtones/*.rtttl)
+        int first = selected_ringtone < RINGTONE_ROWS ? 0 : selected_ringtone - RINGTONE_ROWS + 1;
+        for (int i = first; i < RINGTONE_COUNT && i < first + RINGTONE_ROWS; i++) {
+            int y = ((i - first) * 10) + 10;
             if (i == selected_ringtone) {
-                oled_display_text(">", 0, (i * 10) + 10); // Selection arrow
+                oled_display_text(">", 0, y); // Selection arrow
             }
-            oled_display_text(ringtone_options[i], 10, (i * 10) + 10);
+            snprintf(label, sizeof(label), "%d %s", i + 1, ringtones[i].name);
+            oled_display_text(label, 10, y);
         }
 
+        input_event_t ev;
+        if (!input_wait(&ev, 1000)) continue;
+
         // Navigate through options with joystick
-        if (joystick_down()) {
-            selected_ringtone = (selected_ringtone + 1) % NUM_RINGTONES;
+        if (key_event(&ev, INPUT_KEY_DOWN)) {
+            selected_ringtone = (selected_ringtone + 1) % RINGTONE_COUNT;
             oled_clear();
-        } else if (joystick_up()) {
-            selected_ringtone = (selected_ringtone - 1 + NUM_RINGTONES) % NUM_RINGTONES;
+        } else if (key_event(&ev, INPUT_KEY_UP)) {
+            selected_ringtone = (selected_ringtone - 1 + RINGTONE_COUNT) % RINGTONE_COUNT;
             oled_clear();
         }
 
         // Confirm selection with Button A
-        if (button_a_pressed()) {
-            sleep_ms(300);
-            printf("Ringtone selecionado: %s\n", ringtone_options[selected_ringtone]);
+        if (key_event(&ev, INPUT_KEY_A)) {
+            settings_get(&settings);
+            settings.ringtone = selected_ringtone;
+            settings_set(&settings);
+            printf("Ringtone selecionado: %s\n", ringtones[selected_ringtone].name);
             menu_context = 0; // Return to main menu
             oled_clear();
             oled_display_text("Ringtone\nSelected:", 0, 20);
-            oled_display_text(ringtone_options[selected_ringtone], 0, 40);
+            oled_display_text(ringtones[selected_ringtone].name, 0, 40);
             sleep_ms(1000);
+            input_flush();
             oled_clear();
             draw_menu(-1);
             clear_display = false;
@@ -325,7 +343,7 @@ void configure_ringtone() {
         }
 
         // Cancel with Button B, returning to main menu
-        if (button_b_pressed()) {
+        if (key_event(&ev, INPUT_KEY_B)) {
             printf("Voltando ao menu principal sem alterar o ringtone.\n");
             menu_context = 0;
             oled_clear();
@@ -333,8 +351,6 @@ void configure_ringtone() {
             clear_display = false;
             break;
         }
-
-        sleep_ms(200); // Delay for smooth navigation
     }
 }
 
@@ -363,24 +379,24 @@ void reset_settings() {
         oled_display_text(confirm_selection == 0 ? ">" : " ", 20, 20);
         oled_display_text(confirm_selection == 1 ? ">" : " ", 20, 30);
 
+        input_event_t ev;
+        if (!input_wait(&ev, 1000)) continue;
+
         // Toggle selection with joystick up/down
-        if (joystick_down() || joystick_up()) {
+        if (key_event(&ev, INPUT_KEY_DOWN) || key_event(&ev, INPUT_KEY_UP)) {
             confirm_selection = !confirm_selection;
         }
 
         // Confirm selection with Button A
-        if (button_a_pressed()) {
+        if (key_event(&ev, INPUT_KEY_A)) {
             if (confirm_selection == 0) { // "Yes" selected: reset defaults
-                alarm_hour = DEFAULT_ALARM_HOUR;
-                alarm_minute = DEFAULT_ALARM_MINUTE;
-                selected_ringtone = DEFAULT_RINGTONE;
-                selected_color = DEFAULT_COLOR;
-                alarm_set = false;
+                settings_reset();
 
                 printf("Settings reset to default!\n");
                 oled_clear();
                 oled_display_text("Settings Reset!", 10, 20);
                 sleep_ms(1000);
+                input_flush();
                 oled_clear();
                 clear_display = false;
                 break;
@@ -391,14 +407,12 @@ void reset_settings() {
         }
 
         // Cancel reset with Button B
-        if (button_b_pressed()) {
+        if (key_event(&ev, INPUT_KEY_B)) {
             printf("Reset canceled!\n");
-            sleep_ms(300);
             oled_clear();
             clear_display = false;
             break;
         }
-        sleep_ms(200);
     }
 
     menu_context = 0;
@@ -415,20 +429,26 @@ void reset_settings() {
  *
  * In the main menu (menu_context == 0), the user navigates through the menu
  * options using the joystick. Pressing Button A selects an option, triggering
- * the corresponding configuration function.
+ * the corresponding configuration function. Never blocks: only the events
+ * already queued are handled.
  */
 void menu_navigation() {
     static int selected_option = 0;
-    if (menu_context == 0) { // Main menu
+    input_event_t ev;
+    if (settings_version() != drawn_settings) {
+        last_selected_option = -1; // Changed over HTTP: redraw the alarm mark
+    }
+    while (menu_context == 0) { // Main menu
         draw_menu(selected_option);
+        if (!input_poll(&ev)) break;
 
-        if (joystick_down()) {
+        if (key_event(&ev, INPUT_KEY_DOWN)) {
             selected_option = (selected_option + 1) % NUM_OPTIONS;
             printf("Selecionado: %s\n", menu_options[selected_option]);
-        } else if (joystick_up()) {
+        } else if (key_event(&ev, INPUT_KEY_UP)) {
             selected_option = (selected_option - 1 + NUM_OPTIONS) % NUM_OPTIONS;
             printf("Selecionado: %s\n", menu_options[selected_option]);
-        } else if (button_a_pressed()) {
+        } else if (key_event(&ev, INPUT_KEY_A)) {
             printf("Selecionado: %s\n", menu_options[selected_option]);
             switch (selected_option) {
                 case 0: // Alarm configuration
@@ -449,7 +469,7 @@ void menu_navigation() {
             }
         }
         // Button B is ignored in the main menu
-        if (button_b_pressed()) {
+        if (key_event(&ev, INPUT_KEY_B)) {
             printf("Botão B ignorado no menu principal\n");
         }
     }
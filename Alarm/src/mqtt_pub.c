@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/async_context.h"
+#include "pico/unique_id.h"
+#include "pico/rand.h"
+
+#include "lwip/tcp.h"
+#include "lwip/dns.h"
+
+#include "mqtt_pub.h"
+#include "telemetry.h"
+#include "radio.h"
+
+#ifndef ALARM_MQTT_BROKER
+#define ALARM_MQTT_BROKER ""
+#endif
+#ifndef ALARM_MQTT_PORT
+#define ALARM_MQTT_PORT 1883
+#endif
+#ifndef ALARM_MQTT_PUBLISH_S
+#define ALARM_MQTT_PUBLISH_S 60
+#endif
+
+#define MQTT_TICK_MS 1000
+#define MQTT_KEEPALIVE_S 60           // Sent in CONNECT; we ping at half of it
+#define MQTT_CONNECT_TIMEOUT_MS 10000 // DNS + TCP handshake + CONNACK
+#define MQTT_BACKOFF_MIN_MS 2000
+#define MQTT_BACKOFF_MAX_MS (5 * 60 * 1000)
+#define MQTT_FLUSH_HOLD_MS 30000      // Longest a flush keeps the radio up
+
+// TCP keepalive catches a broker that vanished without a FIN between
+// pings, and keeps NAT mappings alive
+#define MQTT_TCP_KEEPIDLE_MS 30000
+#define MQTT_TCP_KEEPINTVL_MS 5000
+#define MQTT_TCP_KEEPCNT 3
+
+#define MQTT_TX_MAX 2048              // One PUBLISH: header, topic and JSON batch
+#define MQTT_BATCH_MAX 16             // Samples per PUBLISH
+#define MQTT_TOPIC_MAX 48
+
+// Control packet types (first byte of the fixed header)
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+typedef enum {
+    MQTT_PUB_IDLE,
+    MQTT_PUB_WAIT_LINK,    // No IP address yet (or radio asleep)
+    MQTT_PUB_RESOLVING,
+    MQTT_PUB_CONNECTING,   // TCP handshake
+    MQTT_PUB_WAIT_CONNACK,
+    MQTT_PUB_CONNECTED,
+    MQTT_PUB_BACKOFF
+} mqtt_pub_state_t;
+
+static const char *const state_names[] = {
+    "idle", "waiting for link", "resolving", "connecting", "waiting for CONNACK", "connected", "backoff"
+};
+
+// All state is touched only from the cyw43 async context (lwIP lock held)
+static mqtt_pub_state_t state = MQTT_PUB_IDLE;
+static struct tcp_pcb *pcb = NULL;
+static ip_addr_t broker_addr;
+static async_at_time_worker_t tick_worker;
+static absolute_time_t deadline;      // Connect timeout or end of backoff
+static uint32_t backoff_ms = MQTT_BACKOFF_MIN_MS;
+static absolute_time_t next_publish;
+static absolute_time_t last_tx;
+static bool ping_outstanding = false;
+static absolute_time_t ping_sent;
+
+// A flush holds the radio from the moment a batch is due until the broker
+// has acked it (or MQTT_FLUSH_HOLD_MS passes)
+static bool flushing = false;
+static bool flush_sent = false;
+static absolute_time_t flush_deadline;
+
+static char client_id[24];
+static char topic[MQTT_TOPIC_MAX];
+static char board_id[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+
+// The PUBLISH is queued without copying, so tx_buf stays untouched until
+// everything written has been acked
+static uint8_t tx_buf[MQTT_TX_MAX];
+static uint32_t unacked = 0;
+
+// Incoming packet parser (only CONNACK and PINGRESP are expected)
+static uint8_t rx_type;
+static uint32_t rx_remaining;
+static uint8_t rx_len_shift;
+static uint8_t rx_body[2];
+static uint8_t rx_body_len;
+static enum { RX_TYPE, RX_LENGTH, RX_BODY } rx_stage;
+
+static uint32_t connects = 0;
+static uint32_t failures = 0;
+static uint32_t publishes = 0;
+static uint32_t samples_sent = 0;
+static uint32_t bytes_sent = 0;
+static uint32_t send_stalls = 0;  // Batch postponed: send buffer full or previous batch unacked
+
+static void set_state(mqtt_pub_state_t new_state, uint32_t timeout_ms) {
+    state = new_state;
+    deadline = make_timeout_time_ms(timeout_ms);
+}
+
+// Drops the connection and schedules the next attempt. Returns ERR_ABRT if
+// it aborted the pcb, for use inside lwIP callbacks.
+static err_t fail(const char *why) {
+    err_t result = ERR_OK;
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_sent(pcb, NULL);
+        tcp_err(pcb, NULL);
+        tcp_abort(pcb);
+        pcb = NULL;
+        result = ERR_ABRT;
+    }
+    unacked = 0;
+    failures++;
+
+    // +-25% jitter so a fleet rebooted together does not reconnect in step
+    uint32_t wait_ms = backoff_ms - backoff_ms / 4 + get_rand_32() % (backoff_ms / 2 + 1);
+    printf("MQTT: %s, retrying in %u ms\n", why, (unsigned)wait_ms);
+    set_state(MQTT_PUB_BACKOFF, wait_ms);
+    backoff_ms = backoff_ms * 2 > MQTT_BACKOFF_MAX_MS ? MQTT_BACKOFF_MAX_MS : backoff_ms * 2;
+    return result;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    *p++ = v >> 8;
+    *p++ = v & 0xFF;
+    return p;
+}
+
+static uint8_t *put_string(uint8_t *p, const char *s) {
+    size_t len = strlen(s);
+    p = put_u16(p, len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+// MQTT remaining length: 7 bits per byte, high bit = more follows
+static int varint_size(uint32_t value) {
+    int n = 1;
+    while (value >= 128) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t value) {
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        *p++ = value ? (b | 0x80) : b;
+    } while (value);
+    return p;
+}
+
+// Small control packets are copied into lwIP
+static bool send_copy(const uint8_t *data, uint16_t len) {
+    if (tcp_sndbuf(pcb) < len || tcp_write(pcb, data, len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        return false;
+    }
+    tcp_output(pcb);
+    unacked += len;
+    last_tx = get_absolute_time();
+    return true;
+}
+
+static bool send_connect(void) {
+    uint8_t packet[64];
+    uint8_t body[48];
+    uint8_t *p = body;
+    p = put_string(p, "MQTT");
+    *p++ = 4;                      // Protocol level 3.1.1
+    *p++ = 0x02;                   // Clean session, no will, no credentials
+    p = put_u16(p, MQTT_KEEPALIVE_S);
+    p = put_string(p, client_id);
+
+    uint32_t body_len = p - body;
+    uint8_t *q = packet;
+    *q++ = MQTT_CONNECT;
+    q = put_varint(q, body_len);
+    memcpy(q, body, body_len);
+    return send_copy(packet, (q - packet) + body_len);
+}
+
+// Builds one PUBLISH with as many queued samples as fit, and queues it
+// straight from tx_buf. False if nothing was queued.
+static bool publish_batch(void) {
+    if (unacked) {
+        send_stalls++; // Previous batch still in flight: the broker or link is slow
+        return false;
+    }
+
+    telemetry_sample_t samples[MQTT_BATCH_MAX];
+    int count = telemetry_peek(samples, MQTT_BATCH_MAX);
+    if (count == 0) return false;
+
+    // Payload first, leaving room in front for the fixed header and topic
+    size_t topic_len = strlen(topic);
+    size_t payload_off = 1 + 4 + 2 + topic_len;
+    char *payload = (char *)tx_buf + payload_off;
+    size_t room = sizeof(tx_buf) - payload_off;
+    int len = snprintf(payload, room, "{\"id\":\"%s\",\"overwritten\":%lu,\"samples\":[",
+                       board_id, (unsigned long)telemetry_overwritten());
+    int included = 0;
+    for (int i = 0; i < count; i++) {
+        const telemetry_sample_t *s = &samples[i];
+        int n = snprintf(payload + len, room - len,
+                         "%s{\"up\":%lu,\"ntp_off_us\":%ld,\"fires\":%lu,\"loop_avg_us\":%lu,"
+                         "\"loop_max_us\":%lu,\"heap\":%lu}",
+                         i ? "," : "", (unsigned long)s->uptime_s, (long)s->ntp_offset_us,
+                         (unsigned long)s->alarm_fires, (unsigned long)s->loop_avg_us,
+                         (unsigned long)s->loop_max_us, (unsigned long)s->heap_used);
+        if (len + n + 2 >= (int)room) break; // Keep room for the closing "]}"
+        len += n;
+        included++;
+    }
+    len += snprintf(payload + len, room - len, "]}");
+    if (included == 0) return false;
+
+    uint32_t remaining = 2 + topic_len + len;
+    size_t start = payload_off - (2 + topic_len) - varint_size(remaining) - 1;
+    uint8_t *p = tx_buf + start;
+    *p++ = MQTT_PUBLISH;           // QoS 0, no retain
+    p = put_varint(p, remaining);
+    p = put_u16(p, topic_len);
+    memcpy(p, topic, topic_len);
+
+    uint32_t total = payload_off + len - start;
+    if (tcp_sndbuf(pcb) < total || tcp_write(pcb, tx_buf + start, total, 0) != ERR_OK) {
+        send_stalls++; // Samples stay queued for the next attempt
+        return false;
+    }
+    tcp_output(pcb);
+    unacked += total;
+    last_tx = get_absolute_time();
+    telemetry_consume(included);
+    publishes++;
+    samples_sent += included;
+    return true;
+}
+
+// Orderly close, not a failure: the backoff is left alone. A closed pcb
+// lingers and may retransmit, so with a PUBLISH still unacked (pointing
+// into tx_buf, which the next batch reuses) the connection is aborted.
+static void disconnect(void) {
+    static const uint8_t packet[2] = {MQTT_DISCONNECT, 0};
+    bool drained = unacked == 0;
+    if (drained) send_copy(packet, sizeof(packet));
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+    if (!drained || tcp_close(pcb) != ERR_OK) tcp_abort(pcb);
+    pcb = NULL;
+    unacked = 0;
+    set_state(MQTT_PUB_WAIT_LINK, 0);
+}
+
+static void end_flush(void) {
+    flushing = false;
+    radio_release(RADIO_USER_TELEMETRY);
+    // With a duty-cycled radio the link is about to go; leave first
+    if (radio_duty_cycled() && state == MQTT_PUB_CONNECTED) disconnect();
+}
+
+static err_t handle_packet(void) {
+    switch (rx_type & 0xF0) {
+        case MQTT_CONNACK:
+            if (state != MQTT_PUB_WAIT_CONNACK) break;
+            if (rx_body_len < 2 || rx_body[1] != 0) {
+                printf("MQTT: broker refused connection (code %d)\n", rx_body_len < 2 ? -1 : rx_body[1]);
+                return fail("connection refused");
+            }
+            printf("MQTT: connected to %s as %s\n", ipaddr_ntoa(&broker_addr), client_id);
+            connects++;
+            backoff_ms = MQTT_BACKOFF_MIN_MS;
+            ping_outstanding = false;
+            set_state(MQTT_PUB_CONNECTED, 0);
+            break;
+        case MQTT_PINGRESP:
+            ping_outstanding = false;
+            break;
+        default:
+            break; // Publish-only client: nothing else is expected
+    }
+    return ERR_OK;
+}
+
+static err_t mqtt_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    if (!p) {
+        return fail("broker closed the connection");
+    }
+    tcp_recved(tpcb, p->tot_len);
+
+    for (uint16_t i = 0; i < p->tot_len; i++) {
+        uint8_t b = pbuf_get_at(p, i);
+        bool complete = false;
+        switch (rx_stage) {
+            case RX_TYPE:
+                rx_type = b;
+                rx_remaining = 0;
+                rx_len_shift = 0;
+                rx_body_len = 0;
+                rx_stage = RX_LENGTH;
+                break;
+            case RX_LENGTH:
+                rx_remaining |= (uint32_t)(b & 0x7F) << rx_len_shift;
+                rx_len_shift += 7;
+                if (b & 0x80) break;
+                rx_stage = rx_remaining ? RX_BODY : RX_TYPE;
+                complete = rx_remaining == 0;
+                break;
+            case RX_BODY:
+                if (rx_body_len < sizeof(rx_body)) rx_body[rx_body_len++] = b;
+                if (--rx_remaining == 0) {
+                    rx_stage = RX_TYPE;
+                    complete = true;
+                }
+                break;
+        }
+        if (complete && handle_packet() == ERR_ABRT) {
+            pbuf_free(p);
+            return ERR_ABRT;
+        }
+    }
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static err_t mqtt_sent(void *arg, struct tcp_pcb *tpcb, u16_t len) {
+    unacked = len < unacked ? unacked - len : 0;
+    bytes_sent += len;
+    return ERR_OK;
+}
+
+// The pcb is already gone when this is called
+static void mqtt_err(void *arg, err_t err) {
+    pcb = NULL;
+    char why[32];
+    snprintf(why, sizeof(why), "connection lost (%d)", err);
+    fail(why);
+}
+
+static err_t mqtt_connected(void *arg, struct tcp_pcb *tpcb, err_t err) {
+    if (err != ERR_OK) {
+        return fail("TCP connect failed");
+    }
+
+    ip_set_option(tpcb, SOF_KEEPALIVE);
+    tpcb->keep_idle = MQTT_TCP_KEEPIDLE_MS;
+    tpcb->keep_intvl = MQTT_TCP_KEEPINTVL_MS;
+    tpcb->keep_cnt = MQTT_TCP_KEEPCNT;
+
+    rx_stage = RX_TYPE;
+    if (!send_connect()) {
+        return fail("could not send CONNECT");
+    }
+    set_state(MQTT_PUB_WAIT_CONNACK, MQTT_CONNECT_TIMEOUT_MS);
+    return ERR_OK;
+}
+
+static void start_tcp(void) {
+    pcb = tcp_new_ip_type(IP_GET_TYPE(&broker_addr));
+    if (!pcb) {
+        fail("no TCP PCB");
+        return;
+    }
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, mqtt_recv);
+    tcp_sent(pcb, mqtt_sent);
+    tcp_err(pcb, mqtt_err);
+    unacked = 0;
+    set_state(MQTT_PUB_CONNECTING, MQTT_CONNECT_TIMEOUT_MS);
+    if (tcp_connect(pcb, &broker_addr, ALARM_MQTT_PORT, mqtt_connected) != ERR_OK) {
+        fail("TCP connect failed");
+    }
+}
+
+static void dns_found_cb(const char *name, const ip_addr_t *addr, void *arg) {
+    if (state != MQTT_PUB_RESOLVING) return; // Timed out meanwhile
+    if (!addr) {
+        fail("broker name not found");
+        return;
+    }
+    broker_addr = *addr;
+    start_tcp();
+}
+
+static void start_connect(void) {
+    set_state(MQTT_PUB_RESOLVING, MQTT_CONNECT_TIMEOUT_MS);
+    err_t err = dns_gethostbyname(ALARM_MQTT_BROKER, &broker_addr, dns_found_cb, NULL);
+    if (err == ERR_OK) {
+        start_tcp(); // IP literal or cached
+    } else if (err != ERR_INPROGRESS) {
+        fail("DNS request failed");
+    }
+}
+
+static void tick_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    bool expired = time_reached(deadline);
+
+    if (!flushing && time_reached(next_publish)) {
+        next_publish = make_timeout_time_ms(ALARM_MQTT_PUBLISH_S * 1000);
+        telemetry_sample_t first;
+        if (telemetry_peek(&first, 1) > 0) {
+            flushing = true;
+            flush_sent = false;
+            flush_deadline = make_timeout_time_ms(MQTT_FLUSH_HOLD_MS);
+            radio_request(RADIO_USER_TELEMETRY);
+        }
+    } else if (flushing && time_reached(flush_deadline)) {
+        end_flush(); // Samples stay queued for the next flush
+    }
+
+    switch (state) {
+        case MQTT_PUB_WAIT_LINK:
+            // Not a failure: wait for Wi-Fi without growing the backoff. A
+            // duty-cycled radio is only up for a flush, so connect for that.
+            if (radio_link_up() && (flushing || !radio_duty_cycled())) start_connect();
+            break;
+        case MQTT_PUB_RESOLVING:
+        case MQTT_PUB_CONNECTING:
+        case MQTT_PUB_WAIT_CONNACK:
+            if (expired) fail("connect timed out");
+            break;
+        case MQTT_PUB_CONNECTED:
+            if (ping_outstanding &&
+                absolute_time_diff_us(ping_sent, get_absolute_time()) > MQTT_KEEPALIVE_S * 1000000ll) {
+                fail("no PINGRESP");
+                break;
+            }
+            if (flushing && !flush_sent) {
+                flush_sent = publish_batch();
+            } else if (flushing && unacked == 0) {
+                end_flush();
+                if (state != MQTT_PUB_CONNECTED) break;
+            }
+            if (!ping_outstanding &&
+                absolute_time_diff_us(last_tx, get_absolute_time()) >= MQTT_KEEPALIVE_S * 500000ll) {
+                static const uint8_t pingreq[2] = {MQTT_PINGREQ, 0};
+                if (send_copy(pingreq, sizeof(pingreq))) {
+                    ping_outstanding = true;
+                    ping_sent = get_absolute_time();
+                }
+            }
+            break;
+        case MQTT_PUB_BACKOFF:
+            if (expired) set_state(MQTT_PUB_WAIT_LINK, 0);
+            break;
+        default:
+            break;
+    }
+    async_context_add_at_time_worker_in_ms(context, worker, MQTT_TICK_MS);
+}
+
+bool mqtt_pub_start(void) {
+    if (ALARM_MQTT_BROKER[0] == '\0') {
+        printf("MQTT: no broker configured\n");
+        return false;
+    }
+    if (state != MQTT_PUB_IDLE) return true;
+
+    pico_get_unique_board_id_string(board_id, sizeof(board_id));
+    snprintf(client_id, sizeof(client_id), "alarm-%s", board_id);
+    snprintf(topic, sizeof(topic), "alarm/%s/telemetry", board_id);
+
+    next_publish = make_timeout_time_ms(ALARM_MQTT_PUBLISH_S * 1000);
+    set_state(MQTT_PUB_WAIT_LINK, 0);
+    tick_worker.do_work = tick_worker_fn;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &tick_worker, MQTT_TICK_MS);
+    return true;
+}
+
+void mqtt_pub_print_stats(void) {
+    printf("MQTT: %s, broker %s:%d, topic %s\n", state_names[state],
+           ALARM_MQTT_BROKER[0] ? ALARM_MQTT_BROKER : "(none)", ALARM_MQTT_PORT, topic);
+    printf("  %lu connects, %lu failures, next backoff %lu ms%s\n",
+           (unsigned long)connects, (unsigned long)failures, (unsigned long)backoff_ms,
+           flushing ? ", flush in progress" : "");
+    printf("  %lu publishes, %lu samples, %lu bytes acked, %lu stalls, %lu samples overwritten\n",
+           (unsigned long)publishes, (unsigned long)samples_sent, (unsigned long)bytes_sent,
+           (unsigned long)send_stalls, (unsigned long)telemetry_overwritten());
+}
@@ -0,0 +1,21 @@
+#ifndef MQTT_PUB_H
+#define MQTT_PUB_H
+
+#include <stdbool.h>
+
+// Minimal MQTT 3.1.1 publisher on lwIP raw TCP (cyw43 async context).
+// Drains the telemetry ring every ALARM_MQTT_PUBLISH_S seconds as one QoS 0
+// message on "alarm/<board id>/telemetry". Publish-only: no subscriptions.
+// Reconnects in the background with exponential backoff; nothing here ever
+// waits on the broker, so a slow or dead broker cannot stall the UI loop.
+// The broker is set with the ALARM_MQTT_BROKER CMake option (empty = off).
+// Each batch holds the radio (radio.h) until the broker has acked it; with
+// a duty-cycled radio the connection only lives for that flush.
+
+// Starts the connection state machine; call with the lwIP lock held
+bool mqtt_pub_start(void);
+
+// Prints connection state and counters (console key 'm')
+void mqtt_pub_print_stats(void);
+
+#endif // MQTT_PUB_H
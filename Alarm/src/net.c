@@ -0,0 +1,38 @@
+#include "net.h"
+#include "console.h"
+#include "wifi_time.h"
+#include "time_sync.h"
+#include "sntp_server.h"
+#include "http_server.h"
+#include "mqtt_pub.h"
+#include "fleet.h"
+#include "radio.h"
+#include "link_supervisor.h"
+#include "ota.h"
+
+void net_start(void) {
+    wifi_time_start();
+}
+
+void net_poll(void) {
+    wifi_time_poll();
+}
+
+void net_register_console(void) {
+    console_register('s', "NTP resync and drift status", time_sync_print_stats);
+    console_register('n', "SNTP server request stats", sntp_server_print_stats);
+    console_register('h', "HTTP server connection stats", http_server_print_stats);
+    console_register('m', "MQTT telemetry publisher status", mqtt_pub_print_stats);
+    console_register('f', "fleet discovery/config stats", fleet_print_stats);
+    console_register('r', "Wi-Fi radio on-time and wakeups", radio_print_stats);
+    console_register('w', "Wi-Fi link uptime and reconnects", link_supervisor_print_stats);
+    console_register('o', "firmware update (OTA) status", ota_print_stats);
+}
+
+bool net_clock_synced(void) {
+    return wifi_time_synced();
+}
+
+int32_t net_clock_residual_us(void) {
+    return time_sync_last_residual_us();
+}
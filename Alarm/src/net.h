@@ -0,0 +1,27 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Everything the rest of the firmware needs from the network side. net.c
+// implements it on top of the CYW43/lwIP services; net_offline.c is the
+// Alarm_offline build, which has no radio and sets the clock by hand.
+
+// Brings the network up; connect and time sync continue in the background
+void net_start(void);
+
+// Background work that must run outside the network context (flash
+// writes); call from the main loop
+void net_poll(void);
+
+// Registers the console commands of the network services
+void net_register_console(void);
+
+// True once the clock has come from the network (NTP)
+bool net_clock_synced(void);
+
+// Clock residual at the last time sync, in microseconds (0 when unknown)
+int32_t net_clock_residual_us(void);
+
+#endif // NET_H
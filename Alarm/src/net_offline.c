@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+
+#include "net.h"
+#include "console.h"
+#include "timekeeper.h"
+
+#define SET_TIME_TIMEOUT_US (30 * 1000000)
+#define SET_TIME_LINE_LEN 24
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+// Reads one line with echo; false on timeout or an empty line
+static bool read_line(char *buf, int len) {
+    int n = 0;
+    while (true) {
+        int c = getchar_timeout_us(SET_TIME_TIMEOUT_US);
+        if (c == PICO_ERROR_TIMEOUT) break;
+        if (c == '\r' || c == '\n') break;
+        if ((c == '\b' || c == 0x7f) && n > 0) {
+            n--;
+            printf("\b \b");
+        } else if (c >= ' ' && n < len - 1) {
+            buf[n++] = (char)c;
+            putchar(c);
+        }
+    }
+    buf[n] = '\0';
+    printf("\n");
+    return n > 0;
+}
+
+// Blocks the main loop while the line is typed (at most 30 s per key)
+static void set_time(void) {
+    char line[SET_TIME_LINE_LEN];
+    int year, month, day, hour, min, sec;
+
+    printf("Local time (YYYY-MM-DD HH:MM:SS): ");
+    if (!read_line(line, sizeof(line))) {
+        printf("Clock unchanged\n");
+        return;
+    }
+    // The timer keeps running while the line is parsed
+    uint64_t entered_us = time_us_64();
+    if (sscanf(line, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &min, &sec) != 6 ||
+        year < 2000 || year > 2099 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour > 23 || min > 59 || sec > 59 || hour < 0 || min < 0 || sec < 0) {
+        printf("Not a valid time: %s\n", line);
+        return;
+    }
+
+    int64_t unix_s = days_from_civil(year, month, day) * 86400 + hour * 3600 + min * 60 + sec -
+                     TIMEKEEPER_UTC_OFFSET_S;
+    timekeeper_set_offset(unix_s * 1000000 - (int64_t)entered_us); // Prints the new time
+}
+
+void net_start(void) {
+    printf("Offline build: no network, set the clock with 't'\n");
+}
+
+void net_poll(void) {
+}
+
+void net_register_console(void) {
+    console_register('t', "set the clock (YYYY-MM-DD HH:MM:SS)", set_time);
+}
+
+bool net_clock_synced(void) {
+    return false;
+}
+
+int32_t net_clock_residual_us(void) {
+    return 0;
+}
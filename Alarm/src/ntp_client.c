@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/async_context.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#include "ntp_client.h"
+
+#define NTP_PORT 123
+#define NTP_TIMESTAMP_DELTA 2208988800ll // 1900 -> 1970
+
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_VERSION 4
+
+typedef struct {
+    uint8_t li_vn_mode;
+    uint8_t stratum;
+    uint8_t poll;
+    int8_t precision;
+    uint32_t root_delay;
+    uint32_t root_dispersion;
+    uint32_t ref_id;
+    uint32_t ref_timestamp[2];
+    uint32_t orig_timestamp[2];
+    uint32_t rx_timestamp[2];
+    uint32_t tx_timestamp[2];
+} ntp_packet_t;
+
+typedef struct {
+    ip_addr_t addr;
+    uint64_t t1_us;  // Local send time, also sent as our transmit timestamp
+    bool answered;
+} ntp_query_t;
+
+// All state is touched only from the cyw43 async context (lwIP lock held)
+static struct udp_pcb *pcb = NULL;
+static ntp_query_t queries[NTP_CLIENT_MAX_SERVERS];
+static int query_count = 0;
+static int answers = 0;
+static bool have_best = false;
+static ntp_sample_t best;
+static ntp_client_done_fn done_fn = NULL;
+static void *done_arg = NULL;
+static async_at_time_worker_t timeout_worker;
+
+// NTP 32.32 fixed point (big endian) -> microseconds since the Unix epoch
+static int64_t ntp_to_unix_us(const uint32_t ts[2]) {
+    uint32_t sec = ntohl(ts[0]);
+    uint32_t frac = ntohl(ts[1]);
+    return ((int64_t)sec - NTP_TIMESTAMP_DELTA) * 1000000 + (int64_t)(((uint64_t)frac * 1000000) >> 32);
+}
+
+static void finish(void) {
+    ntp_client_done_fn fn = done_fn;
+
+    async_context_remove_at_time_worker(cyw43_arch_async_context(), &timeout_worker);
+    if (pcb) {
+        udp_remove(pcb);
+        pcb = NULL;
+    }
+    done_fn = NULL;
+    if (fn) {
+        fn(have_best ? &best : NULL, done_arg);
+    }
+}
+
+static void ntp_recv_cb(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                        const ip_addr_t *addr, u16_t port) {
+    uint64_t t4_us = time_us_64(); // Receive time, as early as possible
+    if (!p) return;
+
+    ntp_packet_t packet;
+    bool valid = p->tot_len >= sizeof(packet) &&
+                 pbuf_copy_partial(p, &packet, sizeof(packet), 0) == sizeof(packet);
+    pbuf_free(p);
+    if (!valid || port != NTP_PORT) return;
+
+    uint8_t mode = packet.li_vn_mode & 0x07;
+    uint8_t leap = packet.li_vn_mode >> 6;
+    if (mode != NTP_MODE_SERVER || leap == 3 || packet.stratum == 0 || packet.stratum > 15) {
+        return; // Kiss-o'-death or unsynchronised server
+    }
+
+    // The server echoes our transmit timestamp as its originate timestamp
+    for (int i = 0; i < query_count; i++) {
+        ntp_query_t *q = &queries[i];
+        if (q->answered || !ip_addr_cmp(&q->addr, addr) ||
+            ntohl(packet.orig_timestamp[0]) != (uint32_t)(q->t1_us >> 32) ||
+            ntohl(packet.orig_timestamp[1]) != (uint32_t)q->t1_us) {
+            continue;
+        }
+        q->answered = true;
+        answers++;
+
+        int64_t t1 = (int64_t)q->t1_us;
+        int64_t t2 = ntp_to_unix_us(packet.rx_timestamp);
+        int64_t t3 = ntp_to_unix_us(packet.tx_timestamp);
+        int64_t t4 = (int64_t)t4_us;
+
+        int64_t offset = ((t2 - t1) + (t3 - t4)) / 2;
+        int64_t delay = (t4 - t1) - (t3 - t2);
+        if (delay < 0) delay = 0;
+
+        printf("NTP %s: stratum %d, offset %lld us, delay %lld us\n",
+               ipaddr_ntoa(addr), packet.stratum, (long long)offset, (long long)delay);
+
+        if (!have_best || (uint32_t)delay < best.delay_us) {
+            have_best = true;
+            best.server = *addr;
+            best.offset_us = offset;
+            best.delay_us = (uint32_t)delay;
+            best.stratum = packet.stratum;
+        }
+
+        if (answers == query_count) {
+            finish();
+        }
+        return;
+    }
+}
+
+static void timeout_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    if (done_fn) {
+        printf("NTP: %d of %d servers answered\n", answers, query_count);
+        finish();
+    }
+}
+
+bool ntp_client_query(const ip_addr_t *servers, int count, uint32_t timeout_ms,
+                      ntp_client_done_fn done, void *arg) {
+    ntp_client_cancel();
+    if (count <= 0) return false;
+    if (count > NTP_CLIENT_MAX_SERVERS) count = NTP_CLIENT_MAX_SERVERS;
+
+    pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        printf("Failed to create UDP PCB\n");
+        return false;
+    }
+    if (udp_bind(pcb, IP_ANY_TYPE, 0) != ERR_OK) {
+        printf("Failed to bind UDP PCB\n");
+        udp_remove(pcb);
+        pcb = NULL;
+        return false;
+    }
+    udp_recv(pcb, ntp_recv_cb, NULL);
+
+    query_count = 0;
+    answers = 0;
+    have_best = false;
+    done_fn = done;
+    done_arg = arg;
+
+    for (int i = 0; i < count; i++) {
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, sizeof(ntp_packet_t), PBUF_RAM);
+        if (!p) {
+            printf("Failed to allocate pbuf for NTP request\n");
+            continue;
+        }
+
+        ntp_query_t *q = &queries[query_count];
+        q->addr = servers[i];
+        q->answered = false;
+        q->t1_us = time_us_64();
+
+        ntp_packet_t packet = {0};
+        packet.li_vn_mode = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+        packet.tx_timestamp[0] = htonl((uint32_t)(q->t1_us >> 32));
+        packet.tx_timestamp[1] = htonl((uint32_t)q->t1_us);
+        pbuf_take(p, &packet, sizeof(packet));
+
+        if (udp_sendto(pcb, p, &q->addr, NTP_PORT) == ERR_OK) {
+            query_count++;
+        } else {
+            printf("Failed to send NTP request to %s\n", ipaddr_ntoa(&q->addr));
+        }
+        pbuf_free(p);
+    }
+
+    if (query_count == 0) {
+        done_fn = NULL;
+        udp_remove(pcb);
+        pcb = NULL;
+        return false;
+    }
+
+    timeout_worker.do_work = timeout_worker_fn;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &timeout_worker, timeout_ms);
+    return true;
+}
+
+void ntp_client_cancel(void) {
+    if (!done_fn && !pcb) return;
+    done_fn = NULL;
+    finish();
+}
+
+bool ntp_client_busy(void) {
+    return done_fn != NULL;
+}
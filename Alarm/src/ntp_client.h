@@ -0,0 +1,33 @@
+#ifndef NTP_CLIENT_H
+#define NTP_CLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lwip/ip_addr.h"
+
+#define NTP_CLIENT_MAX_SERVERS 4
+
+// One server's answer. offset_us maps the local clock to UTC:
+// unix_us = time_us_64() + offset_us.
+typedef struct {
+    ip_addr_t server;
+    int64_t offset_us;
+    uint32_t delay_us; // Round trip minus the server's processing time
+    uint8_t stratum;
+} ntp_sample_t;
+
+// Called once per query with the lowest-delay sample, or NULL if no server
+// answered in time
+typedef void (*ntp_client_done_fn)(const ntp_sample_t *best, void *arg);
+
+// Queries all servers at once and returns immediately; the callback runs
+// from the cyw43 async context. Call with the lwIP lock held.
+bool ntp_client_query(const ip_addr_t *servers, int count, uint32_t timeout_ms,
+                      ntp_client_done_fn done, void *arg);
+
+// Drops an outstanding query without calling back
+void ntp_client_cancel(void);
+
+bool ntp_client_busy(void);
+
+#endif // NTP_CLIENT_H
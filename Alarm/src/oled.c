@@ -12,7 +12,7 @@ static uint8_t ssd[ssd1306_buffer_length];
 static struct render_area frame_area;
 
 void oled_init() {
-    if (i2c_init(i2c1, 100 * 1000) == 0) {
+    if (i2c_init(i2c1, ssd1306_i2c_clock * 1000) == 0) {
         printf("I2C initialization failed.\n");
         return;
     }
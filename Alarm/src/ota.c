@@ -0,0 +1,518 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/async_context.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+
+#include "mbedtls/sha256.h"
+
+#include "ota.h"
+#include "crc32.h"
+#include "flash_store.h"
+#include "radio.h"
+
+// Second megabyte, up to the flash_store records at the very end
+#define OTA_SLOT_OFFSET (1024 * 1024)
+#define OTA_SLOT_SIZE (PICO_FLASH_SIZE_BYTES - OTA_SLOT_OFFSET - FLASH_STORE_SLOT_COUNT * FLASH_SECTOR_SIZE)
+
+#ifndef ALARM_OTA_KEY
+#define ALARM_OTA_KEY ""
+#endif
+_Static_assert(sizeof(ALARM_OTA_KEY) - 1 <= 64, "ALARM_OTA_KEY is limited to 64 bytes");
+
+#define OTA_CHUNK FLASH_SECTOR_SIZE     // Staging erases one sector per chunk (IRQs off ~50 ms)
+#define OTA_INSTALL_ERASE (64 * 1024)   // Install only: IRQs are off for good by then
+#define OTA_LOCKOUT_MS 100
+#define OTA_POLL_INTERVAL 2             // tcp_poll units of 500 ms
+#define OTA_IDLE_TIMEOUT_POLLS 10       // 10 s without data or flash progress
+#define OTA_APPLY_DELAY_MS 500          // Lets the reply and FIN go out first
+
+extern char __flash_binary_end;         // End of the running program, from the linker script
+
+typedef enum {
+    OTA_IDLE,
+    OTA_HEADER,
+    OTA_RECEIVING,
+    OTA_STAGED,     // Verified image in the slot
+    OTA_APPLYING
+} ota_state_t;
+
+static const char *const state_names[] = {
+    "idle", "waiting for header", "receiving", "image staged", "applying"
+};
+
+typedef struct {
+    uint32_t erase_offset;
+    uint32_t erase_len;             // 0 = no erase
+    uint32_t program_offset;
+    uint32_t program_len;
+    const uint8_t *data;
+} ota_flash_op_t;
+
+// All state is touched only from the cyw43 async context (lwIP lock held)
+static struct tcp_pcb *listen_pcb = NULL;
+static struct tcp_pcb *pcb = NULL;      // One session at a time
+static ota_state_t state = OTA_IDLE;
+static struct pbuf *held = NULL;        // Received, not yet copied into a chunk
+static uint8_t idle_polls = 0;
+
+static uint8_t header[OTA_HEADER_LEN];
+static uint8_t header_len = 0;
+static uint8_t flags = 0;
+static uint32_t image_len = 0;
+static uint32_t image_crc = 0;
+static uint8_t image_digest[OTA_DIGEST_LEN];
+static uint32_t received = 0;           // Image bytes copied into chunks
+static uint32_t written = 0;            // Image bytes programmed
+static uint32_t erased = 0;             // Slot bytes erased
+static uint32_t stream_crc = 0;         // Over the bytes as received
+static uint32_t flash_crc = 0;          // Over the bytes read back after programming
+static mbedtls_sha256_context flash_sha; // Digest of the same read-back bytes
+
+// Double buffer: TCP fills one chunk while the other waits for the flash.
+// When both are full the data stays in lwIP unacknowledged, which closes
+// the receive window until the flash catches up.
+static uint8_t chunk[2][OTA_CHUNK] __attribute__((aligned(4)));
+static uint32_t chunk_len[2];
+static bool chunk_ready[2];
+static int fill_index = 0;
+static int flash_index = 0;
+static bool flash_scheduled = false;
+static async_at_time_worker_t flash_worker;
+static async_at_time_worker_t apply_worker;
+
+static uint64_t started_us;
+static uint64_t flash_busy_us;
+static uint32_t sessions = 0;
+static uint32_t failures = 0;
+static uint32_t rejected = 0;
+static uint32_t window_stalls = 0;     // Both chunks full: receive window held shut
+static uint32_t last_ms = 0;
+static uint32_t last_kbps = 0;
+static char last_result[48] = "none";
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// HMAC-SHA256 keyed with ALARM_OTA_KEY, or plain SHA-256 without a key
+static void digest_key_block(uint8_t *block, uint8_t pad) {
+    const char *key = ALARM_OTA_KEY;
+    memset(block, pad, 64);
+    for (uint i = 0; key[i]; i++) {
+        block[i] ^= (uint8_t)key[i];
+    }
+}
+
+static void digest_start(mbedtls_sha256_context *ctx) {
+    mbedtls_sha256_init(ctx);
+    mbedtls_sha256_starts_ret(ctx, 0);
+    if (sizeof(ALARM_OTA_KEY) > 1) {
+        uint8_t block[64];
+        digest_key_block(block, 0x36);
+        mbedtls_sha256_update_ret(ctx, block, sizeof(block));
+    }
+}
+
+static void digest_finish(mbedtls_sha256_context *ctx, uint8_t *out) {
+    mbedtls_sha256_finish_ret(ctx, out);
+    mbedtls_sha256_free(ctx);
+    if (sizeof(ALARM_OTA_KEY) > 1) {
+        uint8_t block[64];
+        digest_key_block(block, 0x5c);
+        mbedtls_sha256_init(ctx);
+        mbedtls_sha256_starts_ret(ctx, 0);
+        mbedtls_sha256_update_ret(ctx, block, sizeof(block));
+        mbedtls_sha256_update_ret(ctx, out, OTA_DIGEST_LEN);
+        mbedtls_sha256_finish_ret(ctx, out);
+        mbedtls_sha256_free(ctx);
+    }
+}
+
+// Compares without an early exit, so timing says nothing about the tag
+static bool digest_equal(const uint8_t *a, const uint8_t *b) {
+    uint8_t diff = 0;
+    for (uint i = 0; i < OTA_DIGEST_LEN; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+// Digest of what is in the slot right now
+static void slot_digest(uint8_t *out) {
+    mbedtls_sha256_context ctx;
+    digest_start(&ctx);
+    mbedtls_sha256_update_ret(&ctx, (const uint8_t *)(XIP_BASE + OTA_SLOT_OFFSET), image_len);
+    digest_finish(&ctx, out);
+}
+
+static err_t session_close(void) {
+    err_t result = ERR_OK;
+    if (held) {
+        pbuf_free(held);
+        held = NULL;
+    }
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_err(pcb, NULL);
+        tcp_poll(pcb, NULL, 0);
+        if (tcp_close(pcb) != ERR_OK) {
+            tcp_abort(pcb);
+            result = ERR_ABRT;
+        }
+        pcb = NULL;
+    }
+    radio_release(RADIO_USER_OTA);
+    return result;
+}
+
+static void reply(const char *line) {
+    if (pcb && tcp_write(pcb, line, strlen(line), TCP_WRITE_FLAG_COPY) == ERR_OK) {
+        tcp_output(pcb);
+    }
+}
+
+// Ends the session with "ERR <why>". The slot may be half written, so any
+// previously staged image is gone too. Returns ERR_ABRT if the pcb was
+// aborted, for use inside lwIP callbacks.
+static err_t session_fail(const char *why) {
+    char line[64];
+    snprintf(line, sizeof(line), "ERR %s\n", why);
+    reply(line);
+    failures++;
+    state = OTA_IDLE;
+    snprintf(last_result, sizeof(last_result), "failed: %s", why);
+    printf("OTA: %s\n", why);
+    return session_close();
+}
+
+static void schedule_flash(void) {
+    if (flash_scheduled) return;
+    flash_scheduled = true;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &flash_worker, 0);
+}
+
+static err_t parse_header(void) {
+    if (memcmp(header, OTA_MAGIC, 4) != 0 || header[4] != OTA_VERSION) {
+        return session_fail("bad header");
+    }
+    flags = header[5];
+    image_len = get_u32(header + 8);
+    image_crc = get_u32(header + 12);
+    memcpy(image_digest, header + 16, OTA_DIGEST_LEN);
+    if (image_len < 2 * FLASH_PAGE_SIZE) return session_fail("image too small");
+    if (image_len > OTA_SLOT_SIZE) return session_fail("image too large");
+
+    state = OTA_RECEIVING;
+    printf("OTA: receiving %lu bytes\n", (unsigned long)image_len);
+    return ERR_OK;
+}
+
+// Moves held data into the header or the fill chunk, acknowledging what
+// was taken. Stops when both chunks are waiting for the flash.
+static err_t consume(void) {
+    while (held && pcb) {
+        uint16_t n;
+        if (state == OTA_HEADER) {
+            n = OTA_HEADER_LEN - header_len;
+            if (n > held->tot_len) n = held->tot_len;
+            pbuf_copy_partial(held, header + header_len, n, 0);
+            header_len += n;
+        } else if (state == OTA_RECEIVING && received < image_len) {
+            if (chunk_ready[fill_index]) {
+                window_stalls++;
+                break;
+            }
+            uint8_t *dst = chunk[fill_index] + chunk_len[fill_index];
+            uint32_t room = OTA_CHUNK - chunk_len[fill_index];
+            if (room > image_len - received) room = image_len - received;
+            n = held->tot_len < room ? held->tot_len : (uint16_t)room;
+            pbuf_copy_partial(held, dst, n, 0);
+            stream_crc = crc32_update(stream_crc, dst, n);
+            chunk_len[fill_index] += n;
+            received += n;
+            if (chunk_len[fill_index] == OTA_CHUNK || received == image_len) {
+                chunk_ready[fill_index] = true;
+                fill_index ^= 1;
+                schedule_flash();
+            }
+        } else {
+            n = held->tot_len; // Past the image (or already failed): drop
+        }
+
+        held = pbuf_free_header(held, n);
+        tcp_recved(pcb, n);
+        if (state == OTA_HEADER && header_len == OTA_HEADER_LEN) {
+            err_t err = parse_header();
+            if (err != ERR_OK) return err;
+        }
+    }
+    return ERR_OK;
+}
+
+// After the 256-byte boot2 comes the vector table: the initial stack
+// pointer must be in SRAM and the reset handler inside the image
+static bool image_plausible(const uint8_t *first) {
+    uint32_t sp, reset;
+    memcpy(&sp, first + 256, 4);
+    memcpy(&reset, first + 260, 4);
+    return sp > SRAM_BASE && sp <= SRAM_END && reset > XIP_BASE + 256 && reset < XIP_BASE + image_len;
+}
+
+// Runs with interrupts off (and the other core parked) via flash_safe_execute
+static void flash_op(void *param) {
+    const ota_flash_op_t *op = (const ota_flash_op_t *)param;
+    if (op->erase_len) {
+        flash_range_erase(op->erase_offset, op->erase_len);
+    }
+    flash_range_program(op->program_offset, op->data, op->program_len);
+}
+
+static void verify_and_finish(void) {
+    uint8_t digest[OTA_DIGEST_LEN];
+    digest_finish(&flash_sha, digest);
+
+    if (stream_crc != image_crc) {
+        session_fail("CRC mismatch");
+        return;
+    }
+    if (flash_crc != image_crc) {
+        session_fail("flash readback mismatch");
+        return;
+    }
+    if (!digest_equal(digest, image_digest)) {
+        session_fail(sizeof(ALARM_OTA_KEY) > 1 ? "HMAC mismatch" : "SHA-256 mismatch");
+        return;
+    }
+
+    last_ms = (uint32_t)((time_us_64() - started_us) / 1000);
+    last_kbps = last_ms ? (uint32_t)((uint64_t)image_len * 8 / last_ms) : 0;
+    snprintf(last_result, sizeof(last_result), "staged %lu bytes, crc %08lx",
+             (unsigned long)image_len, (unsigned long)image_crc);
+    printf("OTA: %s in %lu ms (%lu kbit/s, %lu ms in flash)\n", last_result, (unsigned long)last_ms,
+           (unsigned long)last_kbps, (unsigned long)(flash_busy_us / 1000));
+
+    char line[48];
+    snprintf(line, sizeof(line), "OK %lu %08lx\n", (unsigned long)image_len, (unsigned long)image_crc);
+    reply(line);
+    session_close();
+
+    state = OTA_STAGED;
+    if (flags & OTA_FLAG_APPLY) {
+        state = OTA_APPLYING;
+        async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &apply_worker, OTA_APPLY_DELAY_MS);
+    }
+}
+
+// One chunk per run, so lwIP gets the context back between flash operations
+static void flash_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    flash_scheduled = false;
+    if (state != OTA_RECEIVING || !chunk_ready[flash_index]) return;
+
+    uint8_t *data = chunk[flash_index];
+    uint32_t len = chunk_len[flash_index];
+    if (written == 0 && !image_plausible(data)) {
+        session_fail("not an RP2040 image");
+        return;
+    }
+
+    // The last chunk is padded to whole pages. One sector erase per chunk
+    // keeps each interrupts-off stretch short; a 64 KB block erase would
+    // hold them off for well over 100 ms at a time.
+    uint32_t padded = (len + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+    memset(data + len, 0xFF, padded - len);
+    ota_flash_op_t op = {
+        .program_offset = OTA_SLOT_OFFSET + written,
+        .program_len = padded,
+        .data = data,
+    };
+    if (written + padded > erased) {
+        op.erase_offset = OTA_SLOT_OFFSET + erased;
+        op.erase_len = FLASH_SECTOR_SIZE;
+    }
+
+    uint64_t start = time_us_64();
+    if (flash_safe_execute(flash_op, &op, OTA_LOCKOUT_MS) != PICO_OK) {
+        session_fail("flash write failed");
+        return;
+    }
+    flash_busy_us += time_us_64() - start;
+    flash_crc = crc32_update(flash_crc, (const void *)(XIP_BASE + op.program_offset), len);
+    mbedtls_sha256_update_ret(&flash_sha, (const uint8_t *)(XIP_BASE + op.program_offset), len);
+    erased += op.erase_len;
+    written += len;
+    idle_polls = 0;
+
+    chunk_len[flash_index] = 0;
+    chunk_ready[flash_index] = false;
+    flash_index ^= 1;
+
+    if (written == image_len) {
+        verify_and_finish();
+        return;
+    }
+    consume(); // The window may have been held shut
+    if (chunk_ready[flash_index]) schedule_flash();
+}
+
+// Copies the staged image over the running program and resets. Runs from
+// RAM with interrupts off and never returns: the flash behind it is being
+// replaced, so nothing in here may call into flash (hence the volatile
+// source, which keeps the copy loop from becoming a memcpy call).
+static void __no_inline_not_in_flash_func(install_image)(uint32_t length) {
+    uint32_t *buf = (uint32_t *)chunk[0];
+    uint32_t end = (length + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+
+    for (uint32_t off = 0; off < end; off += FLASH_SECTOR_SIZE) {
+        if (off % OTA_INSTALL_ERASE == 0) {
+            flash_range_erase(off, end - off < OTA_INSTALL_ERASE ? end - off : OTA_INSTALL_ERASE);
+        }
+        const volatile uint32_t *src = (const volatile uint32_t *)(XIP_BASE + OTA_SLOT_OFFSET + off);
+        for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / 4; i++) {
+            buf[i] = src[i];
+        }
+        flash_range_program(off, (const uint8_t *)buf, FLASH_SECTOR_SIZE);
+    }
+
+    scb_hw->aircr = (0x05FAu << M0PLUS_AIRCR_VECTKEY_LSB) | M0PLUS_AIRCR_SYSRESETREQ_BITS;
+    while (true) {
+        tight_loop_contents();
+    }
+}
+
+static void apply_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    // Last look at the slot itself: the copy below cannot be undone
+    uint8_t digest[OTA_DIGEST_LEN];
+    slot_digest(digest);
+    if (!digest_equal(digest, image_digest)) {
+        state = OTA_IDLE;
+        failures++;
+        snprintf(last_result, sizeof(last_result), "failed: slot changed before install");
+        printf("OTA: %s\n", last_result);
+        return;
+    }
+
+    printf("OTA: installing %lu bytes and rebooting\n", (unsigned long)image_len);
+    busy_wait_ms(20); // Let the message out
+    save_and_disable_interrupts();
+    install_image(image_len);
+}
+
+static err_t ota_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    if (!p) {
+        return session_fail("connection closed before the image was complete");
+    }
+    idle_polls = 0;
+    if (held) {
+        pbuf_cat(held, p);
+    } else {
+        held = p;
+    }
+    return consume();
+}
+
+static err_t ota_poll(void *arg, struct tcp_pcb *tpcb) {
+    if (++idle_polls >= OTA_IDLE_TIMEOUT_POLLS) {
+        return session_fail("timed out");
+    }
+    return ERR_OK;
+}
+
+// The pcb is already gone when this is called
+static void ota_err(void *arg, err_t err) {
+    pcb = NULL;
+    char why[32];
+    snprintf(why, sizeof(why), "connection lost (%d)", err);
+    session_fail(why);
+}
+
+static err_t ota_accept(void *arg, struct tcp_pcb *newpcb, err_t err) {
+    if (err != ERR_OK || !newpcb) return ERR_VAL;
+    if (pcb || state == OTA_APPLYING) {
+        rejected++;
+        tcp_abort(newpcb);
+        return ERR_ABRT;
+    }
+
+    pcb = newpcb;
+    state = OTA_HEADER;
+    header_len = 0;
+    received = 0;
+    written = 0;
+    erased = 0;
+    stream_crc = 0;
+    flash_crc = 0;
+    digest_start(&flash_sha);
+    chunk_len[0] = chunk_len[1] = 0;
+    chunk_ready[0] = chunk_ready[1] = false;
+    fill_index = 0;
+    flash_index = 0;
+    idle_polls = 0;
+    flash_busy_us = 0;
+    started_us = time_us_64();
+    sessions++;
+
+    tcp_arg(newpcb, NULL);
+    tcp_recv(newpcb, ota_recv);
+    tcp_err(newpcb, ota_err);
+    tcp_poll(newpcb, ota_poll, OTA_POLL_INTERVAL);
+    radio_request(RADIO_USER_OTA);
+    printf("OTA: update from %s\n", ipaddr_ntoa(&newpcb->remote_ip));
+    return ERR_OK;
+}
+
+bool ota_start(void) {
+    if (listen_pcb) return true;
+
+    uint32_t program_size = (uint32_t)(&__flash_binary_end - (char *)XIP_BASE);
+    if (program_size > OTA_SLOT_OFFSET) {
+        printf("OTA: program (%lu bytes) overlaps the staging slot, disabled\n", (unsigned long)program_size);
+        return false;
+    }
+
+    struct tcp_pcb *p = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!p) {
+        printf("OTA: failed to create TCP PCB\n");
+        return false;
+    }
+    if (tcp_bind(p, IP_ANY_TYPE, OTA_PORT) != ERR_OK) {
+        printf("OTA: failed to bind port %d\n", OTA_PORT);
+        tcp_close(p);
+        return false;
+    }
+    listen_pcb = tcp_listen_with_backlog(p, 1);
+    if (!listen_pcb) {
+        printf("OTA: failed to listen\n");
+        tcp_close(p);
+        return false;
+    }
+    tcp_accept(listen_pcb, ota_accept);
+    flash_worker.do_work = flash_worker_fn;
+    apply_worker.do_work = apply_worker_fn;
+
+    printf("OTA listening on port %d (slot %lu KB)\n", OTA_PORT, (unsigned long)(OTA_SLOT_SIZE / 1024));
+    if (sizeof(ALARM_OTA_KEY) == 1) {
+        printf("OTA: no ALARM_OTA_KEY, images are checked but not authenticated\n");
+    }
+    return true;
+}
+
+void ota_print_stats(void) {
+    printf("OTA: %s, %s\n", listen_pcb ? "listening" : "not running", state_names[state]);
+    if (state == OTA_RECEIVING) {
+        printf("  %lu of %lu bytes received, %lu written\n",
+               (unsigned long)received, (unsigned long)image_len, (unsigned long)written);
+    }
+    printf("  %lu sessions, %lu failed, %lu rejected, %lu window stalls\n",
+           (unsigned long)sessions, (unsigned long)failures, (unsigned long)rejected,
+           (unsigned long)window_stalls);
+    printf("  last: %s (%lu ms, %lu kbit/s)\n", last_result, (unsigned long)last_ms, (unsigned long)last_kbps);
+}
@@ -0,0 +1,49 @@
+#ifndef OTA_H
+#define OTA_H
+
+#include <stdbool.h>
+
+// Firmware update over TCP port 4243 (tools/ota_send.py is the host side).
+//
+// The sender connects and streams, all integers big endian:
+//   0  magic "AOTA"
+//   4  version (2)
+//   5  flags (bit 0 = apply: reboot into the image once it is verified)
+//   6  reserved (2 bytes, zero)
+//   8  image length u32 (the .bin, starting at flash offset 0)
+//  12  CRC-32 of the image (same as zlib.crc32)
+//  16  HMAC-SHA256 of the image keyed with ALARM_OTA_KEY, or its plain
+//      SHA-256 when the firmware is built without a key (32 bytes)
+//  48  image
+// and gets one text line back: "OK <length> <crc>" or "ERR <reason>".
+//
+// The image goes straight into a staging slot in the second megabyte of
+// flash, 4 KB at a time from two alternating buffers, so it is never held
+// in RAM. Each chunk erases a single sector, so interrupts are never off
+// for longer than one sector erase plus program. The CRC is checked over
+// the received stream and over the flash read back, and the digest over
+// the read-back flash. Only the keyed HMAC authenticates the sender;
+// without a key the digest is an integrity check like the CRC.
+//
+// Applying hashes the slot once more, then copies it over the running
+// program from RAM with interrupts off and resets. The RP2040 boot ROM
+// only starts the image at flash offset 0 and has no A/B slot support, so
+// this switch is NOT atomic: losing power during the copy (a few seconds)
+// leaves a unit that needs BOOTSEL. A real A/B scheme would need a
+// separate boot stub at offset 0 and the application linked once per slot
+// address; this tree does not have that.
+
+#define OTA_PORT 4243
+#define OTA_MAGIC "AOTA"
+#define OTA_VERSION 2
+#define OTA_HEADER_LEN 48
+#define OTA_DIGEST_LEN 32
+#define OTA_FLAG_APPLY 0x01
+
+// Starts listening; call with the lwIP lock held
+bool ota_start(void);
+
+// Transfer state, throughput and last result (console key 'o')
+void ota_print_stats(void);
+
+#endif // OTA_H
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/async_context.h"
+
+#include "radio.h"
+#include "input.h"
+#include "wifi_time.h"
+
+#ifndef ALARM_RADIO_DUTY_CYCLE
+#define ALARM_RADIO_DUTY_CYCLE 0
+#endif
+
+#define RADIO_TICK_MS 100
+#define RADIO_LINGER_MS 5000          // Stay in performance mode after the last release
+#define RADIO_WAKE_HOLDOFF_MS 10000   // After a failed wake
+#define RADIO_UI_QUIET_MS 3000        // Background wakes wait for this long without input
+
+#define RADIO_BACKGROUND_USERS ((1u << RADIO_USER_TIME_SYNC) | (1u << RADIO_USER_TELEMETRY))
+
+typedef enum {
+    RADIO_BOOT,     // wifi_time still connecting
+    RADIO_OFF,      // Interface down (duty cycle only)
+    RADIO_WAKING,
+    RADIO_ACTIVE,   // Held by some user, performance PM
+    RADIO_LINGER,   // Released, waiting before going idle
+    RADIO_IDLE      // Associated, aggressive PM
+} radio_state_t;
+
+static const char *const state_names[] = {
+    "boot", "off", "waking", "active", "linger", "idle"
+};
+
+// All state is touched only from the cyw43 async context (lwIP lock held)
+static radio_state_t state = RADIO_BOOT;
+static uint32_t demand = 0;           // Bit per radio_user_t
+static uint32_t current_pm = 0;
+static absolute_time_t state_deadline;
+static absolute_time_t defer_since;
+static bool deferring = false;
+static async_at_time_worker_t tick_worker;
+
+static uint64_t on_since_us = 0;      // Interface powered since (0 = off)
+static uint64_t on_total_us = 0;
+static uint64_t active_since_us = 0;
+static uint64_t active_total_us = 0;
+static uint32_t wakeups = 0;
+static uint32_t wake_failures = 0;
+static uint32_t wake_deferrals = 0;
+static uint32_t wake_last_ms = 0;
+static uint32_t wake_max_ms = 0;
+static uint64_t wake_start_us = 0;
+
+static void set_state(radio_state_t next, uint32_t timeout_ms) {
+    uint64_t now = time_us_64();
+    if (next == RADIO_ACTIVE && state != RADIO_ACTIVE) {
+        active_since_us = now;
+    } else if (next != RADIO_ACTIVE && state == RADIO_ACTIVE) {
+        active_total_us += now - active_since_us;
+    }
+    state = next;
+    state_deadline = make_timeout_time_ms(timeout_ms);
+}
+
+static void set_pm(uint32_t pm) {
+    if (pm == current_pm) return;
+    if (cyw43_wifi_pm(&cyw43_state, pm) == 0) {
+        current_pm = pm;
+    }
+}
+
+static void power_down(void) {
+    // OFF first: the link supervisor must not take the drop for an outage
+    set_state(RADIO_OFF, 0);
+    cyw43_arch_disable_sta_mode();
+    current_pm = 0; // Unknown after the next enable
+    on_total_us += time_us_64() - on_since_us;
+    on_since_us = 0;
+}
+
+static bool power_up(void) {
+    on_since_us = time_us_64();
+    wake_start_us = on_since_us;
+    cyw43_arch_enable_sta_mode();
+    wakeups++;
+    if (!wifi_time_reconnect()) {
+        wake_failures++;
+        power_down();
+        return false;
+    }
+    set_state(RADIO_WAKING, RADIO_WAKE_TIMEOUT_MS);
+    return true;
+}
+
+// Background wakes hold off while the UI is in use, so the wake (and
+// the traffic after it) does not land in the middle of menu input
+static bool wake_deferred(void) {
+    if (demand & ~RADIO_BACKGROUND_USERS) return false;
+
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    uint32_t last = input_last_event_ms();
+    if (last == 0 || now_ms - last >= RADIO_UI_QUIET_MS) {
+        deferring = false;
+        return false;
+    }
+    if (!deferring) {
+        deferring = true;
+        defer_since = get_absolute_time();
+        wake_deferrals++;
+    }
+    if (absolute_time_diff_us(defer_since, get_absolute_time()) / 1000 >= RADIO_UI_DEFER_MAX_MS) {
+        deferring = false;
+        return false;
+    }
+    return true;
+}
+
+static void radio_step(void) {
+    bool expired = time_reached(state_deadline);
+
+    switch (state) {
+        case RADIO_OFF:
+            if (demand && expired && !wake_deferred()) {
+                power_up();
+            }
+            break;
+
+        case RADIO_WAKING:
+            if (wifi_time_link_up()) {
+                wake_last_ms = (uint32_t)((time_us_64() - wake_start_us) / 1000);
+                if (wake_last_ms > wake_max_ms) wake_max_ms = wake_last_ms;
+                set_state(demand ? RADIO_ACTIVE : RADIO_LINGER, RADIO_LINGER_MS);
+            } else if (expired) {
+                printf("Radio: wake timed out\n");
+                wake_failures++;
+                power_down();
+                state_deadline = make_timeout_time_ms(RADIO_WAKE_HOLDOFF_MS);
+            }
+            break;
+
+        case RADIO_ACTIVE:
+            set_pm(CYW43_PERFORMANCE_PM);
+            if (!demand) set_state(RADIO_LINGER, RADIO_LINGER_MS);
+            break;
+
+        case RADIO_LINGER:
+            if (demand) {
+                set_state(RADIO_ACTIVE, 0);
+            } else if (expired) {
+                if (ALARM_RADIO_DUTY_CYCLE) {
+                    power_down();
+                } else {
+                    set_pm(CYW43_AGGRESSIVE_PM);
+                    set_state(RADIO_IDLE, 0);
+                }
+            }
+            break;
+
+        case RADIO_IDLE:
+            if (demand) set_state(RADIO_ACTIVE, 0);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void tick_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    radio_step();
+    async_context_add_at_time_worker_in_ms(context, worker, RADIO_TICK_MS);
+}
+
+void radio_start(void) {
+    if (state != RADIO_BOOT) return;
+
+    on_since_us = 1; // Powered since boot (0 means off)
+    set_state(demand ? RADIO_ACTIVE : RADIO_LINGER, RADIO_LINGER_MS);
+    tick_worker.do_work = tick_worker_fn;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &tick_worker, RADIO_TICK_MS);
+}
+
+void radio_request(radio_user_t user) {
+    demand |= 1u << user;
+}
+
+void radio_release(radio_user_t user) {
+    demand &= ~(1u << user);
+}
+
+bool radio_link_up(void) {
+    return state != RADIO_OFF && state != RADIO_WAKING && wifi_time_link_up();
+}
+
+bool radio_link_expected(void) {
+    return state == RADIO_ACTIVE || state == RADIO_LINGER || state == RADIO_IDLE;
+}
+
+bool radio_duty_cycled(void) {
+    return ALARM_RADIO_DUTY_CYCLE;
+}
+
+void radio_print_stats(void) {
+    // Snapshot under the lock, print outside it
+    cyw43_arch_lwip_begin();
+    uint64_t now = time_us_64();
+    uint64_t on_us = on_total_us + (on_since_us ? now - on_since_us : 0);
+    uint64_t active_us = active_total_us + (state == RADIO_ACTIVE ? now - active_since_us : 0);
+    radio_state_t s = state;
+    uint32_t d = demand;
+    uint32_t pm = current_pm;
+    cyw43_arch_lwip_end();
+
+    printf("Radio: %s, %s, demand 0x%lx, %s PM\n", state_names[s],
+           ALARM_RADIO_DUTY_CYCLE ? "duty cycled" : "always associated", (unsigned long)d,
+           pm == CYW43_PERFORMANCE_PM ? "performance" : pm == CYW43_AGGRESSIVE_PM ? "aggressive" : "default");
+    printf("  on %llu s (%llu%% of uptime), active %llu s\n",
+           (unsigned long long)(on_us / 1000000), (unsigned long long)(on_us * 100 / (now ? now : 1)),
+           (unsigned long long)(active_us / 1000000));
+    printf("  %lu wakeups, %lu failed, %lu deferred for the UI, wake %lu ms (max %lu)\n",
+           (unsigned long)wakeups, (unsigned long)wake_failures, (unsigned long)wake_deferrals,
+           (unsigned long)wake_last_ms, (unsigned long)wake_max_ms);
+}
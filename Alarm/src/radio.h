@@ -0,0 +1,49 @@
+#ifndef RADIO_H
+#define RADIO_H
+
+#include <stdbool.h>
+
+// Wi-Fi radio manager (cyw43 async context). Network jobs ask for the link
+// and release it when done; in between the radio idles:
+//  - default: stays associated in CYW43_AGGRESSIVE_PM, so the HTTP, SNTP
+//    and fleet listeners remain reachable (with more latency)
+//  - ALARM_RADIO_DUTY_CYCLE: the STA interface is brought down and the
+//    chip sleeps until the next request. Listeners are only reachable
+//    while some job holds the link.
+// While a job holds the link the radio runs in CYW43_PERFORMANCE_PM.
+
+#define RADIO_WAKE_TIMEOUT_MS 20000
+#define RADIO_UI_DEFER_MAX_MS 30000   // Longest a background wake waits on the UI
+
+// Worst case from a background radio_request() to the wake giving up
+#define RADIO_WAKE_WORST_MS (RADIO_UI_DEFER_MAX_MS + RADIO_WAKE_TIMEOUT_MS)
+
+typedef enum {
+    RADIO_USER_TIME_SYNC,   // Background: wake may be deferred while the UI is busy
+    RADIO_USER_TELEMETRY,   // Background
+    RADIO_USER_HTTP,        // Open API session
+    RADIO_USER_OTA,         // Firmware transfer in progress
+    RADIO_USER_COUNT
+} radio_user_t;
+
+// Called by wifi_time once the boot connect has finished (either way)
+void radio_start(void);
+
+// Asks for the link (idempotent per user); poll radio_link_up() for it
+void radio_request(radio_user_t user);
+void radio_release(radio_user_t user);
+
+// Associated and has an address
+bool radio_link_up(void);
+
+// The link should be up: boot connect over and the interface not powered
+// down or still waking. A drop while this holds is an outage.
+bool radio_link_expected(void);
+
+// True if the interface is powered down when idle
+bool radio_duty_cycled(void);
+
+// Radio-on time, wakeups and wake latency (console key 'r')
+void radio_print_stats(void);
+
+#endif // RADIO_H
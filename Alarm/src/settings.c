@@ -0,0 +1,43 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "settings.h"
+#include "ringtones.h"
+#include "led_fx.h"
+
+static const settings_t defaults = {
+    .alarm_hour = DEFAULT_ALARM_HOUR,
+    .alarm_minute = DEFAULT_ALARM_MINUTE,
+    .alarm_set = false,
+    .ringtone = DEFAULT_RINGTONE,
+    .color = DEFAULT_COLOR,
+    .brightness = DEFAULT_BRIGHTNESS,
+};
+
+static settings_t current = defaults;
+static volatile uint32_t version = 0;
+
+void settings_get(settings_t *out) {
+    uint32_t irq = save_and_disable_interrupts();
+    *out = current;
+    restore_interrupts(irq);
+}
+
+bool settings_set(const settings_t *in) {
+    if (in->alarm_hour > 23 || in->alarm_minute > 59 || in->ringtone >= RINGTONE_COUNT ||
+        in->color >= led_fx_palette_size() || in->brightness > LED_BRIGHTNESS_MAX) {
+        return false;
+    }
+    uint32_t irq = save_and_disable_interrupts();
+    current = *in;
+    version++;
+    restore_interrupts(irq);
+    return true;
+}
+
+void settings_reset(void) {
+    settings_set(&defaults);
+}
+
+uint32_t settings_version(void) {
+    return version;
+}
@@ -0,0 +1,34 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEFAULT_ALARM_HOUR 12
+#define DEFAULT_ALARM_MINUTE 0
+#define DEFAULT_RINGTONE 0
+#define DEFAULT_COLOR 0
+#define DEFAULT_BRIGHTNESS 10
+
+// User settings shared by the menu (main loop) and the HTTP API (cyw43
+// async context). Both sides work on copies, swapped in with IRQs off.
+typedef struct {
+    uint8_t alarm_hour;
+    uint8_t alarm_minute;
+    bool alarm_set;
+    uint8_t ringtone;   // Index into ringtones[]
+    uint8_t color;      // led_fx palette index
+    uint8_t brightness; // 0..LED_BRIGHTNESS_MAX
+} settings_t;
+
+void settings_get(settings_t *out);
+
+// Replaces all settings; false (and nothing changed) if a field is out of range
+bool settings_set(const settings_t *in);
+
+void settings_reset(void);
+
+// Bumped on every change, so the menu can tell when to redraw
+uint32_t settings_version(void);
+
+#endif // SETTINGS_H
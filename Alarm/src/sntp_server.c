@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#include "sntp_server.h"
+#include "timekeeper.h"
+
+#define NTP_PORT 123
+#define NTP_TIMESTAMP_DELTA 2208988800ll // 1900 -> 1970
+#define NTP_PACKET_SIZE 48
+
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_LEAP_UNSYNCED 3
+#define NTP_PRECISION -20 // ~1 us timer
+
+#define RATE_WINDOW_MS 60000
+
+typedef struct {
+    uint8_t li_vn_mode;
+    uint8_t stratum;
+    uint8_t poll;
+    int8_t precision;
+    uint32_t root_delay;
+    uint32_t root_dispersion;
+    uint32_t ref_id;
+    uint32_t ref_timestamp[2];
+    uint32_t orig_timestamp[2];
+    uint32_t rx_timestamp[2];
+    uint32_t tx_timestamp[2];
+} ntp_packet_t;
+
+// All state is touched only from the cyw43 async context (lwIP lock held)
+static struct udp_pcb *pcb = NULL;
+static struct pbuf *reply_buf = NULL; // Reused for every reply
+static uint8_t stratum = 16;
+static uint32_t ref_id = 0;
+static uint32_t root_delay = 0;       // NTP short format (16.16 s)
+static int64_t ref_unix_us = 0;
+
+static uint32_t requests = 0;
+static uint32_t replies = 0;
+static uint32_t rejected = 0;
+static uint32_t reply_allocs = 0;     // Times the reply pbuf was still busy
+static uint32_t window_start_ms = 0;
+static uint32_t window_requests = 0;
+static uint32_t rate_per_min = 0;
+
+static void unix_us_to_ntp(int64_t unix_us, uint32_t ts[2]) {
+    uint64_t us = (uint64_t)(unix_us % 1000000);
+    ts[0] = htonl((uint32_t)(unix_us / 1000000 + NTP_TIMESTAMP_DELTA));
+    ts[1] = htonl((uint32_t)((us << 32) / 1000000));
+}
+
+// The reply pbuf can only be reused once lwIP and the driver let go of it;
+// udp_sendto also leaves the payload pointing at the headers it added
+static struct pbuf *get_reply_buf(void) {
+    if (reply_buf && reply_buf->ref != 1) {
+        pbuf_free(reply_buf);
+        reply_buf = NULL;
+    }
+    if (!reply_buf) {
+        reply_buf = pbuf_alloc(PBUF_TRANSPORT, NTP_PACKET_SIZE, PBUF_RAM);
+        reply_allocs++;
+    } else if (reply_buf->tot_len != NTP_PACKET_SIZE) {
+        pbuf_remove_header(reply_buf, reply_buf->tot_len - NTP_PACKET_SIZE);
+    }
+    return reply_buf;
+}
+
+// Requests per minute over the last complete window
+static void roll_rate_window(void) {
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    uint32_t elapsed = now_ms - window_start_ms;
+    if (elapsed >= RATE_WINDOW_MS) {
+        rate_per_min = (uint32_t)((uint64_t)window_requests * RATE_WINDOW_MS / elapsed);
+        window_start_ms = now_ms;
+        window_requests = 0;
+    }
+}
+
+static void sntp_recv_cb(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                         const ip_addr_t *addr, u16_t port) {
+    int64_t rx_unix_us;
+    bool synced = timekeeper_now_us(&rx_unix_us); // Before anything else
+    if (!p) return;
+
+    requests++;
+    window_requests++;
+    roll_rate_window();
+
+    ntp_packet_t request;
+    bool valid = p->tot_len >= NTP_PACKET_SIZE &&
+                 pbuf_copy_partial(p, &request, NTP_PACKET_SIZE, 0) == NTP_PACKET_SIZE;
+    pbuf_free(p);
+    if (!valid || (request.li_vn_mode & 0x07) != NTP_MODE_CLIENT || !synced) {
+        rejected++;
+        return;
+    }
+
+    struct pbuf *out = get_reply_buf();
+    if (!out) {
+        rejected++;
+        return;
+    }
+
+    ntp_packet_t reply = {0};
+    reply.li_vn_mode = (stratum >= 16 ? NTP_LEAP_UNSYNCED << 6 : 0) |
+                       (request.li_vn_mode & 0x38) | NTP_MODE_SERVER;
+    reply.stratum = stratum;
+    reply.poll = request.poll;
+    reply.precision = NTP_PRECISION;
+    reply.root_delay = htonl(root_delay);
+    reply.root_dispersion = htonl(1 << 6); // ~1 ms
+    reply.ref_id = ref_id;
+    unix_us_to_ntp(ref_unix_us, reply.ref_timestamp);
+    reply.orig_timestamp[0] = request.tx_timestamp[0];
+    reply.orig_timestamp[1] = request.tx_timestamp[1];
+    unix_us_to_ntp(rx_unix_us, reply.rx_timestamp);
+
+    int64_t tx_unix_us;
+    timekeeper_now_us(&tx_unix_us);
+    unix_us_to_ntp(tx_unix_us, reply.tx_timestamp);
+    pbuf_take(out, &reply, NTP_PACKET_SIZE);
+
+    if (udp_sendto(upcb, out, addr, port) == ERR_OK) {
+        replies++;
+    } else {
+        rejected++;
+    }
+}
+
+bool sntp_server_start(void) {
+    if (pcb) return true;
+
+    pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        printf("SNTP server: failed to create UDP PCB\n");
+        return false;
+    }
+    if (udp_bind(pcb, IP_ANY_TYPE, NTP_PORT) != ERR_OK) {
+        printf("SNTP server: failed to bind port %d\n", NTP_PORT);
+        udp_remove(pcb);
+        pcb = NULL;
+        return false;
+    }
+    udp_recv(pcb, sntp_recv_cb, NULL);
+    get_reply_buf(); // Allocate up front
+    window_start_ms = to_ms_since_boot(get_absolute_time());
+
+    printf("SNTP server listening on port %d\n", NTP_PORT);
+    return true;
+}
+
+void sntp_server_set_upstream(const ip_addr_t *server, uint8_t upstream_stratum, uint32_t delay_us) {
+    stratum = upstream_stratum < 15 ? upstream_stratum + 1 : 16;
+    ref_id = ip4_addr_get_u32(ip_2_ip4(server)); // Already network byte order
+    root_delay = (uint32_t)(((uint64_t)delay_us << 16) / 1000000);
+    timekeeper_now_us(&ref_unix_us);
+}
+
+void sntp_server_print_stats(void) {
+    if (!pcb) {
+        printf("SNTP server: not running\n");
+        return;
+    }
+    roll_rate_window();
+    printf("SNTP server: stratum %d, %u requests (%u/min), %u replies, %u rejected, %u reply allocs\n",
+           stratum, (unsigned)requests, (unsigned)rate_per_min, (unsigned)replies,
+           (unsigned)rejected, (unsigned)reply_allocs);
+}
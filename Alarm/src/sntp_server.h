@@ -0,0 +1,22 @@
+#ifndef SNTP_SERVER_H
+#define SNTP_SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lwip/ip_addr.h"
+
+// SNTP responder on UDP 123, answering from the disciplined local clock
+// (timekeeper) so other clocks on the LAN can sync from this one.
+// Enabled with the ALARM_SNTP_SERVER CMake option.
+
+// Binds the port; call from the cyw43 async context after the first sync
+bool sntp_server_start(void);
+
+// Upstream the local clock follows: our stratum is one more, ref-id is the
+// server address, delay_us goes into the root delay
+void sntp_server_set_upstream(const ip_addr_t *server, uint8_t stratum, uint32_t delay_us);
+
+// Prints request counters and rate (console key 'n')
+void sntp_server_print_stats(void);
+
+#endif // SNTP_SERVER_H
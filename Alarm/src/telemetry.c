@@ -0,0 +1,87 @@
+#include <malloc.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "telemetry.h"
+#include "net.h"
+
+// The producer is the main loop and the consumer the cyw43 async context,
+// which runs from an IRQ on the same core: the consumer cannot be
+// interrupted by the producer, so only the producer needs a critical
+// section (it may move tail when it overwrites the oldest sample).
+static telemetry_sample_t ring[TELEMETRY_RING_SIZE];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+static volatile uint32_t overwritten = 0;
+static volatile uint32_t alarm_fires = 0;
+
+// Loop latency accumulated over the current sample period
+static uint64_t last_poll_us = 0;
+static uint64_t loop_sum_us = 0;
+static uint32_t loop_count = 0;
+static uint32_t loop_max_us = 0;
+static uint32_t next_sample_ms = TELEMETRY_SAMPLE_MS;
+
+static void push(const telemetry_sample_t *sample) {
+    uint32_t irq = save_and_disable_interrupts();
+    if (ring_head - ring_tail >= TELEMETRY_RING_SIZE) {
+        ring_tail++;
+        overwritten++;
+    }
+    ring[ring_head % TELEMETRY_RING_SIZE] = *sample;
+    ring_head++;
+    restore_interrupts(irq);
+}
+
+void telemetry_poll(void) {
+    uint64_t now_us = time_us_64();
+    if (last_poll_us) {
+        uint32_t loop_us = (uint32_t)(now_us - last_poll_us);
+        loop_sum_us += loop_us;
+        loop_count++;
+        if (loop_us > loop_max_us) loop_max_us = loop_us;
+    }
+    last_poll_us = now_us;
+
+    uint32_t now_ms = (uint32_t)(now_us / 1000);
+    if ((int32_t)(now_ms - next_sample_ms) < 0) return;
+    next_sample_ms += TELEMETRY_SAMPLE_MS;
+
+    // mallinfo takes the malloc lock, which is fine here but not in an IRQ
+    struct mallinfo heap = mallinfo();
+    telemetry_sample_t sample = {
+        .uptime_s = now_ms / 1000,
+        .ntp_offset_us = net_clock_residual_us(),
+        .alarm_fires = alarm_fires,
+        .loop_avg_us = loop_count ? (uint32_t)(loop_sum_us / loop_count) : 0,
+        .loop_max_us = loop_max_us,
+        .heap_used = heap.uordblks,
+    };
+    push(&sample);
+
+    loop_sum_us = 0;
+    loop_count = 0;
+    loop_max_us = 0;
+}
+
+void telemetry_alarm_fired(void) {
+    alarm_fires++;
+}
+
+int telemetry_peek(telemetry_sample_t *out, int max) {
+    uint32_t tail = ring_tail;
+    int count = (int)(ring_head - tail);
+    if (count > max) count = max;
+    for (int i = 0; i < count; i++) {
+        out[i] = ring[(tail + i) % TELEMETRY_RING_SIZE];
+    }
+    return count;
+}
+
+void telemetry_consume(int count) {
+    uint32_t available = ring_head - ring_tail;
+    ring_tail += (uint32_t)count < available ? (uint32_t)count : available;
+}
+
+uint32_t telemetry_overwritten(void) {
+    return overwritten;
+}
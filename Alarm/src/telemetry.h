@@ -0,0 +1,43 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Device metrics sampled from the main loop into a fixed ring, drained in
+// batches by the MQTT publisher (mqtt_pub.c). When the ring is full the
+// oldest sample is overwritten, so a long broker outage keeps the most
+// recent history.
+
+#define TELEMETRY_RING_SIZE 32      // Power of two
+#define TELEMETRY_SAMPLE_MS 10000
+
+typedef struct {
+    uint32_t uptime_s;
+    int32_t ntp_offset_us;   // Residual at the last NTP resync
+    uint32_t alarm_fires;    // Since boot
+    uint32_t loop_avg_us;    // Main loop iteration time over the sample period
+    uint32_t loop_max_us;
+    uint32_t heap_used;      // malloc'd bytes
+} telemetry_sample_t;
+
+// Call once per main loop iteration: measures loop latency and takes a
+// sample every TELEMETRY_SAMPLE_MS. Never blocks.
+void telemetry_poll(void);
+
+// Counts an alarm going off
+void telemetry_alarm_fired(void);
+
+// Consumer side, called from the cyw43 async context: copies up to max of
+// the oldest samples without removing them
+int telemetry_peek(telemetry_sample_t *out, int max);
+
+// Drops the count oldest samples once they have been queued for sending.
+// Call from the same async context callback as the peek, so the main loop
+// cannot overwrite anything in between.
+void telemetry_consume(int count);
+
+// Samples overwritten before they could be sent
+uint32_t telemetry_overwritten(void);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/structs/timer.h"
+#include "pps_capture.pio.h"
+
+#include "time_link.h"
+#include "timekeeper.h"
+#include "net.h"
+
+#define TIME_LINK_UART uart0
+#define PPS_WIDTH_US 100000
+#define EDGE_MAX_AGE_US 100000       // The frame must follow its edge within this
+#define HOLDOVER_MS 10000            // Stop relaying this long after the last frame
+#define STEP_THRESHOLD_US 250
+#define DRIFT_INTERVAL_US (64 * 1000000ll)
+#define DRIFT_FILTER 4               // Weight of a new drift measurement, as 1/n
+#define MAX_HOPS 16                  // Also ends relay loops once the master is gone
+#define MAX_WIRE 32                  // Longest frame accepted, delimiter excluded
+
+#define MSG_TIME 0x10
+#define MSG_TIME_LEN 10
+#define FLAG_NTP 0x01
+
+static bool started = false;
+
+// Serving side, alarm IRQ only
+static int64_t scheduled_second = 0;
+static uint8_t tx_seq = 0;
+static volatile uint32_t pulses_sent = 0;
+static volatile uint32_t tx_truncated = 0;
+
+// Receiving side: edges and frames are captured in IRQs and handed to
+// time_link_poll() through a single frame slot
+static volatile uint64_t edge_us = 0;
+static volatile uint32_t edges = 0;
+static volatile uint32_t capture_lo = 0;     // Raw timer at the last edge, written by DMA
+static uint32_t capture_sink;                // Where the FIFO word is drained to
+static bool capture_ok = false;              // PIO + DMA capture running
+static uint8_t rx_buf[MAX_WIRE];
+static uint32_t rx_len = 0;
+static bool rx_overflow = false;
+static uint8_t frame[MAX_WIRE];
+static uint32_t frame_len = 0;
+static uint64_t frame_edge_us = 0;
+static uint64_t frame_rx_us = 0;
+static volatile bool frame_pending = false;
+static volatile uint32_t frames_dropped = 0; // Previous one not handled yet
+static volatile uint32_t frames_oversize = 0;
+
+// Main loop only, except the lock which the alarm IRQ reads
+static volatile bool lock = false;
+static volatile uint32_t last_accept_ms = 0;
+static volatile uint8_t rx_hops = 0;
+static uint8_t rx_seq = 0;
+static bool have_seq = false;
+static uint32_t frames_rx = 0;
+static uint32_t crc_errors = 0;
+static uint32_t bad_frames = 0;
+static uint32_t seq_gaps = 0;
+static uint32_t no_edge = 0;
+static uint32_t ignored = 0;
+static uint32_t steps = 0;
+static int64_t last_residual_us = 0;
+static bool have_drift_ref = false;
+static bool have_drift = false;
+static int64_t drift_ref_offset_us;
+static uint64_t drift_ref_local_us;
+
+// CRC-16/CCITT-FALSE, bitwise: frames are 15 bytes once a second
+static uint16_t crc16(const uint8_t *p, uint32_t len) {
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (uint16_t)(crc << 1) ^ 0x1021 : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Frames stay under 254 bytes, so one code byte per zero and no 0xFF blocks
+static uint32_t cobs_encode(const uint8_t *in, uint32_t len, uint8_t *out) {
+    uint32_t code_pos = 0;
+    uint32_t o = 1;
+    uint8_t code = 1;
+    for (uint32_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        } else {
+            out[o++] = in[i];
+            code++;
+        }
+    }
+    out[code_pos] = code;
+    out[o++] = 0;
+    return o;
+}
+
+// In place; the output never overtakes the input. -1 if malformed.
+static int32_t cobs_decode(uint8_t *buf, uint32_t len) {
+    uint32_t in = 0;
+    uint32_t out = 0;
+    while (in < len) {
+        uint8_t code = buf[in++];
+        if (code == 0 || in + code - 1 > len) return -1;
+        for (uint8_t k = 1; k < code; k++) {
+            buf[out++] = buf[in++];
+        }
+        if (code != 0xFF && in < len) {
+            buf[out++] = 0;
+        }
+    }
+    return (int32_t)out;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Called from the alarm IRQ right after the edge. The frame (17 bytes on
+// the wire) fits the 32-byte UART FIFO, which is empty a second after the
+// previous one, so this never waits.
+static void send_time(uint32_t second, int32_t late_us, uint8_t hops, uint8_t flags) {
+    uint8_t raw[3 + MSG_TIME_LEN + 2];
+    uint8_t wire[sizeof(raw) + 2];
+
+    raw[0] = tx_seq++;
+    raw[1] = MSG_TIME_LEN;
+    raw[2] = MSG_TIME;
+    put_u32(&raw[3], second);
+    put_u32(&raw[7], (uint32_t)late_us);
+    raw[11] = hops;
+    raw[12] = flags;
+    uint16_t crc = crc16(raw, 13);
+    raw[13] = (uint8_t)crc;
+    raw[14] = (uint8_t)(crc >> 8);
+
+    uint32_t n = cobs_encode(raw, sizeof(raw), wire);
+    for (uint32_t i = 0; i < n; i++) {
+        if (!uart_is_writable(TIME_LINK_UART)) {
+            tx_truncated++; // The CRC makes the receiver drop it
+            break;
+        }
+        uart_get_hw(TIME_LINK_UART)->dr = wire[i];
+    }
+}
+
+static bool serving(uint8_t *hops, uint8_t *flags) {
+    if (net_clock_synced()) {
+        *hops = 0;
+        *flags = FLAG_NTP;
+        return true;
+    }
+    if (time_link_locked() && rx_hops + 1 < MAX_HOPS) {
+        *hops = rx_hops + 1;
+        *flags = 0;
+        return true;
+    }
+    return false;
+}
+
+static void schedule_next_edge(void);
+
+static int64_t pps_fall_cb(alarm_id_t id, void *user_data) {
+    gpio_put(TIME_LINK_PPS_OUT_PIN, 0);
+    schedule_next_edge();
+    return 0;
+}
+
+static int64_t pps_rise_cb(alarm_id_t id, void *user_data) {
+    uint8_t hops, flags;
+    if (!serving(&hops, &flags)) {
+        schedule_next_edge();
+        return 0;
+    }
+
+    gpio_put(TIME_LINK_PPS_OUT_PIN, 1);
+    uint64_t edge = time_us_64();
+
+    // Tell the receivers how late the pulse really went out, so the alarm
+    // IRQ latency drops out. Measured on our own model, so it stays right
+    // even if the clock was stepped after this alarm was set.
+    int64_t unix_edge = 0;
+    timekeeper_unix_at(edge, &unix_edge);
+    send_time((uint32_t)scheduled_second, (int32_t)(unix_edge - scheduled_second * 1000000), hops, flags);
+    pulses_sent++;
+
+    add_alarm_in_us(PPS_WIDTH_US, pps_fall_cb, NULL, true);
+    return 0;
+}
+
+static int64_t retry_cb(alarm_id_t id, void *user_data) {
+    schedule_next_edge();
+    return 0;
+}
+
+// Next whole UTC second on our clock, or a second from now while there is
+// no time at all
+static void schedule_next_edge(void) {
+    int64_t now_unix;
+    uint64_t at;
+    if (!timekeeper_now_us(&now_unix)) {
+        add_alarm_in_us(1000000, retry_cb, NULL, true);
+        return;
+    }
+    scheduled_second = now_unix / 1000000 + 1;
+    timekeeper_local_at(scheduled_second * 1000000, &at);
+    if (at < time_us_64() + 1000) {
+        scheduled_second++;
+        timekeeper_local_at(scheduled_second * 1000000, &at);
+    }
+    // 0 means the edge was already due and pps_rise_cb has run, which
+    // continues the chain; only a missing alarm slot needs the retry
+    if (add_alarm_at(from_us_since_boot(at), pps_rise_cb, NULL, true) < 0) {
+        add_alarm_in_us(1000000, retry_cb, NULL, true);
+    }
+}
+
+// Runs at the default priority, alongside the SDK's CYW43 GPIO handler.
+// The edge time itself was latched by the DMA, a few cycles after the
+// edge; this only extends the 32-bit capture with the upper timer bits.
+// If the capture is somehow not there yet, the edge looks a second old
+// and apply_time() drops it as missing.
+static void pps_irq_handler(void) {
+    if (gpio_get_irq_event_mask(TIME_LINK_PPS_IN_PIN) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq(TIME_LINK_PPS_IN_PIN, GPIO_IRQ_EDGE_RISE);
+        uint64_t now = time_us_64();
+        uint64_t edge = now;
+        if (capture_ok) {
+            edge = (now & ~(uint64_t)0xFFFFFFFF) | capture_lo;
+            if (edge > now) edge -= (uint64_t)1 << 32;
+        }
+        edge_us = edge;
+        edges++;
+    }
+}
+
+// PIO pushes on each PPS edge (pps_capture.pio); the push paces one DMA
+// read of TIMERAWL, then a second, unpaced channel pops that word right
+// away and chains back, so the pair stays armed with no CPU involvement
+// and the FIFO never holds more than the one word
+static bool capture_start(void) {
+    PIO pio = pio0;
+    if (!pio_can_add_program(pio, &pps_capture_program)) {
+        pio = pio1;
+        if (!pio_can_add_program(pio, &pps_capture_program)) return false;
+    }
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) return false;
+    int capture_chan = dma_claim_unused_channel(false);
+    int drain_chan = dma_claim_unused_channel(false);
+    if (capture_chan < 0 || drain_chan < 0) {
+        if (capture_chan >= 0) dma_channel_unclaim(capture_chan);
+        if (drain_chan >= 0) dma_channel_unclaim(drain_chan);
+        pio_sm_unclaim(pio, sm);
+        return false;
+    }
+    uint dreq = pio_get_dreq(pio, sm, false);
+
+    dma_channel_config c = dma_channel_get_default_config(capture_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, dreq);
+    channel_config_set_chain_to(&c, drain_chan);
+    channel_config_set_high_priority(&c, true); // Ahead of the audio and matrix streams
+    dma_channel_configure(capture_chan, &c, (void *)&capture_lo, &timer_hw->timerawl, 1, false);
+
+    c = dma_channel_get_default_config(drain_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_chain_to(&c, capture_chan);
+    dma_channel_configure(drain_chan, &c, &capture_sink, &pio->rxf[sm], 1, false);
+
+    uint offset = pio_add_program(pio, &pps_capture_program);
+    dma_channel_start(capture_chan); // Waits on the DREQ for the first edge
+    pps_capture_program_init(pio, sm, offset, TIME_LINK_PPS_IN_PIN);
+    return true;
+}
+
+static void uart_irq_handler(void) {
+    while (uart_is_readable(TIME_LINK_UART)) {
+        uint8_t c = (uint8_t)uart_get_hw(TIME_LINK_UART)->dr;
+        if (c != 0) {
+            if (rx_len < sizeof(rx_buf)) {
+                rx_buf[rx_len++] = c;
+            } else {
+                rx_overflow = true;
+            }
+            continue;
+        }
+
+        if (rx_overflow) {
+            frames_oversize++;
+        } else if (rx_len && frame_pending) {
+            frames_dropped++;
+        } else if (rx_len) {
+            memcpy(frame, rx_buf, rx_len);
+            frame_len = rx_len;
+            frame_rx_us = time_us_64();
+            // The edge IRQ can preempt this one mid-read
+            uint32_t irq = save_and_disable_interrupts();
+            frame_edge_us = edge_us;
+            restore_interrupts(irq);
+            frame_pending = true;
+        }
+        rx_len = 0;
+        rx_overflow = false;
+    }
+}
+
+static void apply_time(const uint8_t *p, uint64_t edge, uint64_t rx_at) {
+    uint32_t second = get_u32(p);
+    int32_t late_us = (int32_t)get_u32(p + 4);
+    uint8_t hops = p[8];
+
+    // NTP owns the clock model once it has synced (time_sync steers the
+    // offset and drift from then on); too many hops is a loop
+    if (net_clock_synced() || hops >= MAX_HOPS) {
+        ignored++;
+        return;
+    }
+    if (!edge || rx_at - edge > EDGE_MAX_AGE_US) {
+        no_edge++; // PPS not wired, or the pulse was missed
+        return;
+    }
+
+    // UTC at our captured edge, as an offset from the raw local timer
+    int64_t truth_us = (int64_t)second * 1000000 + late_us;
+    int64_t offset_us = truth_us - (int64_t)edge;
+    int64_t model_us;
+    bool was_locked = time_link_locked();
+    last_residual_us = timekeeper_unix_at(edge, &model_us) ? truth_us - model_us : 0;
+
+    // Raw crystal drift over long intervals, smoothed like the NTP path
+    if (was_locked && have_drift_ref && edge - drift_ref_local_us >= DRIFT_INTERVAL_US) {
+        int64_t measured_ppb = (offset_us - drift_ref_offset_us) * 1000000000 / (int64_t)(edge - drift_ref_local_us);
+        int32_t drift = timekeeper_drift_ppb();
+        drift = have_drift ? drift + (int32_t)((measured_ppb - drift) / DRIFT_FILTER) : (int32_t)measured_ppb;
+        have_drift = true;
+        timekeeper_set_drift_ppb(drift);
+        have_drift_ref = false;
+    }
+    if (!was_locked || !have_drift_ref) {
+        drift_ref_offset_us = offset_us;
+        drift_ref_local_us = edge;
+        have_drift_ref = true;
+    }
+
+    int64_t residual = last_residual_us < 0 ? -last_residual_us : last_residual_us;
+    if (!was_locked || !timekeeper_synced() || residual > STEP_THRESHOLD_US) {
+        timekeeper_set_offset(offset_us);
+        steps++;
+        if (!was_locked) {
+            printf("Time link: locked, %u hops from the master\n", hops);
+        }
+    }
+
+    rx_hops = hops;
+    last_accept_ms = to_ms_since_boot(get_absolute_time());
+    lock = true;
+}
+
+static void handle_frame(uint8_t *buf, uint32_t wire_len, uint64_t edge, uint64_t rx_at) {
+    int32_t len = cobs_decode(buf, wire_len);
+    if (len < 3) {
+        bad_frames++;
+        return;
+    }
+    if (crc16(buf, len - 2) != (buf[len - 2] | (buf[len - 1] << 8))) {
+        crc_errors++;
+        return;
+    }
+    if (have_seq && buf[0] != (uint8_t)(rx_seq + 1)) {
+        seq_gaps += (uint8_t)(buf[0] - rx_seq - 1);
+    }
+    rx_seq = buf[0];
+    have_seq = true;
+    frames_rx++;
+
+    // Same message layout as the Tarefa4Q3 link; skip what we do not know
+    int32_t pos = 1;
+    while (pos + 2 <= len - 2) {
+        uint8_t msg_len = buf[pos];
+        uint8_t type = buf[pos + 1];
+        if (pos + 2 + msg_len > len - 2) {
+            bad_frames++;
+            return;
+        }
+        if (type == MSG_TIME && msg_len >= MSG_TIME_LEN) {
+            apply_time(&buf[pos + 2], edge, rx_at);
+        }
+        pos += 2 + msg_len;
+    }
+}
+
+void time_link_start(void) {
+    if (started) return;
+    started = true;
+
+    uart_init(TIME_LINK_UART, TIME_LINK_BAUD);
+    uart_set_fifo_enabled(TIME_LINK_UART, true);
+    gpio_set_function(TIME_LINK_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(TIME_LINK_RX_PIN, GPIO_FUNC_UART);
+    gpio_pull_up(TIME_LINK_RX_PIN); // Idle line when nothing is wired upstream
+    irq_set_exclusive_handler(UART0_IRQ, uart_irq_handler);
+    irq_set_enabled(UART0_IRQ, true);
+    uart_set_irq_enables(TIME_LINK_UART, true, false);
+
+    gpio_init(TIME_LINK_PPS_OUT_PIN);
+    gpio_set_dir(TIME_LINK_PPS_OUT_PIN, GPIO_OUT);
+    gpio_put(TIME_LINK_PPS_OUT_PIN, 0);
+
+    gpio_init(TIME_LINK_PPS_IN_PIN);
+    gpio_set_dir(TIME_LINK_PPS_IN_PIN, GPIO_IN);
+    gpio_pull_down(TIME_LINK_PPS_IN_PIN);
+    capture_ok = capture_start();
+    if (!capture_ok) {
+        printf("Time link: no PIO/DMA for edge capture, timestamping in the GPIO IRQ\n");
+    }
+    gpio_add_raw_irq_handler(TIME_LINK_PPS_IN_PIN, pps_irq_handler);
+    gpio_set_irq_enabled(TIME_LINK_PPS_IN_PIN, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    schedule_next_edge();
+}
+
+void time_link_poll(void) {
+    if (!started) return;
+
+    // NTP synced while we followed the link: hand the model over for good
+    if (lock && net_clock_synced()) {
+        lock = false;
+        have_drift_ref = false;
+        printf("Time link: NTP synced, no longer following the link\n");
+    }
+    if (!frame_pending) return;
+
+    uint8_t buf[MAX_WIRE];
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t len = frame_len;
+    uint64_t edge = frame_edge_us;
+    uint64_t rx_at = frame_rx_us;
+    memcpy(buf, frame, len);
+    frame_pending = false;
+    restore_interrupts(irq);
+
+    handle_frame(buf, len, edge, rx_at);
+}
+
+bool time_link_locked(void) {
+    return lock && to_ms_since_boot(get_absolute_time()) - last_accept_ms < HOLDOVER_MS;
+}
+
+void time_link_print_stats(void) {
+    if (!started) {
+        printf("Time link: not started\n");
+        return;
+    }
+    if (net_clock_synced()) {
+        printf("Time link: master (NTP), serving hops 0\n");
+    } else if (time_link_locked()) {
+        printf("Time link: locked, %u hops from the master, relaying\n", rx_hops);
+    } else {
+        printf("Time link: listening\n");
+    }
+    printf("  %lu pulses sent (%lu truncated), %lu PPS edges in (%s capture)\n",
+           (unsigned long)pulses_sent, (unsigned long)tx_truncated, (unsigned long)edges,
+           capture_ok ? "DMA" : "IRQ");
+    printf("  %lu frames, %lu CRC errors, %lu bad, %lu oversize, %lu dropped, %lu seq gaps\n",
+           (unsigned long)frames_rx, (unsigned long)crc_errors, (unsigned long)bad_frames,
+           (unsigned long)frames_oversize, (unsigned long)frames_dropped, (unsigned long)seq_gaps);
+    printf("  %lu without an edge, %lu ignored, %lu steps, last residual %lld us, drift %ld ppb\n",
+           (unsigned long)no_edge, (unsigned long)ignored, (unsigned long)steps,
+           (long long)last_residual_us, (long)timekeeper_drift_ppb());
+}
@@ -0,0 +1,58 @@
+#ifndef TIME_LINK_H
+#define TIME_LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Clock distribution to units without Wi-Fi (cmake -DALARM_TIME_LINK=ON).
+//
+// Wiring, same UART0 pins as Tarefa4Q3, plus ground:
+//   GP0 UART0 TX  -> GP1 UART0 RX of the next unit
+//   GP2 PPS out   -> GP3 PPS in of the next unit
+// A master's GP0/GP2 can also fan out to several units at once
+// (broadcast), or each unit feeds the next (daisy chain).
+//
+// Every unit whose clock is good drives PPS high on each UTC second
+// boundary (100 ms pulse), then sends one frame at 115200 baud saying which
+// second that edge was and how late the pulse actually went out. The frame
+// uses the Tarefa4Q3 link format (COBS, 0x00 delimiter, sequence byte,
+// CRC-16/CCITT-FALSE), one TIME message:
+//   second u32, edge_late_us i32, hops u8, flags u8   (little endian)
+//
+// A receiver latches the timer at the PPS rising edge in hardware (a PIO
+// state machine paces a DMA read of TIMERAWL, see pps_capture.pio), and
+// when the frame follows within 100 ms it knows the UTC time of that edge
+// exactly: neither the UART nor the IRQ latency matters. It steps
+// the clock when it is more than 250 us off and learns the crystal drift
+// over 64 s intervals, like the NTP path does.
+//
+// Roles are automatic: an NTP-synced unit serves with hops 0 and ignores
+// the link; a unit locked to the link relays with hops + 1, so chains
+// work without configuration; a unit that has heard nothing for 10 s stops
+// serving. Only one source steers the clock model (offset and drift) at a
+// time: the link until NTP syncs, then NTP for good, so a master wired to
+// an upstream link does not fight its own NTP discipline. The sender
+// reports its own alarm IRQ lateness, so each hop adds well under a
+// microsecond.
+
+#define TIME_LINK_TX_PIN 0
+#define TIME_LINK_RX_PIN 1
+#define TIME_LINK_PPS_OUT_PIN 2
+#define TIME_LINK_PPS_IN_PIN 3
+#define TIME_LINK_BAUD 115200
+
+// Claims UART0 and the pins and starts the once-a-second schedule
+void time_link_start(void);
+
+// Applies received time frames; call from the main loop. The edges and
+// bytes are captured in IRQs, so a slow loop iteration costs no accuracy.
+void time_link_poll(void);
+
+// True while the clock follows the link (recent frame accepted)
+bool time_link_locked(void);
+
+// Role, pulses sent, frames received, errors and the last residual
+// (console key 'l')
+void time_link_print_stats(void);
+
+#endif // TIME_LINK_H
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/async_context.h"
+#include "hardware/sync.h"
+
+#include "time_sync.h"
+#include "ntp_client.h"
+#include "timekeeper.h"
+#include "sntp_server.h"
+#include "radio.h"
+
+#define RESYNC_MIN_S 64
+#define RESYNC_MAX_S (6 * 3600)
+#define RESYNC_RETRY_S 60
+#define RTC_ALIGN_PERIOD_MS (5 * 60 * 1000)
+#define NTP_WAIT_MS 3000
+#define LINK_POLL_MS 200
+// Longer than a deferred background wake, so the radio gives up first
+#define LINK_WAIT_MS (RADIO_WAKE_WORST_MS + 5000)
+
+// Residual thresholds for growing / shrinking the interval
+#define RESIDUAL_GOOD_US 10000
+#define RESIDUAL_BAD_US 50000
+
+// Far outside what a working crystal does; anything beyond is a bad sample
+#define DRIFT_MAX_PPB 200000
+// A measurement over this interval gets half weight, longer ones more
+#define DRIFT_WEIGHT_S 1024
+// Samples queued this much longer than the fastest one are kept out of the
+// drift estimate; the floor rises 1 us per DELAY_AGE_S to follow route changes
+#define DELAY_MARGIN_US 2000
+#define DELAY_AGE_S 4
+
+// State is only touched from the cyw43 async context
+static ip_addr_t servers[NTP_CLIENT_MAX_SERVERS];
+static int server_count = 0;
+static async_at_time_worker_t resync_worker;
+static async_at_time_worker_t align_worker;
+
+static uint32_t interval_s = RESYNC_MIN_S;
+static int64_t last_offset_us;   // Measured (raw, undisciplined) offset at the last drift reference
+static int64_t last_local_us;
+static int64_t last_sample_us;
+static int64_t last_residual_us = 0;
+static uint32_t min_delay_us = UINT32_MAX;
+static uint32_t syncs = 0;
+static uint32_t failures = 0;
+static uint32_t drift_rejects = 0;
+static bool waiting_link = false;
+static bool querying = false;
+static absolute_time_t link_deadline;
+
+static void schedule_resync(uint32_t seconds) {
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &resync_worker, seconds * 1000);
+}
+
+static int64_t clamp_drift(int64_t ppb) {
+    if (ppb > DRIFT_MAX_PPB) return DRIFT_MAX_PPB;
+    if (ppb < -DRIFT_MAX_PPB) return -DRIFT_MAX_PPB;
+    return ppb;
+}
+
+// Asymmetric queueing shows up as offset error, so only samples close to
+// the fastest round trip seen are trusted for drift
+static bool delay_ok(uint32_t delay_us, int64_t now_local) {
+    if (min_delay_us != UINT32_MAX) {
+        int64_t aged = (now_local - last_sample_us) / 1000000 / DELAY_AGE_S;
+        min_delay_us = aged > (int64_t)(UINT32_MAX - min_delay_us) ? UINT32_MAX : min_delay_us + (uint32_t)aged;
+    }
+    last_sample_us = now_local;
+    if (delay_us < min_delay_us) min_delay_us = delay_us;
+    return delay_us <= min_delay_us + DELAY_MARGIN_US;
+}
+
+static void ntp_result_cb(const ntp_sample_t *best, void *arg) {
+    querying = false;
+    radio_release(RADIO_USER_TIME_SYNC);
+    if (!best) {
+        failures++;
+        schedule_resync(RESYNC_RETRY_S);
+        return;
+    }
+
+    // The sample's offset is relative to the raw local timer; compare it
+    // with what the disciplined model predicts for the same instant
+    int64_t now_local = (int64_t)time_us_64();
+    int64_t model_unix = 0;
+    timekeeper_now_us(&model_unix);
+    last_residual_us = (now_local + best->offset_us) - model_unix;
+
+    // Raw crystal drift over the interval, weighted by its length since the
+    // same offset error spread over a longer interval is a smaller rate
+    // error. A rejected sample leaves the reference where it was, so the
+    // next good one measures over the longer span.
+    int64_t elapsed_us = now_local - last_local_us;
+    if (!delay_ok(best->delay_us, now_local)) {
+        drift_rejects++;
+    } else if (elapsed_us > 0) {
+        int64_t measured_ppb = clamp_drift((best->offset_us - last_offset_us) * 1000000000 / elapsed_us);
+        int64_t drift = timekeeper_drift_ppb();
+        drift += (measured_ppb - drift) * elapsed_us / (elapsed_us + (int64_t)DRIFT_WEIGHT_S * 1000000);
+        timekeeper_set_drift_ppb((int32_t)clamp_drift(drift));
+        last_offset_us = best->offset_us;
+        last_local_us = now_local;
+    }
+    timekeeper_set_offset(best->offset_us);
+    sntp_server_set_upstream(&best->server, best->stratum, best->delay_us);
+    syncs++;
+
+    // Fewer network wakeups while the model holds, back off when it does not
+    int64_t residual = last_residual_us < 0 ? -last_residual_us : last_residual_us;
+    if (residual < RESIDUAL_GOOD_US && interval_s < RESYNC_MAX_S) {
+        interval_s = interval_s * 2 > RESYNC_MAX_S ? RESYNC_MAX_S : interval_s * 2;
+    } else if (residual > RESIDUAL_BAD_US && interval_s > RESYNC_MIN_S) {
+        interval_s /= 2;
+    }
+
+    printf("Resync: residual %lld us, drift %ld ppb, next in %u s\n",
+           (long long)last_residual_us, (long)timekeeper_drift_ppb(), (unsigned)interval_s);
+    schedule_resync(interval_s);
+}
+
+static void resync_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    // The radio may be asleep between syncs; hold it for the query
+    radio_request(RADIO_USER_TIME_SYNC);
+    bool link = radio_link_up();
+    if (!link) {
+        if (!waiting_link) {
+            waiting_link = true;
+            link_deadline = make_timeout_time_ms(LINK_WAIT_MS);
+        }
+        if (!time_reached(link_deadline)) {
+            async_context_add_at_time_worker_in_ms(context, worker, LINK_POLL_MS);
+            return;
+        }
+    }
+
+    waiting_link = false;
+    querying = link && ntp_client_query(servers, server_count, NTP_WAIT_MS, ntp_result_cb, NULL);
+    if (!querying) {
+        radio_release(RADIO_USER_TIME_SYNC);
+        failures++;
+        schedule_resync(RESYNC_RETRY_S);
+    }
+}
+
+// Between syncs the model carries the drift correction; pulling the RTC
+// back onto it regularly keeps the displayed seconds in phase
+static void align_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    timekeeper_align_rtc();
+    async_context_add_at_time_worker_in_ms(context, worker, RTC_ALIGN_PERIOD_MS);
+}
+
+void time_sync_start(const ip_addr_t *list, int count) {
+    if (count <= 0) return;
+    if (count > NTP_CLIENT_MAX_SERVERS) count = NTP_CLIENT_MAX_SERVERS;
+    for (int i = 0; i < count; i++) {
+        servers[i] = list[i];
+    }
+    server_count = count;
+
+    // The boot sync is the first drift reference
+    int64_t model_unix = 0;
+    timekeeper_now_us(&model_unix);
+    last_local_us = (int64_t)time_us_64();
+    last_offset_us = model_unix - last_local_us;
+    last_sample_us = last_local_us;
+
+    resync_worker.do_work = resync_worker_fn;
+    align_worker.do_work = align_worker_fn;
+    schedule_resync(interval_s);
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &align_worker, RTC_ALIGN_PERIOD_MS);
+}
+
+void time_sync_now(void) {
+    if (server_count == 0 || querying) return;
+    async_context_t *context = cyw43_arch_async_context();
+    async_context_remove_at_time_worker(context, &resync_worker);
+    async_context_add_at_time_worker_in_ms(context, &resync_worker, 0);
+}
+
+int32_t time_sync_last_residual_us(void) {
+    // 64-bit value written from the async context IRQ
+    uint32_t irq = save_and_disable_interrupts();
+    int64_t residual = last_residual_us;
+    restore_interrupts(irq);
+    if (residual > INT32_MAX) return INT32_MAX;
+    if (residual < INT32_MIN) return INT32_MIN;
+    return (int32_t)residual;
+}
+
+void time_sync_print_stats(void) {
+    if (server_count == 0) {
+        printf("Time sync: not started\n");
+        return;
+    }
+    printf("Time sync: %u syncs, %u failures, %u drift rejects, drift %ld ppb, last residual %lld us, interval %u s\n",
+           (unsigned)syncs, (unsigned)failures, (unsigned)drift_rejects, (long)timekeeper_drift_ppb(),
+           (long long)last_residual_us, (unsigned)interval_s);
+}
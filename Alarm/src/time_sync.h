@@ -0,0 +1,26 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+#include "lwip/ip_addr.h"
+
+// Background NTP resync after the boot sync. Measures the offset at
+// growing intervals (64 s up to 6 h), estimates the crystal drift and
+// feeds it to the timekeeper, and re-aligns the RTC phase every few
+// minutes in between so it stays within tens of milliseconds.
+
+// Call from the cyw43 async context once the first sync succeeded
+void time_sync_start(const ip_addr_t *servers, int count);
+
+// Resyncs right away instead of at the next interval, e.g. after a Wi-Fi
+// outage. Cyw43 async context only; no-op before time_sync_start.
+void time_sync_now(void);
+
+// Offset between NTP and the disciplined clock at the last resync, in
+// microseconds (0 before the first resync). Safe to call from the main loop.
+int32_t time_sync_last_residual_us(void);
+
+// Prints drift, interval and last residual (console key 's')
+void time_sync_print_stats(void);
+
+#endif // TIME_SYNC_H
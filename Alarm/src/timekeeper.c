@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "hardware/rtc.h"
+#include "hardware/sync.h"
+#include "pico/util/datetime.h"
+
+#include "timekeeper.h"
+
+// Model reference point, only changed with interrupts disabled since the
+// 64-bit values cannot be read atomically
+static int64_t ref_local_us = 0;
+static int64_t ref_unix_us = 0;
+static int32_t drift_ppb = 0;
+static volatile bool synced = false;
+
+// RTC value for the upcoming second, written when its alarm fires
+static datetime_t pending;
+static alarm_id_t step_alarm = 0;
+
+static int64_t model_unix_us(int64_t local_us) {
+    int64_t dt = local_us - ref_local_us;
+    return ref_unix_us + dt + dt * drift_ppb / 1000000000;
+}
+
+// Inverse of the model: local timer value at which UTC reaches unix_us
+static int64_t model_local_us(int64_t unix_us) {
+    int64_t du = unix_us - ref_unix_us;
+    return ref_local_us + du - du * drift_ppb / 1000000000;
+}
+
+// Fires on the second boundary: the RTC starts counting the new second now
+static int64_t rtc_step_cb(alarm_id_t id, void *user_data) {
+    rtc_set_datetime(&pending);
+    step_alarm = 0;
+    return 0;
+}
+
+static void schedule_rtc_step(bool verbose) {
+    uint32_t irq = save_and_disable_interrupts();
+    int64_t now_local = (int64_t)time_us_64();
+    int64_t now_unix = model_unix_us(now_local);
+    restore_interrupts(irq);
+
+    // Next whole UTC second, at least 2 ms away so the alarm can be armed
+    int64_t next_sec = now_unix / 1000000 + 1;
+    if (next_sec * 1000000 - now_unix < 2000) next_sec++;
+
+    time_t local = (time_t)(next_sec + TIMEKEEPER_UTC_OFFSET_S);
+    struct tm tm_info;
+    gmtime_r(&local, &tm_info);
+
+    if (step_alarm > 0) {
+        cancel_alarm(step_alarm);
+        step_alarm = 0;
+    }
+    pending.year = tm_info.tm_year + 1900;
+    pending.month = tm_info.tm_mon + 1;
+    pending.day = tm_info.tm_mday;
+    pending.dotw = tm_info.tm_wday;
+    pending.hour = tm_info.tm_hour;
+    pending.min = tm_info.tm_min;
+    pending.sec = tm_info.tm_sec;
+
+    irq = save_and_disable_interrupts();
+    int64_t at_us = model_local_us(next_sec * 1000000);
+    restore_interrupts(irq);
+
+    // 0 means the time had passed and rtc_step_cb already ran; only a
+    // missing alarm slot needs the step done here
+    step_alarm = add_alarm_at(from_us_since_boot((uint64_t)at_us), rtc_step_cb, NULL, true);
+    if (step_alarm < 0) {
+        step_alarm = 0;
+        rtc_step_cb(0, NULL);
+    }
+
+    if (verbose) {
+        printf("Clock set: %04d-%02d-%02d %02d:%02d:%02d (UTC%+d)\n",
+               pending.year, pending.month, pending.day, pending.hour, pending.min, pending.sec,
+               TIMEKEEPER_UTC_OFFSET_S / 3600);
+    }
+}
+
+void timekeeper_set_offset(int64_t offset_us) {
+    uint32_t irq = save_and_disable_interrupts();
+    ref_local_us = (int64_t)time_us_64();
+    ref_unix_us = ref_local_us + offset_us;
+    synced = true;
+    restore_interrupts(irq);
+
+    schedule_rtc_step(true);
+}
+
+void timekeeper_set_drift_ppb(int32_t ppb) {
+    // Rebase first so the change only affects time from now on
+    uint32_t irq = save_and_disable_interrupts();
+    int64_t now_local = (int64_t)time_us_64();
+    ref_unix_us = model_unix_us(now_local);
+    ref_local_us = now_local;
+    drift_ppb = ppb;
+    restore_interrupts(irq);
+}
+
+int32_t timekeeper_drift_ppb(void) {
+    return drift_ppb;
+}
+
+void timekeeper_align_rtc(void) {
+    if (synced) {
+        schedule_rtc_step(false);
+    }
+}
+
+bool timekeeper_now_us(int64_t *unix_us) {
+    if (!synced) return false;
+    uint32_t irq = save_and_disable_interrupts();
+    *unix_us = model_unix_us((int64_t)time_us_64());
+    restore_interrupts(irq);
+    return true;
+}
+
+bool timekeeper_unix_at(uint64_t local_us, int64_t *unix_us) {
+    if (!synced) return false;
+    uint32_t irq = save_and_disable_interrupts();
+    *unix_us = model_unix_us((int64_t)local_us);
+    restore_interrupts(irq);
+    return true;
+}
+
+bool timekeeper_local_at(int64_t unix_us, uint64_t *local_us) {
+    if (!synced) return false;
+    uint32_t irq = save_and_disable_interrupts();
+    *local_us = (uint64_t)model_local_us(unix_us);
+    restore_interrupts(irq);
+    return true;
+}
+
+bool timekeeper_synced(void) {
+    return synced;
+}
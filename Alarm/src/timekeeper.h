@@ -0,0 +1,40 @@
+#ifndef TIMEKEEPER_H
+#define TIMEKEEPER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Local time zone applied to the RTC (UTC-3)
+#define TIMEKEEPER_UTC_OFFSET_S (-3 * 3600)
+
+// UTC is modelled from the local microsecond timer:
+//   unix_us = ref_unix + (time_us_64() - ref_local) * (1 + drift_ppb / 1e9)
+// The RTC runs from the same crystal, so it is kept in phase by re-aligning
+// it to the model on whole seconds (timekeeper_align_rtc).
+
+// Sets UTC as an offset from the local timer (unix_us = time_us_64() +
+// offset_us) and steps the RTC exactly on the next second boundary.
+// Returns immediately.
+void timekeeper_set_offset(int64_t offset_us);
+
+// Rate correction for the local crystal, in parts per billion (positive =
+// the local clock runs slow)
+void timekeeper_set_drift_ppb(int32_t drift_ppb);
+int32_t timekeeper_drift_ppb(void);
+
+// Re-steps the RTC to the model on the next second boundary (sub-second
+// phase correction, the date and time are normally unchanged)
+void timekeeper_align_rtc(void);
+
+// Current UTC in microseconds since the Unix epoch; false before the
+// first sync
+bool timekeeper_now_us(int64_t *unix_us);
+
+// The model at any local timer value (a captured edge, a future alarm) and
+// its inverse; false before the first sync
+bool timekeeper_unix_at(uint64_t local_us, int64_t *unix_us);
+bool timekeeper_local_at(int64_t unix_us, uint64_t *local_us);
+
+bool timekeeper_synced(void);
+
+#endif // TIMEKEEPER_H
@@ -1,147 +1,381 @@
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
 #include "pico/stdlib.h"
 #include "pico/cyw43_arch.h"
-#include "hardware/rtc.h"
+#include "pico/async_context.h"
 
 #include "lwip/pbuf.h"
 #include "lwip/udp.h"
 #include "lwip/dns.h"
 #include "lwip/ip_addr.h"
+#include "lwip/dhcp.h"
+#include "lwip/netif.h"
 
 #include "wifi_time.h"
-#include "rtc.h"
+#include "boot.h"
+#include "flash_store.h"
+#include "ntp_client.h"
+#include "timekeeper.h"
+#include "time_sync.h"
+#include "sntp_server.h"
+#include "http_server.h"
+#include "mqtt_pub.h"
+#include "fleet.h"
+#include "ota.h"
+#include "radio.h"
+#include "link_supervisor.h"
 
 #define WIFI_SSID "NOME_DA_REDE_WIFI"
 #define WIFI_PASS "SENHA_DA_REDE_WIFI"
 
-#define NTP_SERVER "pool.ntp.org"
-#define NTP_PORT 123
-#define NTP_TIMESTAMP_DELTA 2208988800ul
+// Queried together; the answer with the lowest round-trip delay wins
+static const char *const ntp_server_names[] = {
+    "0.pool.ntp.org",
+    "1.pool.ntp.org",
+    "2.pool.ntp.org",
+};
+#define NTP_SERVER_COUNT (sizeof(ntp_server_names) / sizeof(ntp_server_names[0]))
 #define NTP_MAX_WAIT_MS 5000
 
-static volatile bool ntp_response_received = false;
-static volatile uint32_t received_ntp_seconds = 0;
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+#define DNS_TIMEOUT_MS 3000
 
+// Fast-reconnect path: join the cached BSSID/channel, reuse the cached lease
+// and NTP server address, and give up quickly so the full path still runs.
+// A WPA2 join with no scan is a few hundred ms and one NTP round trip well
+// under 100 ms, so both limits together keep a failed fast attempt under
+// one second ('b' reports the real stage times)
+#define WIFI_FAST_JOIN_TIMEOUT_MS 600
+#define NTP_FAST_WAIT_MS 300
+
+// How often the background state machine is stepped
+#define WIFI_TIME_STEP_MS 10
+
+// Last-known-good network parameters, persisted after a successful sync
 typedef struct {
-    uint8_t li_vn_mode;
-    uint8_t stratum;
-    uint8_t poll;
-    int8_t precision;
-    uint32_t root_delay;
-    uint32_t root_dispersion;
-    uint32_t ref_id;
-    uint32_t ref_timestamp[2];
-    uint32_t orig_timestamp[2];
-    uint32_t rx_timestamp[2];
-    uint32_t tx_timestamp[2];
-} ntp_packet_t;
-
-static void ntp_recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p,
-                        const ip_addr_t *addr, u16_t port) {
-    if (!p) return;
-
-    if (p->len >= sizeof(ntp_packet_t)) {
-        ntp_packet_t packet;
-        pbuf_copy_partial(p, &packet, sizeof(ntp_packet_t), 0);
-        uint32_t tx_time_seconds = ntohl(packet.tx_timestamp[0]);
-        received_ntp_seconds = tx_time_seconds - NTP_TIMESTAMP_DELTA;
-        ntp_response_received = true;
-    }
-    pbuf_free(p);
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ip;          // All addresses in network byte order
+    uint32_t netmask;
+    uint32_t gateway;
+    uint32_t dns;
+    uint32_t ntp_server;
+} wifi_cache_t;
+
+// Background bring-up states
+typedef enum {
+    WIFI_TIME_IDLE,
+    WIFI_TIME_FAST_JOIN,   // Joining the cached BSSID
+    WIFI_TIME_FAST_NTP,    // Waiting on the cached NTP server
+    WIFI_TIME_CONNECTING,  // Full scan + DHCP
+    WIFI_TIME_DNS,
+    WIFI_TIME_NTP,
+    WIFI_TIME_SYNCED,
+    WIFI_TIME_LINKED,      // Link-only reconnect done (no NTP)
+    WIFI_TIME_FAILED
+} wifi_time_state_t;
+
+// Everything below runs inside the cyw43 async context (lwIP lock held),
+// so the state machine, DNS and UDP callbacks never race each other.
+static wifi_time_state_t state = WIFI_TIME_IDLE;
+static absolute_time_t state_deadline;
+static async_at_time_worker_t step_worker;
+
+static ip_addr_t ntp_server_ip;      // Server of the accepted sample
+static ip_addr_t ntp_servers[NTP_SERVER_COUNT];
+static int dns_pending = 0;
+static int dns_resolved = 0;
+static uint32_t dns_generation = 0;  // Tells late answers of an earlier lookup apart
+static bool ntp_done = false;
+static bool ntp_ok = false;
+static wifi_cache_t cache;
+static bool cache_valid = false;
+static wifi_cache_t cache_fresh;     // Waiting for wifi_time_poll() to write it
+static volatile bool cache_dirty = false;
+static bool link_only = false;       // wifi_time_reconnect(): stop once the link is up
+static bool synced = false;
+static bool booting = true;          // Boot stages are only timed for the first run
+
+static void set_state(wifi_time_state_t next, uint32_t timeout_ms) {
+    state = next;
+    state_deadline = make_timeout_time_ms(timeout_ms);
 }
 
-static bool get_ntp_time_manually(void) {
-    struct udp_pcb *ntp_pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
-    if (!ntp_pcb) {
-        printf("Failed to create UDP PCB\n");
-        return false;
+// -------------------------------------------------------------------------
+// NTP
+// -------------------------------------------------------------------------
+
+static void ntp_done_cb(const ntp_sample_t *best, void *arg) {
+    ntp_done = true;
+    ntp_ok = (best != NULL);
+    if (best) {
+        ntp_server_ip = best->server;
+        timekeeper_set_offset(best->offset_us);
+        sntp_server_set_upstream(&best->server, best->stratum, best->delay_us);
     }
+}
 
-    if (udp_bind(ntp_pcb, IP_ANY_TYPE, 0) != ERR_OK) {
-        printf("Failed to bind UDP PCB\n");
-        udp_remove(ntp_pcb);
-        return false;
+static bool ntp_start(const ip_addr_t *servers, int count, uint32_t timeout_ms) {
+    ntp_done = false;
+    ntp_ok = false;
+    return ntp_client_query(servers, count, timeout_ms, ntp_done_cb, NULL);
+}
+
+static void ntp_dns_cb(const char *name, const ip_addr_t *addr, void *arg) {
+    // An answer that arrives after the DNS wait gave up, or for an earlier
+    // lookup, must not touch the server list the NTP query is using
+    if ((uint32_t)(uintptr_t)arg != dns_generation || state != WIFI_TIME_DNS) return;
+    if (addr && dns_resolved < (int)NTP_SERVER_COUNT) {
+        ntp_servers[dns_resolved++] = *addr;
     }
+    dns_pending--;
+}
 
-    udp_recv(ntp_pcb, ntp_recv_cb, NULL);
-
-    ip_addr_t ntp_server_ip;
-    err_t err = dns_gethostbyname(NTP_SERVER, &ntp_server_ip, NULL, NULL);
-    if (err == ERR_INPROGRESS) {
-        absolute_time_t dns_timeout = make_timeout_time_ms(3000);
-        while (!time_reached(dns_timeout)) {
-            err = dns_gethostbyname(NTP_SERVER, &ntp_server_ip, NULL, NULL);
-            if (err == ERR_OK || err != ERR_INPROGRESS) break;
-            cyw43_arch_poll();
-            sleep_ms(50);
+// Starts all lookups; cached names resolve immediately
+static void ntp_resolve_servers(void) {
+    dns_pending = 0;
+    dns_resolved = 0;
+    dns_generation++;
+    for (uint i = 0; i < NTP_SERVER_COUNT; i++) {
+        ip_addr_t addr;
+        err_t err = dns_gethostbyname(ntp_server_names[i], &addr, ntp_dns_cb,
+                                      (void *)(uintptr_t)dns_generation);
+        if (err == ERR_OK) {
+            ntp_servers[dns_resolved++] = addr;
+        } else if (err == ERR_INPROGRESS) {
+            dns_pending++;
         }
     }
+}
 
-    if (err != ERR_OK) {
-        printf("DNS lookup failed for %s\n", NTP_SERVER);
-        udp_remove(ntp_pcb);
-        return false;
+// -------------------------------------------------------------------------
+// Fast reconnect cache
+// -------------------------------------------------------------------------
+
+static uint8_t wifi_current_channel(void) {
+    uint8_t buf[12] = {0}; // channel_info_t: hw_channel, target_channel, scan_channel
+    if (cyw43_ioctl(&cyw43_state, CYW43_IOCTL_GET_CHANNEL, sizeof(buf), buf, CYW43_ITF_STA) != 0) {
+        return 0;
     }
+    return buf[0];
+}
+
+// Captures the parameters here; the flash write (a sector erase with IRQs
+// off) is left to wifi_time_poll() on the main loop, outside the async context
+static void wifi_cache_store(void) {
+    struct netif *n = &cyw43_state.netif[CYW43_ITF_STA];
+    wifi_cache_t fresh = {0};
+
+    if (cyw43_wifi_get_bssid(&cyw43_state, fresh.bssid) != 0) return;
+    fresh.channel = wifi_current_channel();
+    fresh.ip = ip4_addr_get_u32(netif_ip4_addr(n));
+    fresh.netmask = ip4_addr_get_u32(netif_ip4_netmask(n));
+    fresh.gateway = ip4_addr_get_u32(netif_ip4_gw(n));
+    fresh.dns = ip4_addr_get_u32(ip_2_ip4(dns_getserver(0)));
+    fresh.ntp_server = ip4_addr_get_u32(ip_2_ip4(&ntp_server_ip));
+
+    cache_fresh = fresh;
+    cache_dirty = true;
+}
 
-    ntp_packet_t packet = {0};
-    packet.li_vn_mode = 0x1B;
+// Joins the cached BSSID on its cached channel, skipping the scan
+static bool wifi_fast_join(void) {
+    uint32_t channel = cache.channel ? cache.channel : CYW43_CHANNEL_NONE;
 
-    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, sizeof(ntp_packet_t), PBUF_RAM);
-    if (!p) {
-        printf("Failed to allocate pbuf for NTP request\n");
-        udp_remove(ntp_pcb);
-        return false;
+    printf("Fast reconnect to cached AP (channel %d)\n", cache.channel);
+    return cyw43_wifi_join(&cyw43_state, strlen(WIFI_SSID), (const uint8_t *)WIFI_SSID,
+                           strlen(WIFI_PASS), (const uint8_t *)WIFI_PASS,
+                           CYW43_AUTH_WPA2_AES_PSK, cache.bssid, channel) == 0;
+}
+
+// Uses the cached lease right away instead of waiting for DHCP. DHCP keeps
+// running underneath and takes over the address when it binds, so the lease
+// is renewed as usual and a changed address replaces the cached one.
+static void wifi_fast_apply_lease(void) {
+    struct netif *n = &cyw43_state.netif[CYW43_ITF_STA];
+    ip4_addr_t ip, netmask, gateway, dns;
+
+    ip4_addr_set_u32(&ip, cache.ip);
+    ip4_addr_set_u32(&netmask, cache.netmask);
+    ip4_addr_set_u32(&gateway, cache.gateway);
+    ip4_addr_set_u32(&dns, cache.dns);
+
+    netif_set_addr(n, &ip, &netmask, &gateway);
+    dns_setserver(0, &dns);
+}
+
+// Undoes a failed fast reconnect so the normal scan + DHCP path starts clean
+static void wifi_fast_abort(void) {
+    struct netif *n = &cyw43_state.netif[CYW43_ITF_STA];
+
+    printf("Fast reconnect failed, falling back to full connect\n");
+    cyw43_wifi_leave(&cyw43_state, CYW43_ITF_STA);
+    netif_set_addr(n, IP4_ADDR_ANY4, IP4_ADDR_ANY4, IP4_ADDR_ANY4);
+    dhcp_start(n);
+}
+
+// -------------------------------------------------------------------------
+// Background state machine
+// -------------------------------------------------------------------------
+
+// The boot connect is over, whatever its outcome: hand the link over
+static void boot_done(void) {
+    booting = false;
+    radio_start();
+    link_supervisor_start();
+}
+
+static void start_full_connect(void) {
+    printf("Connecting to Wi-Fi: %s\n", WIFI_SSID);
+    int err = cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASS, CYW43_AUTH_WPA2_AES_PSK);
+    if (err) {
+        printf("Failed to start connect. Status=%d\n", err);
+        set_state(WIFI_TIME_FAILED, 0);
+        if (booting) boot_done();
+        return;
     }
+    set_state(WIFI_TIME_CONNECTING, WIFI_CONNECT_TIMEOUT_MS);
+}
 
-    pbuf_take(p, &packet, sizeof(packet));
-    err_t send_err = udp_sendto(ntp_pcb, p, &ntp_server_ip, NTP_PORT);
-    pbuf_free(p);
-    if (send_err != ERR_OK) {
-        printf("Failed to send NTP request\n");
-        udp_remove(ntp_pcb);
-        return false;
+static void finish(bool ok) {
+    ntp_client_cancel();
+    if (booting) boot_stage_end(BOOT_STAGE_NTP_SYNC);
+    if (ok) {
+        printf("NTP sync successful.\n");
+        set_state(WIFI_TIME_SYNCED, 0);
+        synced = true;
+        // Keep resyncing against the servers we found (or the cached one)
+        if (dns_resolved > 0) {
+            time_sync_start(ntp_servers, dns_resolved);
+        } else {
+            time_sync_start(&ntp_server_ip, 1);
+        }
+#if ALARM_SNTP_SERVER
+        sntp_server_start(); // Serve the LAN from our disciplined clock
+#endif
+    } else {
+        printf("NTP sync failed.\n");
+        set_state(WIFI_TIME_FAILED, 0);
     }
+    if (booting) boot_done();
+}
 
-    ntp_response_received = false;
-    received_ntp_seconds = 0;
-    absolute_time_t timeout = make_timeout_time_ms(NTP_MAX_WAIT_MS);
+// End of a link-only run; the radio manager polls the link itself
+static void finish_link(bool up) {
+    if (!up) printf("Wi-Fi reconnect failed\n");
+    set_state(up ? WIFI_TIME_LINKED : WIFI_TIME_FAILED, 0);
+}
 
-    while (!time_reached(timeout)) {
-        if (ntp_response_received) break;
-        cyw43_arch_poll();
-        sleep_ms(10);
-    }
+static void wifi_time_step(void) {
+    bool expired = time_reached(state_deadline);
 
-    udp_remove(ntp_pcb);
+    switch (state) {
+        case WIFI_TIME_FAST_JOIN: {
+            int link = cyw43_wifi_link_status(&cyw43_state, CYW43_ITF_STA);
+            if (link == CYW43_LINK_JOIN && link_only) {
+                // DHCP restarted with the interface; the cached lease may be stale
+                set_state(WIFI_TIME_CONNECTING, WIFI_CONNECT_TIMEOUT_MS);
+                break;
+            } else if (link == CYW43_LINK_JOIN) {
+                wifi_fast_apply_lease();
+                if (booting) {
+                    boot_stage_end(BOOT_STAGE_WIFI_CONNECT);
+                    boot_stage_begin(BOOT_STAGE_NTP_SYNC);
+                }
+                ip4_addr_set_u32(ip_2_ip4(&ntp_server_ip), cache.ntp_server);
+                if (ntp_start(&ntp_server_ip, 1, NTP_FAST_WAIT_MS)) {
+                    set_state(WIFI_TIME_FAST_NTP, NTP_FAST_WAIT_MS + WIFI_TIME_STEP_MS);
+                    break;
+                }
+            } else if (link >= 0 && !expired) {
+                break;
+            }
+            wifi_fast_abort();
+            if (booting) boot_stage_begin(BOOT_STAGE_WIFI_CONNECT);
+            start_full_connect();
+            break;
+        }
 
-    if (!ntp_response_received) {
-        printf("NTP response not received (timeout)\n");
-        return false;
-    }
+        case WIFI_TIME_FAST_NTP:
+            if (ntp_done && ntp_ok) {
+                printf("Synced via fast reconnect\n");
+                finish(true);
+            } else if (ntp_done || expired) {
+                ntp_client_cancel();
+                wifi_fast_abort();
+                if (booting) boot_stage_begin(BOOT_STAGE_WIFI_CONNECT);
+                start_full_connect();
+            }
+            break;
+
+        case WIFI_TIME_CONNECTING: {
+            int link = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+            if (link == CYW43_LINK_UP) {
+                uint8_t *ip = (uint8_t *)&cyw43_state.netif[CYW43_ITF_STA].ip_addr.addr;
+                printf("Connected! IP = %d.%d.%d.%d\n", ip[0], ip[1], ip[2], ip[3]);
+                if (link_only) {
+                    finish_link(true);
+                    break;
+                }
+                if (booting) {
+                    boot_stage_end(BOOT_STAGE_WIFI_CONNECT);
+                    boot_stage_begin(BOOT_STAGE_NTP_SYNC);
+                }
 
-    time_t t = (time_t)received_ntp_seconds;
-    t -= 3 * 3600;
-    struct tm *tm_info = gmtime(&t);
+                ntp_resolve_servers();
+                set_state(WIFI_TIME_DNS, DNS_TIMEOUT_MS);
+            } else if (link < 0 || expired) {
+                printf("Failed to connect. Status=%d\n", link);
+                if (link_only) {
+                    finish_link(false);
+                    break;
+                }
+                set_state(WIFI_TIME_FAILED, 0);
+                if (booting) {
+                    boot_stage_end(BOOT_STAGE_WIFI_CONNECT);
+                    boot_done();
+                }
+            }
+            break;
+        }
 
-    rtc_set_time(
-        tm_info->tm_year + 1900,
-        tm_info->tm_mon + 1,
-        tm_info->tm_mday,
-        tm_info->tm_hour,
-        tm_info->tm_min,
-        tm_info->tm_sec
-    );
+        case WIFI_TIME_DNS:
+            // Go as soon as every lookup is back, or with what we have
+            if (dns_pending > 0 && !expired) break;
+            if (dns_resolved == 0) {
+                printf("DNS lookup failed for all NTP servers\n");
+                finish(false);
+            } else if (ntp_start(ntp_servers, dns_resolved, NTP_MAX_WAIT_MS)) {
+                set_state(WIFI_TIME_NTP, NTP_MAX_WAIT_MS + WIFI_TIME_STEP_MS);
+            } else {
+                finish(false);
+            }
+            break;
 
-    printf("Time set via NTP: %04d-%02d-%02d %02d:%02d:%02d UTC\n",
-           tm_info->tm_year + 1900, tm_info->tm_mon + 1, tm_info->tm_mday,
-           tm_info->tm_hour, tm_info->tm_min, tm_info->tm_sec);
+        case WIFI_TIME_NTP:
+            if (ntp_done && ntp_ok) {
+                wifi_cache_store();
+                finish(true);
+            } else if (ntp_done || expired) {
+                printf("NTP response not received (timeout)\n");
+                finish(false);
+            }
+            break;
 
-    return true;
+        default:
+            break;
+    }
 }
 
-void wifi_time_init(void) {
+static void step_worker_fn(async_context_t *context, async_at_time_worker_t *worker) {
+    wifi_time_step();
+    if (state != WIFI_TIME_SYNCED && state != WIFI_TIME_LINKED && state != WIFI_TIME_FAILED) {
+        async_context_add_at_time_worker_in_ms(context, worker, WIFI_TIME_STEP_MS);
+    }
+}
+
+void wifi_time_start(void) {
     if (cyw43_arch_init()) {
         printf("Failed to initialize Wi-Fi\n");
         return;
@@ -149,21 +383,76 @@ void wifi_time_init(void) {
 
     cyw43_arch_enable_sta_mode();
 
-    printf("Connecting to Wi-Fi: %s\n", WIFI_SSID);
-    int connect_status = cyw43_arch_wifi_connect_timeout_ms(
-        WIFI_SSID, WIFI_PASS, CYW43_AUTH_WPA2_AES_PSK, 10000);
+    cyw43_arch_lwip_begin();
+#if ALARM_HTTP_SERVER
+    http_server_start(); // Listens on any address, so it is up as soon as we get a lease
+#endif
+    mqtt_pub_start();    // Waits for the link itself; no-op without a broker
+    fleet_start();       // Group membership is reported when the link comes up
+#if ALARM_OTA
+    ota_start();
+#endif
+    boot_stage_begin(BOOT_STAGE_WIFI_CONNECT);
+    cache_valid = flash_store_load(FLASH_STORE_WIFI_CACHE, &cache, sizeof(cache));
+    if (cache_valid && wifi_fast_join()) {
+        set_state(WIFI_TIME_FAST_JOIN, WIFI_FAST_JOIN_TIMEOUT_MS);
+    } else {
+        start_full_connect();
+    }
+    cyw43_arch_lwip_end();
 
-    if (connect_status) {
-        printf("Failed to connect. Status=%d\n", connect_status);
-        return;
+    step_worker.do_work = step_worker_fn;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &step_worker, WIFI_TIME_STEP_MS);
+}
+
+void wifi_time_poll(void) {
+    if (!cache_dirty) return;
+
+    cyw43_arch_lwip_begin();
+    wifi_cache_t fresh = cache_fresh;
+    cache_dirty = false;
+    cyw43_arch_lwip_end();
+
+    if (flash_store_save(FLASH_STORE_WIFI_CACHE, &fresh, sizeof(fresh))) {
+        printf("Wi-Fi cache saved (channel %d)\n", fresh.channel);
     }
+}
 
-    uint8_t *ip = (uint8_t*)&cyw43_state.netif[0].ip_addr.addr;
-    printf("Connected! IP = %d.%d.%d.%d\n", ip[0], ip[1], ip[2], ip[3]);
+bool wifi_time_synced(void) {
+    return synced;
+}
 
-    if (!get_ntp_time_manually()) {
-        printf("NTP sync failed.\n");
+bool wifi_time_busy(void) {
+    return state != WIFI_TIME_IDLE && state != WIFI_TIME_SYNCED && state != WIFI_TIME_LINKED &&
+           state != WIFI_TIME_FAILED;
+}
+
+bool wifi_time_reconnect(void) {
+    if (wifi_time_busy()) return true; // Boot connect or an earlier reconnect still running
+
+    link_only = true;
+    if (cache_valid && wifi_fast_join()) {
+        set_state(WIFI_TIME_FAST_JOIN, WIFI_FAST_JOIN_TIMEOUT_MS);
     } else {
-        printf("NTP sync successful.\n");
+        start_full_connect();
     }
+    if (state == WIFI_TIME_FAILED) return false;
+
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &step_worker, WIFI_TIME_STEP_MS);
+    return true;
+}
+
+bool wifi_time_resync(void) {
+    if (wifi_time_busy() || synced || !wifi_time_link_up()) return false;
+
+    printf("Retrying NTP sync\n");
+    link_only = false;
+    ntp_resolve_servers();
+    set_state(WIFI_TIME_DNS, DNS_TIMEOUT_MS);
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &step_worker, WIFI_TIME_STEP_MS);
+    return true;
+}
+
+bool wifi_time_link_up(void) {
+    return cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) == CYW43_LINK_UP;
 }
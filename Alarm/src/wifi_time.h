@@ -5,7 +5,33 @@
 extern "C" {
 #endif
 
-void wifi_time_init(void);
+#include <stdbool.h>
+
+// Initialises the CYW43 chip and starts Wi-Fi association and NTP sync in
+// the background (cyw43 async context). Returns once the chip is up.
+void wifi_time_start(void);
+
+// Writes the fast-reconnect cache to flash once a full connect has
+// refreshed it. Call from the main loop, never from the async context.
+void wifi_time_poll(void);
+
+// True once the RTC has been set from NTP
+bool wifi_time_synced(void);
+
+// Brings the link back up without the NTP part (fast join on the cached
+// BSSID, then DHCP, else a full connect). Call from the cyw43 async
+// context after the interface was re-enabled; false if it could not start.
+bool wifi_time_reconnect(void);
+
+// Boot sync never succeeded: runs DNS + NTP again on the current link and
+// starts time_sync if it works. False if it could not start.
+bool wifi_time_resync(void);
+
+// A connect, reconnect or sync is in progress
+bool wifi_time_busy(void);
+
+// Associated and has an address
+bool wifi_time_link_up(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""Discover alarm clocks on the local network and push settings to all of them.
+
+The wire format is described in src/fleet.h.
+
+  fleet_push.py discover
+  fleet_push.py push --alarm 06:30 --ringtone 2 [--target ID ...]
+  fleet_push.py push --alarm 07:00 --alarm-off --brightness 4
+  fleet_push.py emulate [--count 3]
+
+push first discovers the site, then multicasts one CONFIG datagram and
+resends the same sequence number to whoever has not acked yet. Resends are
+harmless: a device that already applied the batch acks it as a duplicate.
+The sequence number defaults to the current Unix time, or to one past the
+newest seq a device announced if that is higher, so two pushes within the
+same second both apply. A device that already announced this seq or a
+newer one before the push (an old --seq, say) would ignore the batch; it
+is reported as stale and push exits non-zero.
+
+emulate runs fake devices on this host, so the tool can be tried out
+without hardware (multicast loopback must be enabled, which is the Linux
+default).
+"""
+
+import argparse
+import os
+import socket
+import struct
+import sys
+import time
+import zlib
+
+GROUP = "239.255.42.99"
+PORT = 4242
+MAGIC = b"ALRM"
+VERSION = 1
+
+DISCOVER, ANNOUNCE, CONFIG, ACK = 1, 2, 3, 4
+TLV_ALARM, TLV_RINGTONE, TLV_COLOR, TLV_BRIGHTNESS = 1, 2, 3, 4
+ACK_STATUS = {0: "applied", 1: "duplicate", 2: "invalid"}
+
+HEADER = struct.Struct(">4sBBHI8sH")
+
+
+def newer(a, b):
+    """True if seq a is after seq b, in serial arithmetic like the firmware"""
+    return 0 < (a - b) & 0xFFFFFFFF < 0x80000000
+
+
+def pack(msg_type, seq, payload, device_id=bytes(8)):
+    data = HEADER.pack(MAGIC, VERSION, msg_type, 0, seq, device_id, len(payload)) + payload
+    return data + struct.pack(">I", zlib.crc32(data))
+
+
+def unpack(data):
+    """(type, seq, device id, payload), or None if the datagram is not valid"""
+    if len(data) < HEADER.size + 4:
+        return None
+    magic, version, msg_type, _, seq, device_id, length = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or HEADER.size + length + 4 != len(data):
+        return None
+    if zlib.crc32(data[:-4]) != struct.unpack(">I", data[-4:])[0]:
+        return None
+    return msg_type, seq, device_id, data[HEADER.size:-4]
+
+
+def parse_tlvs(data):
+    settings = {}
+    i = 0
+    while i + 2 <= len(data):
+        t, n = data[i], data[i + 1]
+        v = data[i + 2:i + 2 + n]
+        i += 2 + n
+        if t == TLV_ALARM and n == 3:
+            settings["alarm"] = f"{v[0]:02d}:{v[1]:02d}" + ("" if v[2] else " (off)")
+        elif t == TLV_RINGTONE and n == 1:
+            settings["ringtone"] = v[0]
+        elif t == TLV_COLOR and n == 1:
+            settings["color"] = v[0]
+        elif t == TLV_BRIGHTNESS and n == 1:
+            settings["brightness"] = v[0]
+    return settings
+
+
+def make_socket(iface, bind_port=0, join=False):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(iface))
+    s.bind(("", bind_port))
+    if join:
+        mreq = socket.inet_aton(GROUP) + socket.inet_aton(iface)
+        s.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    return s
+
+
+def receive(sock, until, want_type):
+    """Yields (addr, seq, device id, payload) until the deadline"""
+    while True:
+        left = until - time.monotonic()
+        if left <= 0:
+            return
+        sock.settimeout(left)
+        try:
+            data, addr = sock.recvfrom(2048)
+        except socket.timeout:
+            return
+        msg = unpack(data)
+        if msg and msg[0] == want_type:
+            yield addr, msg[1], msg[2], msg[3]
+
+
+def discover(sock, wait):
+    sock.sendto(pack(DISCOVER, 0, b""), (GROUP, PORT))
+    devices = {}
+    for addr, _, device_id, payload in receive(sock, time.monotonic() + wait, ANNOUNCE):
+        if len(payload) < 9:
+            continue
+        uptime, flags, seq = struct.unpack_from(">IBI", payload)
+        devices[device_id.hex().upper()] = {
+            "ip": addr[0], "uptime_s": uptime, "synced": bool(flags & 1), "config_seq": seq,
+            **parse_tlvs(payload[9:]),
+        }
+    return devices
+
+
+def cmd_discover(args):
+    sock = make_socket(args.iface)
+    devices = discover(sock, args.wait)
+    for device_id, d in sorted(devices.items()):
+        print(f"{device_id}  {d['ip']:<15}  up {d['uptime_s']:>7} s  "
+              f"{'synced' if d['synced'] else 'unsynced':<8}  seq {d['config_seq']:<10}  "
+              f"alarm {d.get('alarm', '?')}  ringtone {d.get('ringtone', '?')}  "
+              f"color {d.get('color', '?')}  brightness {d.get('brightness', '?')}")
+    print(f"{len(devices)} device(s)")
+    return 0
+
+
+def build_config(args):
+    tlvs = b""
+    if args.alarm:
+        hour, minute = map(int, args.alarm.split(":"))
+        tlvs += bytes([TLV_ALARM, 3, hour, minute, 0 if args.alarm_off else 1])
+    for tlv, value in ((TLV_RINGTONE, args.ringtone), (TLV_COLOR, args.color),
+                       (TLV_BRIGHTNESS, args.brightness)):
+        if value is not None:
+            tlvs += bytes([tlv, 1, value])
+    targets = [bytes.fromhex(t) for t in args.target]
+    return bytes([len(targets)]) + b"".join(targets) + tlvs
+
+
+def cmd_push(args):
+    if args.alarm_off and not args.alarm:
+        sys.exit("--alarm-off needs --alarm HH:MM (the alarm time is sent with it)")
+    payload = build_config(args)
+    if len(payload) <= 1 + 8 * len(args.target):
+        sys.exit("nothing to push")
+
+    sock = make_socket(args.iface)
+    devices = discover(sock, args.wait)
+    expected = set(devices)
+    if args.target:
+        expected &= {t.upper() for t in args.target}
+    seq = args.seq
+    if seq is None:
+        seq = int(time.time()) & 0xFFFFFFFF
+        for d in devices.values():
+            if not newer(seq, d["config_seq"]):
+                seq = (d["config_seq"] + 1) & 0xFFFFFFFF
+    # Already at or past seq before anything was sent: a duplicate ack from
+    # these means the batch was ignored, not that a resend was
+    stale = {i for i in expected if not newer(seq, devices[i]["config_seq"])}
+    print(f"pushing seq {seq} to {len(expected) if expected else 'all'} device(s)")
+
+    acks = {}
+    packet = pack(CONFIG, seq, payload)
+    for attempt in range(args.retries):
+        sock.sendto(packet, (GROUP, PORT))
+        for addr, ack_seq, device_id, body in receive(sock, time.monotonic() + args.wait, ACK):
+            if ack_seq == seq and len(body) >= 2:
+                device_id = device_id.hex().upper()
+                status = ACK_STATUS.get(body[0], body[0])
+                if status == "duplicate" and device_id in stale:
+                    status = f"stale (already at seq {devices[device_id]['config_seq']})"
+                acks[device_id] = (addr[0], status, body[1])
+        if expected and expected <= set(acks):
+            break
+
+    for device_id, (ip, status, applied) in sorted(acks.items()):
+        print(f"{device_id}  {ip:<15}  {status} ({applied} settings)")
+    missing = expected - set(acks)
+    for device_id in sorted(missing):
+        print(f"{device_id}  no ack")
+    bad = [a for a in acks.values() if a[1] == "invalid" or a[1].startswith("stale")]
+    return 1 if missing or bad else 0
+
+
+def cmd_emulate(args):
+    """Fake devices that follow the firmware's rules, for testing the tool"""
+    sock = make_socket(args.iface, PORT, join=True)
+    devices = [{"id": os.urandom(8), "seq": None,
+                "settings": bytes([TLV_ALARM, 3, 12, 0, 0, TLV_RINGTONE, 1, 0,
+                                   TLV_COLOR, 1, 0, TLV_BRIGHTNESS, 1, 10])}
+               for _ in range(args.count)]
+    start = time.monotonic()
+    print(f"emulating {args.count} device(s) on {GROUP}:{PORT}, Ctrl-C to stop")
+    while True:
+        data, addr = sock.recvfrom(2048)
+        msg = unpack(data)
+        if not msg:
+            continue
+        msg_type, seq, _, payload = msg
+        for d in devices:
+            if msg_type == DISCOVER:
+                body = struct.pack(">IBI", int(time.monotonic() - start), 1, d["seq"] or 0) + d["settings"]
+                sock.sendto(pack(ANNOUNCE, 0, body, d["id"]), addr)
+            elif msg_type == CONFIG:
+                n = payload[0]
+                targets = [payload[1 + 8 * i:9 + 8 * i] for i in range(n)]
+                if targets and d["id"] not in targets:
+                    continue
+                diff = (seq - d["seq"]) & 0xFFFFFFFF if d["seq"] is not None else 1
+                if diff == 0 or diff >= 0x80000000:  # Not newer, as in serial arithmetic
+                    status, applied = 1, 0
+                else:
+                    tlvs = parse_tlvs(payload[1 + 8 * n:])
+                    d["seq"] = seq
+                    status, applied = 0, len(tlvs)
+                    print(f"{d['id'].hex().upper()}: applied seq {seq} {tlvs}")
+                sock.sendto(pack(ACK, seq, bytes([status, applied]), d["id"]), addr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--iface", default="0.0.0.0", help="local IPv4 address of the interface to use")
+    parser.add_argument("--wait", type=float, default=1.0, help="seconds to collect answers")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    sub.add_parser("discover", help="list devices")
+
+    push = sub.add_parser("push", help="send settings to every (or selected) device")
+    push.add_argument("--alarm", metavar="HH:MM")
+    push.add_argument("--alarm-off", action="store_true", help="send the alarm disabled")
+    push.add_argument("--ringtone", type=int)
+    push.add_argument("--color", type=int)
+    push.add_argument("--brightness", type=int)
+    push.add_argument("--target", action="append", default=[], metavar="ID",
+                      help="device id from discover (repeatable); default is every device")
+    push.add_argument("--seq", type=int, help="batch sequence number (default: Unix time, or past the newest seq seen)")
+    push.add_argument("--retries", type=int, default=3)
+
+    emulate = sub.add_parser("emulate", help="run fake devices on this host")
+    emulate.add_argument("--count", type=int, default=3)
+
+    args = parser.parse_args()
+    handler = {"discover": cmd_discover, "push": cmd_push, "emulate": cmd_emulate}[args.command]
+    try:
+        sys.exit(handler(args))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""Generate the LED gamma/brightness lookup table for led_fx.c.
+
+led_level_lut[b][v] is the gamma-corrected output for linear input v at
+brightness step b, in 8.8 fixed point. The fractional byte feeds the
+temporal dithering, so fades stay smooth near black.
+
+usage: gen_led_lut.py --gamma 2.6 --levels 11 --out-dir DIR
+"""
+
+import argparse
+import os
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--gamma", type=float, default=2.6)
+    parser.add_argument("--levels", type=int, default=11)
+    parser.add_argument("--out-dir", required=True)
+    args = parser.parse_args()
+
+    top = args.levels - 1
+    os.makedirs(args.out_dir, exist_ok=True)
+    with open(os.path.join(args.out_dir, "led_lut.h"), "w") as h:
+        h.write(f"""// Generated by tools/gen_led_lut.py - do not edit
+#ifndef LED_LUT_H
+#define LED_LUT_H
+
+#include <stdint.h>
+
+#define LED_GAMMA_X10 {round(args.gamma * 10)}
+#define LED_BRIGHTNESS_MAX {top}
+
+// [brightness][linear 0-255] -> output in 8.8 fixed point
+extern const uint16_t led_level_lut[LED_BRIGHTNESS_MAX + 1][256];
+
+#endif // LED_LUT_H
+""")
+
+    with open(os.path.join(args.out_dir, "led_lut.c"), "w") as c:
+        c.write("// Generated by tools/gen_led_lut.py - do not edit\n")
+        c.write('#include "led_lut.h"\n\n')
+        c.write("const uint16_t led_level_lut[LED_BRIGHTNESS_MAX + 1][256] = {\n")
+        for b in range(args.levels):
+            scale = b / top if top else 1.0
+            values = [round(255 * 256 * ((v / 255) * scale) ** args.gamma) for v in range(256)]
+            c.write("    {\n")
+            for i in range(0, 256, 16):
+                c.write("        " + ", ".join(str(x) for x in values[i:i + 16]) + ",\n")
+            c.write("    },\n")
+        c.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
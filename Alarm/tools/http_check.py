@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Exercise the alarm's HTTP API and web UI from a host on the same LAN.
+
+Checks the gzipped index page and its ETag revalidation, reads time and
+health, round-trips the alarm and ringtone settings (restoring them
+afterwards), rejects bad input, and fires several requests at once to see
+the connection pool cope.
+
+usage: http_check.py 192.168.0.42 [--parallel 8]
+"""
+
+import argparse
+import concurrent.futures
+import gzip
+import http.client
+import json
+import sys
+
+failures = 0
+
+
+def check(cond, what):
+    global failures
+    print(("ok   " if cond else "FAIL ") + what)
+    if not cond:
+        failures += 1
+
+
+def request(host, method, path, body=None, headers=None):
+    conn = http.client.HTTPConnection(host, 80, timeout=5)
+    conn.request(method, path, body=json.dumps(body) if body is not None else None,
+                 headers=headers or {})
+    res = conn.getresponse()
+    data = res.read()
+    conn.close()
+    return res, data
+
+
+def api(host, method, path, body=None):
+    res, data = request(host, method, path, body)
+    return res.status, json.loads(data) if data else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--parallel", type=int, default=8)
+    args = parser.parse_args()
+    host = args.host
+
+    res, data = request(host, "GET", "/", headers={"Accept-Encoding": "gzip"})
+    check(res.status == 200, "GET / -> 200")
+    check(res.getheader("Content-Encoding") == "gzip", "index is gzipped")
+    check(b"<html" in gzip.decompress(data), "index decompresses to HTML")
+    etag = res.getheader("ETag")
+    res, _ = request(host, "GET", "/", headers={"If-None-Match": etag})
+    check(res.status == 304, "If-None-Match -> 304")
+    res, _ = request(host, "GET", "/missing")
+    check(res.status == 404, "unknown path -> 404")
+
+    status, t = api(host, "GET", "/api/time")
+    check(status == 200 and "local" in t, f"GET /api/time {t}")
+    status, h = api(host, "GET", "/api/health")
+    check(status == 200 and "uptime_s" in h, f"GET /api/health {h}")
+
+    status, saved_alarm = api(host, "GET", "/api/alarm")
+    check(status == 200, f"GET /api/alarm {saved_alarm}")
+    status, a = api(host, "PUT", "/api/alarm", {"hour": 6, "minute": 45, "enabled": True})
+    check(status == 200 and a == {"hour": 6, "minute": 45, "enabled": True}, f"PUT /api/alarm {a}")
+    status, a = api(host, "PUT", "/api/alarm", {"minute": 30})
+    check(status == 200 and a["hour"] == 6 and a["minute"] == 30, "partial PUT keeps other fields")
+    status, _ = api(host, "PUT", "/api/alarm", {"hour": 24})
+    check(status == 400, "hour 24 -> 400")
+    status, _ = api(host, "DELETE", "/api/alarm")
+    check(status == 405, "DELETE -> 405")
+    api(host, "PUT", "/api/alarm", saved_alarm)
+
+    status, r = api(host, "GET", "/api/ringtone")
+    check(status == 200 and r["options"], f"GET /api/ringtone {r}")
+    last = len(r["options"]) - 1
+    status, r2 = api(host, "PUT", "/api/ringtone", {"selected": last})
+    check(status == 200 and r2["selected"] == last, "PUT /api/ringtone")
+    status, _ = api(host, "PUT", "/api/ringtone", {"selected": last + 1})
+    check(status == 400, "ringtone out of range -> 400")
+    api(host, "PUT", "/api/ringtone", {"selected": r["selected"]})
+
+    # More clients than pool slots: extra connections are reset, the rest
+    # must still be answered correctly
+    def fetch(_):
+        try:
+            res, data = request(host, "GET", "/", headers={"Accept-Encoding": "gzip"})
+            return res.status == 200 and b"<html" in gzip.decompress(data)
+        except (OSError, http.client.HTTPException):
+            return None
+
+    with concurrent.futures.ThreadPoolExecutor(args.parallel) as pool:
+        results = list(pool.map(fetch, range(args.parallel)))
+    served = results.count(True)
+    check(results.count(False) == 0 and served > 0,
+          f"{args.parallel} parallel GETs: {served} served, {results.count(None)} refused")
+
+    print(f"{failures} failure(s)")
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Send a firmware image to an alarm clock over the network.
+
+The protocol is described in src/ota.h. The firmware must be built with
+-DALARM_OTA=ON, and --key must match its ALARM_OTA_KEY (leave it out for a
+firmware built without a key).
+
+  ota_send.py send 192.168.0.42 build/Alarm.bin --key SECRET
+  ota_send.py send 192.168.0.42 build/Alarm.bin --no-apply
+  ota_send.py emulate [--port 4243] [--key SECRET]
+
+send streams the .bin produced next to Alarm.elf. The unit stages it,
+verifies the CRC and the HMAC-SHA256 (SHA-256 without a key), replies,
+and (unless --no-apply) installs it and reboots. emulate runs a fake unit
+on this host that checks everything the firmware checks, so the tool can
+be tried without hardware.
+"""
+
+import argparse
+import hashlib
+import hmac
+import socket
+import struct
+import sys
+import time
+import zlib
+
+PORT = 4243
+MAGIC = b"AOTA"
+VERSION = 2
+FLAG_APPLY = 0x01
+HEADER = struct.Struct(">4sBBHII32s")
+
+SLOT_SIZE = 1024 * 1024 - 4096       # Must match OTA_SLOT_SIZE in src/ota.c
+SRAM = (0x20000000, 0x20042000)
+XIP_BASE = 0x10000000
+
+
+def image_digest(image, key):
+    """HMAC-SHA256 with the shared key, plain SHA-256 without one"""
+    if key:
+        return hmac.new(key.encode(), image, hashlib.sha256).digest()
+    return hashlib.sha256(image).digest()
+
+
+def check_image(image):
+    """Same sanity check as the firmware; None if the image looks fine"""
+    if len(image) < 512:
+        return "image too small"
+    if len(image) > SLOT_SIZE:
+        return f"image too large ({len(image)} bytes, slot is {SLOT_SIZE})"
+    sp, reset = struct.unpack_from("<II", image, 256)
+    if not (SRAM[0] < sp <= SRAM[1] and XIP_BASE + 256 < reset < XIP_BASE + len(image)):
+        return "not an RP2040 image (use the .bin, not the .elf or .uf2)"
+    return None
+
+
+def cmd_send(args):
+    with open(args.image, "rb") as f:
+        image = f.read()
+    problem = check_image(image)
+    if problem:
+        sys.exit(problem)
+
+    crc = zlib.crc32(image)
+    flags = 0 if args.no_apply else FLAG_APPLY
+    header = HEADER.pack(MAGIC, VERSION, flags, 0, len(image), crc, image_digest(image, args.key))
+    print(f"sending {len(image)} bytes, crc {crc:08x}, to {args.host}:{args.port}")
+
+    start = time.monotonic()
+    with socket.create_connection((args.host, args.port), timeout=args.timeout) as sock:
+        sock.sendall(header)
+        sent = 0
+        step = 64 * 1024
+        while sent < len(image):
+            sock.sendall(image[sent:sent + step])
+            sent = min(sent + step, len(image))
+            print(f"\r  {sent * 100 // len(image):3d}%  {sent // 1024} KB", end="", flush=True)
+        print()
+        reply = sock.makefile("r").readline().strip()
+    elapsed = time.monotonic() - start
+
+    print(f"{reply or '(no reply)'}  [{elapsed:.1f} s, {len(image) * 8 / elapsed / 1000:.0f} kbit/s]")
+    if not reply.startswith("OK"):
+        return 1
+    if flags & FLAG_APPLY:
+        print("unit is installing the image and will reboot")
+    return 0
+
+
+def cmd_emulate(args):
+    """Fake unit: reads slowly like the flash would, replies like the firmware"""
+    server = socket.create_server(("", args.port))
+    print(f"emulating an OTA listener on port {args.port}, Ctrl-C to stop")
+    while True:
+        conn, addr = server.accept()
+        with conn:
+            conn.settimeout(10)
+            data = b""
+            try:
+                while len(data) < HEADER.size:
+                    part = conn.recv(HEADER.size - len(data))
+                    if not part:
+                        raise ConnectionError("closed early")
+                    data += part
+                magic, version, flags, _, length, crc, digest = HEADER.unpack(data)
+                if magic != MAGIC or version != VERSION:
+                    conn.sendall(b"ERR bad header\n")
+                    continue
+                if length > SLOT_SIZE:
+                    conn.sendall(b"ERR image too large\n")
+                    continue
+                image = bytearray()
+                while len(image) < length:
+                    part = conn.recv(min(4096, length - len(image)))
+                    if not part:
+                        raise ConnectionError("closed early")
+                    image += part
+                    if len(image) % 4096 < len(part):
+                        time.sleep(0.05)  # Sector erase
+                problem = check_image(bytes(image))
+                if problem:
+                    conn.sendall(f"ERR {problem}\n".encode())
+                elif zlib.crc32(image) != crc:
+                    conn.sendall(b"ERR CRC mismatch\n")
+                elif not hmac.compare_digest(image_digest(bytes(image), args.key), digest):
+                    conn.sendall(b"ERR HMAC mismatch\n" if args.key else b"ERR SHA-256 mismatch\n")
+                else:
+                    conn.sendall(f"OK {length} {crc:08x}\n".encode())
+                    print(f"{addr[0]}: staged {length} bytes{', would apply' if flags & FLAG_APPLY else ''}")
+            except (ConnectionError, socket.timeout) as e:
+                print(f"{addr[0]}: {e}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    send = sub.add_parser("send", help="send an image to a unit")
+    send.add_argument("host")
+    send.add_argument("image", help="Alarm.bin")
+    send.add_argument("--port", type=int, default=PORT)
+    send.add_argument("--no-apply", action="store_true", help="only stage and verify, do not reboot")
+    send.add_argument("--timeout", type=float, default=15.0)
+    send.add_argument("--key", default="", help="ALARM_OTA_KEY the firmware was built with")
+
+    emulate = sub.add_parser("emulate", help="run a fake unit on this host")
+    emulate.add_argument("--port", type=int, default=PORT)
+    emulate.add_argument("--key", default="", help="ALARM_OTA_KEY to emulate")
+
+    args = parser.parse_args()
+    handler = {"send": cmd_send, "emulate": cmd_emulate}[args.command]
+    try:
+        sys.exit(handler(args))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
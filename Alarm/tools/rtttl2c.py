@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Compile RTTTL ringtones into const PWM tables for buzzer.c.
+
+Each ringtone gets one PWM clock divider (chosen so its lowest note still
+fits the 16-bit wrap) and a wrap/level/duration record per note, so the
+firmware changes notes with two register writes and no division.
+
+usage: rtttl2c.py --sys-clk-hz 125000000 --out-dir DIR file.rtttl...
+"""
+
+import argparse
+import math
+import os
+import re
+import sys
+
+NOTE_SEMITONES = {"c": 0, "d": 2, "e": 4, "f": 5, "g": 7, "a": 9, "b": 11}
+NOTE_RE = re.compile(r"^(\d+)?([a-gp])(#?)(\.?)(\d)?(\.?)$")
+PWM_MAX_WRAP = 0xFFFF
+PWM_MAX_DIV16 = (255 << 4) | 0xF
+
+
+def fail(path, msg):
+    sys.exit(f"{path}: {msg}")
+
+
+def parse_rtttl(path):
+    with open(path) as f:
+        text = "".join(f.read().split())
+
+    try:
+        name, defaults, body = text.split(":")
+    except ValueError:
+        fail(path, "expected 'name:defaults:notes'")
+
+    settings = {"d": 4, "o": 6, "b": 63}
+    for item in filter(None, defaults.split(",")):
+        key, _, value = item.partition("=")
+        if key not in settings or not value.isdigit():
+            fail(path, f"bad default '{item}'")
+        settings[key] = int(value)
+
+    whole_note_ms = 4 * 60000 / settings["b"]
+    notes = []
+    for token in filter(None, body.lower().split(",")):
+        m = NOTE_RE.match(token)
+        if not m:
+            fail(path, f"bad note '{token}'")
+        duration, letter, sharp, dot1, octave, dot2 = m.groups()
+        ms = whole_note_ms / int(duration or settings["d"])
+        if dot1 or dot2:
+            ms *= 1.5
+        if letter == "p":
+            notes.append((0.0, round(ms)))
+            continue
+        # Octave 4 holds A4 = 440 Hz (MIDI note 69)
+        midi = 12 * (int(octave or settings["o"]) + 1) + NOTE_SEMITONES[letter] + (1 if sharp else 0)
+        notes.append((440.0 * 2 ** ((midi - 69) / 12), round(ms)))
+
+    if not notes:
+        fail(path, "no notes")
+    return name, notes
+
+
+def pwm_records(path, notes, sys_clk_hz):
+    tones = [f for f, _ in notes if f > 0]
+    lowest = min(tones) if tones else 1000.0
+
+    # Divider in 1/16 steps (PWM DIV register is 8.4 fixed point)
+    div16 = max(16, math.ceil(sys_clk_hz * 16 / (lowest * (PWM_MAX_WRAP + 1))))
+    if div16 > PWM_MAX_DIV16:
+        fail(path, f"{lowest:.1f} Hz is too low for a {sys_clk_hz} Hz system clock")
+
+    records = []
+    for freq, ms in notes:
+        if ms > 0xFFFF:
+            fail(path, f"note of {ms} ms is too long")
+        if freq == 0:
+            records.append((0, 0, ms, 0.0))
+            continue
+        wrap = round(sys_clk_hz * 16 / (div16 * freq)) - 1
+        actual = sys_clk_hz * 16 / (div16 * (wrap + 1))
+        records.append((wrap, (wrap + 1) // 2, ms, actual))
+    return div16, records
+
+
+def c_identifier(name):
+    return re.sub(r"\W", "_", name).lower()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sys-clk-hz", type=int, required=True)
+    parser.add_argument("--out-dir", required=True)
+    parser.add_argument("files", nargs="+")
+    args = parser.parse_args()
+
+    tunes = []
+    for path in args.files:
+        name, notes = parse_rtttl(path)
+        div16, records = pwm_records(path, notes, args.sys_clk_hz)
+        tunes.append((name, div16, records))
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    with open(os.path.join(args.out_dir, "ringtones.h"), "w") as h:
+        h.write(f"""// Generated by tools/rtttl2c.py - do not edit
+#ifndef RINGTONES_H
+#define RINGTONES_H
+
+#include <stdint.h>
+
+// System clock the tables were computed for
+#define RINGTONE_SYS_CLK_HZ {args.sys_clk_hz}u
+
+typedef struct {{
+    uint16_t wrap;        // PWM TOP for the note (0 = rest)
+    uint16_t level;       // Compare level, 50% duty
+    uint16_t duration_ms;
+}} ringtone_note_t;
+
+typedef struct {{
+    const char *name;
+    uint8_t div_int;      // PWM clock divider, shared by every note
+    uint8_t div_frac;     // In 1/16 steps
+    uint16_t length;
+    const ringtone_note_t *notes;
+}} ringtone_t;
+
+#define RINGTONE_COUNT {len(tunes)}
+extern const ringtone_t ringtones[RINGTONE_COUNT];
+
+#endif // RINGTONES_H
+""")
+
+    with open(os.path.join(args.out_dir, "ringtones.c"), "w") as c:
+        c.write("// Generated by tools/rtttl2c.py - do not edit\n")
+        c.write('#include "ringtones.h"\n\n')
+        for name, div16, records in tunes:
+            c.write(f"static const ringtone_note_t {c_identifier(name)}_notes[] = {{\n")
+            for wrap, level, ms, actual in records:
+                comment = f"{actual:.1f} Hz" if wrap else "rest"
+                c.write(f"    {{{wrap}, {level}, {ms}}}, // {comment}\n")
+            c.write("};\n\n")
+        c.write("const ringtone_t ringtones[RINGTONE_COUNT] = {\n")
+        for name, div16, records in tunes:
+            c.write(f'    {{"{name}", {div16 >> 4}, {div16 & 0xF}, {len(records)}, {c_identifier(name)}_notes}},\n')
+        c.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
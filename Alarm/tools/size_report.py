@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare flash and RAM use of two firmware builds.
+
+  size_report.py build/Alarm.elf build/Alarm_offline.elf
+
+Flash is everything that gets programmed (code, read-only data and the
+initial values of .data); RAM is the statically allocated part of SRAM
+(.data, .bss and RAM-resident code), without the heap and stacks, which
+take whatever is left. Reads the ELF section headers directly, so no
+toolchain binutils are needed.
+"""
+
+import argparse
+import struct
+import sys
+
+SHT_PROGBITS = 1
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+SRAM = (0x20000000, 0x20042000)
+RAM_RESERVED = (".heap", ".stack")
+
+
+def sections(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+        sys.exit(f"{path}: not a 32-bit little endian ELF file")
+    shoff, = struct.unpack_from("<I", data, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+
+    headers = [struct.unpack_from("<IIIIIIIIII", data, shoff + i * shentsize) for i in range(shnum)]
+    strtab = headers[shstrndx][4]
+    for name, kind, flags, addr, _, size, *_ in headers:
+        end = data.index(b"\0", strtab + name)
+        yield data[strtab + name:end].decode(), kind, flags, addr, size
+
+
+def measure(path):
+    flash = ram = 0
+    for name, kind, flags, addr, size in sections(path):
+        if not flags & SHF_ALLOC:
+            continue
+        if kind == SHT_PROGBITS:
+            flash += size
+        in_sram = SRAM[0] <= addr < SRAM[1]
+        if in_sram and kind in (SHT_PROGBITS, SHT_NOBITS) and not name.startswith(RAM_RESERVED):
+            ram += size
+    return flash, ram
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("full", help="Alarm.elf")
+    parser.add_argument("other", help="Alarm_offline.elf")
+    args = parser.parse_args()
+
+    full = measure(args.full)
+    other = measure(args.other)
+    print(f"{'':24} {'flash':>10} {'static RAM':>12}")
+    for path, (flash, ram) in ((args.full, full), (args.other, other)):
+        print(f"{path.rsplit('/', 1)[-1]:24} {flash:>10,} {ram:>12,}")
+    print(f"{'difference':24} {other[0] - full[0]:>+10,} {other[1] - full[1]:>+12,}")
+    print(f"{'':24} {(other[0] - full[0]) * 100 / full[0]:>+9.1f}% {(other[1] - full[1]) * 100 / full[1]:>+11.1f}%")
+
+
+if __name__ == "__main__":
+    main()
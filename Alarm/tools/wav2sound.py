@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Encode sound clips into const flash assets for audio.c.
+
+Inputs are WAV files (any channel count, 8 or 16 bit). They are mixed to
+mono, resampled to --rate and stored as IMA-ADPCM (4 bits/sample) or, for
+files named NAME.pcm8.wav, as unsigned 8-bit PCM. A synthesised bell
+'chime' is always included so the firmware has a clip without any WAVs.
+
+usage: wav2sound.py --rate 16000 --out-dir DIR [file.wav...]
+"""
+
+import argparse
+import math
+import os
+import re
+import struct
+import sys
+import wave
+
+IMA_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+IMA_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+]
+
+
+def synth_chime(rate):
+    """Two-second bell: a few inharmonic partials with exponential decay."""
+    partials = [(880.0, 1.0, 2.5), (1760.0, 0.5, 3.5), (2640.0, 0.3, 5.0), (1210.0, 0.25, 4.0)]
+    out = []
+    for n in range(int(rate * 2.0)):
+        t = n / rate
+        v = sum(a * math.exp(-d * t) * math.sin(2 * math.pi * f * t) for f, a, d in partials)
+        out.append(int(max(-1.0, min(1.0, v / 2.05)) * 30000))
+    return out
+
+
+def read_wav(path, rate):
+    with wave.open(path, "rb") as w:
+        channels, width, src_rate = w.getnchannels(), w.getsampwidth(), w.getframerate()
+        frames = w.readframes(w.getnframes())
+    if width == 1:
+        raw = [(b - 128) << 8 for b in frames]
+    elif width == 2:
+        raw = list(struct.unpack(f"<{len(frames) // 2}h", frames))
+    else:
+        sys.exit(f"{path}: only 8 and 16 bit WAV files are supported")
+    mono = [sum(raw[i:i + channels]) // channels for i in range(0, len(raw), channels)]
+
+    # Linear resample
+    count = int(len(mono) * rate / src_rate)
+    out = []
+    for n in range(count):
+        pos = n * src_rate / rate
+        i = int(pos)
+        frac = pos - i
+        nxt = mono[i + 1] if i + 1 < len(mono) else mono[i]
+        out.append(int(mono[i] + (nxt - mono[i]) * frac))
+    return out
+
+
+def ima_encode(samples):
+    predictor, index = 0, 0
+    nibbles = []
+    for s in samples:
+        step = IMA_STEP_TABLE[index]
+        diff = s - predictor
+        nibble = 0
+        if diff < 0:
+            nibble = 8
+            diff = -diff
+        if diff >= step:
+            nibble |= 4
+            diff -= step
+        if diff >= step >> 1:
+            nibble |= 2
+            diff -= step >> 1
+        if diff >= step >> 2:
+            nibble |= 1
+
+        # Track the decoder exactly so errors do not accumulate
+        step = IMA_STEP_TABLE[index]
+        delta = step >> 3
+        if nibble & 4:
+            delta += step
+        if nibble & 2:
+            delta += step >> 1
+        if nibble & 1:
+            delta += step >> 2
+        predictor += -delta if nibble & 8 else delta
+        predictor = max(-32768, min(32767, predictor))
+        index = max(0, min(88, index + IMA_INDEX_TABLE[nibble]))
+        nibbles.append(nibble)
+
+    if len(nibbles) % 2:
+        nibbles.append(0)
+    # Low nibble first
+    return bytes(nibbles[i] | (nibbles[i + 1] << 4) for i in range(0, len(nibbles), 2))
+
+
+def pcm8_encode(samples):
+    return bytes((max(-32768, min(32767, s)) >> 8) + 128 for s in samples)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--rate", type=int, default=16000)
+    parser.add_argument("--out-dir", required=True)
+    parser.add_argument("files", nargs="*")
+    args = parser.parse_args()
+
+    clips = [("chime", "SOUND_FORMAT_IMA_ADPCM", synth_chime(args.rate))]
+    for path in args.files:
+        stem = os.path.splitext(os.path.basename(path))[0]
+        stem, ext = os.path.splitext(stem)
+        if ext.lower() == ".pcm8":
+            fmt = "SOUND_FORMAT_PCM8"
+        else:
+            stem += ext
+            fmt = "SOUND_FORMAT_IMA_ADPCM"
+        name = re.sub(r"\W", "_", stem).lower()
+        clips.append((name, fmt, read_wav(path, args.rate)))
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    with open(os.path.join(args.out_dir, "sounds.h"), "w") as h:
+        h.write("""// Generated by tools/wav2sound.py - do not edit
+#ifndef SOUNDS_H
+#define SOUNDS_H
+
+#include <stdint.h>
+
+typedef enum {
+    SOUND_FORMAT_PCM8,      // Unsigned 8-bit, one byte per sample
+    SOUND_FORMAT_IMA_ADPCM  // 4 bits per sample, low nibble first
+} sound_format_t;
+
+typedef struct {
+    const char *name;
+    sound_format_t format;
+    uint32_t sample_rate;
+    uint32_t num_samples;
+    const uint8_t *data;    // Stays in XIP flash
+} sound_clip_t;
+
+""")
+        for i, (name, _, _) in enumerate(clips):
+            h.write(f"#define SOUND_{name.upper()} {i}\n")
+        h.write(f"#define SOUND_COUNT {len(clips)}\n\n")
+        h.write("extern const sound_clip_t sound_clips[SOUND_COUNT];\n\n#endif // SOUNDS_H\n")
+
+    with open(os.path.join(args.out_dir, "sounds.c"), "w") as c:
+        c.write("// Generated by tools/wav2sound.py - do not edit\n")
+        c.write('#include "sounds.h"\n')
+        for name, fmt, samples in clips:
+            data = ima_encode(samples) if fmt == "SOUND_FORMAT_IMA_ADPCM" else pcm8_encode(samples)
+            c.write(f"\nstatic const uint8_t {name}_data[{len(data)}] = {{\n")
+            for i in range(0, len(data), 16):
+                c.write("    " + ", ".join(f"0x{b:02x}" for b in data[i:i + 16]) + ",\n")
+            c.write("};\n")
+        c.write("\nconst sound_clip_t sound_clips[SOUND_COUNT] = {\n")
+        for name, fmt, samples in clips:
+            c.write(f'    {{"{name}", {fmt}, {args.rate}, {len(samples)}, {name}_data}},\n')
+        c.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Compress the web UI in www/ into const arrays for http_server.c.
+
+Every file is gzipped once at build time and stored together with its
+complete HTTP response header, so the server can hand both to tcp_write
+straight from flash without copying or compressing anything at run time.
+The ETag is a CRC32 of the uncompressed file.
+
+usage: www2c.py --out-dir DIR --root www/ FILE...
+"""
+
+import argparse
+import gzip
+import os
+import zlib
+
+CONTENT_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+}
+
+
+def c_bytes(data, indent="    "):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append(indent + ", ".join(f"0x{b:02x}" for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"').replace("\r", "\\r").replace("\n", "\\n") + '"'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--out-dir", required=True)
+    parser.add_argument("--root", required=True, help="directory the URL paths are relative to")
+    parser.add_argument("files", nargs="+")
+    args = parser.parse_args()
+
+    assets = []
+    for path in sorted(args.files):
+        url = "/" + os.path.relpath(path, args.root).replace(os.sep, "/")
+        ext = os.path.splitext(path)[1].lower()
+        if ext not in CONTENT_TYPES:
+            parser.error(f"{path}: unknown content type")
+        with open(path, "rb") as f:
+            raw = f.read()
+        # mtime=0 keeps the output reproducible
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = f'"{zlib.crc32(raw):08x}"'
+        header = ("HTTP/1.1 200 OK\r\n"
+                  f"Content-Type: {CONTENT_TYPES[ext]}\r\n"
+                  "Content-Encoding: gzip\r\n"
+                  f"Content-Length: {len(packed)}\r\n"
+                  f"ETag: {etag}\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: close\r\n"
+                  "\r\n")
+        assets.append((url, etag, header, raw, packed))
+        print(f"{url}: {len(raw)} -> {len(packed)} bytes")
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    with open(os.path.join(args.out_dir, "web_assets.h"), "w") as h:
+        h.write(f"""// Generated by tools/www2c.py - do not edit
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stdint.h>
+
+typedef struct {{
+    const char *path;        // URL path, e.g. "/index.html"
+    const char *etag;        // Quoted, as sent in the ETag header
+    const char *header;      // Complete "200 OK" response header
+    uint16_t header_len;
+    const uint8_t *data;     // gzip body
+    uint32_t length;
+}} web_asset_t;
+
+#define WEB_ASSET_COUNT {len(assets)}
+extern const web_asset_t web_assets[WEB_ASSET_COUNT];
+
+#endif // WEB_ASSETS_H
+""")
+
+    with open(os.path.join(args.out_dir, "web_assets.c"), "w") as c:
+        c.write("// Generated by tools/www2c.py - do not edit\n")
+        c.write('#include "web_assets.h"\n\n')
+        for i, (url, etag, header, raw, packed) in enumerate(assets):
+            c.write(f"// {url}: {len(raw)} bytes, {len(packed)} gzipped\n")
+            c.write(f"static const uint8_t asset{i}_data[] = {{\n{c_bytes(packed)}\n}};\n\n")
+        c.write("const web_asset_t web_assets[WEB_ASSET_COUNT] = {\n")
+        for i, (url, etag, header, raw, packed) in enumerate(assets):
+            c.write(f"    {{{c_string(url)}, {c_string(etag)},\n")
+            c.write(f"     {c_string(header)},\n")
+            c.write(f"     {len(header)}, asset{i}_data, {len(packed)}}},\n")
+        c.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
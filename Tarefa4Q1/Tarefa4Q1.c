@@ -2,54 +2,73 @@
 #include "pico/stdlib.h"
 #include "hardware/timer.h"
 #include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/irq.h"
+#include "debounce.pio.h"
+#include "blink.pio.h"
 
 // Configuração dos pinos
 const uint BLUE_LED_PIN= 12;   // Ex.: LED on-board do RP2040 (geralmente GPIO 25)
-#define BUTTON_PIN  5   // Botão A 
+#define BUTTON_PIN  5   // Botão A (pino 0 do debounce, o 6 fica como pino 1)
+#define DEBOUNCE_MS 10  // Janela de debounce do PIO
+#define BLINK_HALF_PERIOD_US 100000 // Troca o LED a cada 100 ms
+#define BLINK_DURATION_MS 10000     // Duração do modo de piscar
 
 // Variáveis globais 
 static volatile uint32_t press_count = 0;
 static volatile bool led_blinking_mode = false; 
-static volatile bool button_was_pressed = false; 
+static volatile uint32_t edge_count = 0; // Bordas confirmadas pelo PIO
+static volatile bool blink_started = false;  // Avisos para o loop principal
+static volatile bool blink_finished = false;
 
-// Função de callback para o timer repetitivo
-// Faz a varredura do botão e atualiza o contador de pressões
-bool timer_callback_button_check(repeating_timer_t *rt) {
-    // Lê o estado do pino do botão
-    bool button_state = gpio_get(BUTTON_PIN);
+static PIO button_pio = pio0;
+static uint button_sm;
+static uint32_t button_levels = (1u << debounce_PIN_COUNT) - 1; // Tudo solto
 
-    // Se o botão for "ativo em nível baixo", ajuste a lógica conforme necessário
-    // Exemplo: se o hardware fechar GND ao apertar, então '0' = pressionado
-    // Aqui supondo "0" = pressionado
-    if(!button_state) {
-        // Se estava solto e agora está pressionado, incrementamos
-        if(!button_was_pressed) {
-            button_was_pressed = true;
-            press_count++;
-            printf("Botão pressionado! Contagem = %d\n", press_count);
+// O LED pisca pelo programa blink do PIO, sem CPU durante o piscar
+static PIO blink_pio = pio0;
+static uint blink_sm;
+static uint blink_offset;
+
+// Alarme de hardware: fim dos 10 s de piscar
+int64_t blink_end_callback(alarm_id_t id, void *user_data) {
+    blink_program_stop(blink_pio, blink_sm); // Para a SM e deixa o LED apagado
+    led_blinking_mode = false;
+    blink_finished = true;
+    return 0;
+}
+
+// Pisca o LED por 10 segundos, trocando a cada 100 ms. Retorna na hora:
+// o PIO gera o sinal e um alarme de hardware encerra o piscar.
+void blink_led_10s_10hz(void) {
+    blink_program_start(blink_pio, blink_sm, blink_offset, BLINK_HALF_PERIOD_US);
+    add_alarm_in_ms(BLINK_DURATION_MS, blink_end_callback, NULL, true);
+    blink_started = true;
+}
+
+// Interrupção do PIO: só acontece quando o nível de um botão muda e fica
+// estável pela janela de debounce. Cada palavra da FIFO traz os níveis.
+void button_irq_handler(void) {
+    while (!pio_sm_is_rx_fifo_empty(button_pio, button_sm)) {
+        uint32_t levels = pio_sm_get(button_pio, button_sm);
+        uint32_t changed = levels ^ button_levels;
+        button_levels = levels;
+
+        // '0' = pressionado; conta só a borda de descida do botão A
+        if (changed & 1u) {
+            edge_count++;
+            if (!(levels & 1u)) {
+                press_count++;
+                printf("Botão pressionado! Contagem = %d (bordas: %d)\n", press_count, edge_count);
+            }
         }
-    } else {
-        // Se o botão não está pressionado, reseta flag interna
-        button_was_pressed = false;
     }
 
     // Se chegou a 5 pressões e ainda não está piscando, inicia o modo de piscar
     if(press_count >= 5 && !led_blinking_mode) {
         led_blinking_mode = true;
         press_count = 0;   // zera contagem caso deseje reiniciar depois
-    }
-
-    return true; // para continuar chamando o timer
-}
-
-// Função para piscar o LED por 10 segundos a 10Hz (bloco "sincronamente" no loop)
-void blink_led_10s_10hz(void) {
-    // Precisamos de 10 segundos piscando a 10Hz -> 100 toggles
-    // Frequência de 10Hz = período de 100 ms
-    const uint32_t total_toggles = 100;
-    for(uint32_t i = 0; i < total_toggles; i++) {
-        gpio_xor_mask(1u << BLUE_LED_PIN);  // Toggle do LED
-        sleep_ms(100);                 // período de 100 ms (10Hz)
+        blink_led_10s_10hz();
     }
 }
 
@@ -57,33 +76,30 @@ int main() {
     stdio_init_all();
     printf("Inicializando...\n");
 
-    // Configura o pino do LED como saída
-    gpio_init(BLUE_LED_PIN);
-    gpio_set_dir(BLUE_LED_PIN, GPIO_OUT);
-    gpio_put(BLUE_LED_PIN, 0); // LED inicialmente apagado
+    // Pino do LED controlado pelo programa blink do PIO
+    blink_offset = pio_add_program(blink_pio, &blink_program);
+    blink_sm = pio_claim_unused_sm(blink_pio, true);
+    blink_program_init(blink_pio, blink_sm, blink_offset, BLUE_LED_PIN);
+    blink_program_stop(blink_pio, blink_sm); // LED inicialmente apagado
 
-    // Configura o pino do botão como entrada com pull-up (ou pull-down) interno
-    gpio_init(BUTTON_PIN);
-    gpio_set_dir(BUTTON_PIN, GPIO_IN);
-    gpio_pull_up(BUTTON_PIN);
-    // Se o seu hardware precisar de pull-down (ou resistor externo),
-    // trocar para gpio_pull_down(BUTTON_PIN);
+    // Botão com pull-up interno, debounce feito pelo PIO (sem timer de varredura)
+    uint offset = pio_add_program(button_pio, &debounce_program);
+    button_sm = pio_claim_unused_sm(button_pio, true);
+    debounce_program_init(button_pio, button_sm, offset, BUTTON_PIN, DEBOUNCE_MS);
 
-    // Cria um timer repetitivo para verificar o botão a cada 10ms, por exemplo
-    repeating_timer_t timer_button;
-    add_repeating_timer_ms(10, timer_callback_button_check, NULL, &timer_button);
+    irq_set_exclusive_handler(PIO0_IRQ_0, button_irq_handler);
+    pio_set_irq0_source_enabled(button_pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + button_sm), true);
+    irq_set_enabled(PIO0_IRQ_0, true);
 
-    // Loop principal
+    // Loop principal: só mostra o estado, o piscar não depende dele
     while(true) {
-        // Se estiver no modo de piscar, executa o piscar por 10s e depois volta
-        if(led_blinking_mode) {
+        if(blink_started) {
+            blink_started = false;
             printf("Iniciando piscar de 10s a 10Hz...\n");
-            blink_led_10s_10hz();
+        }
+        if(blink_finished) {
+            blink_finished = false;
             printf("Fim do piscar.\n");
-
-            // Desativa modo piscando, LED fica apagado e volta ao loop normal
-            gpio_put(BLUE_LED_PIN, 0);
-            led_blinking_mode = false;
         }
         sleep_ms(50); // pausa rápida para evitar loop muito rápido
     }
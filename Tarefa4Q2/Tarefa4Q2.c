@@ -2,127 +2,131 @@
 #include "pico/stdlib.h"
 #include "hardware/timer.h"
 #include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/irq.h"
+#include "debounce.pio.h"
+#include "blink.pio.h"
 
 // Configuração dos pinos
 const uint32_t BLUE_LED_PIN = 12; 
 #define BUTTON_A_PIN  5   // Botão A 
-#define BUTTON_B_PIN  6   // Botão B 
+#define BUTTON_B_PIN  6   // Botão B (consecutivo ao A: pinos 0 e 1 do debounce)
+#define DEBOUNCE_MS 10    // Janela de debounce do PIO
+#define BLINK_10HZ_HALF_PERIOD_US 100000  // Troca o LED a cada 100 ms
+#define BLINK_1HZ_HALF_PERIOD_US 1000000  // Troca o LED a cada 1 s
+#define BLINK_DURATION_MS 10000           // Duração do modo de piscar
 
 // Variáveis globais 
 static volatile uint32_t pressA_count = 0;
 static volatile bool led_A_blinking_mode = false;
-static volatile bool buttonA_was_pressed = false; 
-static volatile bool buttonB_was_pressed = false; 
-static volatile bool change_to_1hz = false; // Indica se deve mudar a frequência para 1Hz
-
-// Função de callback para o timer repetitivo
-bool timer_callback_button_check(repeating_timer_t *rt) {
-    // Lê o estado do pino do botão
-    bool buttonA_state = gpio_get(BUTTON_A_PIN);
-    bool buttonB_state = gpio_get(BUTTON_B_PIN);
-
-    // '0' = pressionado
-    if (!buttonA_state) {
-        // Se estava solto e agora está pressionado, incrementa
-        if (!buttonA_was_pressed) {
-            buttonA_was_pressed = true;
-            pressA_count++;
-            printf("Botão A pressionado! Contagem = %d\n", pressA_count);
-        }
-    } else {
-        // Se o botão não está pressionado, reseta flag interna
-        buttonA_was_pressed = false;
-    }
-
-    // Se chegou a 5 pressões e ainda não está piscando, inicia o modo de piscar
-    if (pressA_count >= 5 && !led_A_blinking_mode) {
-        led_A_blinking_mode = true;
-        change_to_1hz = false; // Reseta a frequência para 10Hz inicialmente
-        pressA_count = 0;      // Zera contagem caso deseje reiniciar depois
-    }
-
-    if (!buttonB_state) {
-        // Se estava solto e agora está pressionado
-        if (!buttonB_was_pressed) {
-            buttonB_was_pressed = true;
-            if (led_A_blinking_mode) {
-                change_to_1hz = true; // Solicita a mudança para 1Hz
-                printf("Botão B pressionado! Mudando frequência para 1Hz.\n");
-            }
-        }
-    } else {
-        // Se o botão não está pressionado, reseta flag interna
-        buttonB_was_pressed = false;
-    }
-
-    return true; // Para continuar chamando o timer
+static volatile uint32_t edge_count[2] = {0, 0}; // Bordas confirmadas pelo PIO (A, B)
+static volatile bool blink_started = false;  // Avisos para o loop principal
+static volatile bool blink_finished = false;
+static volatile uint32_t blink_start_ms = 0;
+
+static PIO button_pio = pio0;
+static uint button_sm;
+static uint32_t button_levels = (1u << debounce_PIN_COUNT) - 1; // Tudo solto
+
+// O LED pisca pelo programa blink do PIO, sem CPU durante o piscar
+static PIO blink_pio = pio0;
+static uint blink_sm;
+static uint blink_offset;
+
+// Alarme de hardware: fim dos 10 s de piscar
+int64_t blink_end_callback(alarm_id_t id, void *user_data) {
+    blink_program_stop(blink_pio, blink_sm); // Para a SM e deixa o LED apagado
+    led_A_blinking_mode = false;
+    blink_finished = true;
+    return 0;
 }
 
-// Função para piscar o LED com mudança de frequência
+// Começa a 10Hz (troca a cada 100 ms) por 10 segundos. Retorna na hora:
+// o PIO gera o sinal e um alarme de hardware encerra o piscar.
 void dynamic_blink_led_10s(void) {
-    const uint32_t total_time_ms = 10000; // 10 segundos
-    uint32_t elapsed_time = 0;
-    uint32_t period = 100; // Começa com 10Hz (100ms)
-    uint32_t current_second = 0;
+    blink_program_start(blink_pio, blink_sm, blink_offset, BLINK_10HZ_HALF_PERIOD_US);
+    add_alarm_in_ms(BLINK_DURATION_MS, blink_end_callback, NULL, true);
+    blink_start_ms = to_ms_since_boot(get_absolute_time());
+    blink_started = true;
+}
 
-    while (elapsed_time < total_time_ms) {
-        // Alterna o LED
-        gpio_xor_mask(1u << BLUE_LED_PIN);
-        sleep_ms(period);
+// Interrupção do PIO: só acontece quando o nível de um botão muda e fica
+// estável pela janela de debounce. Cada palavra da FIFO traz os níveis.
+void button_irq_handler(void) {
+    while (!pio_sm_is_rx_fifo_empty(button_pio, button_sm)) {
+        uint32_t levels = pio_sm_get(button_pio, button_sm);
+        uint32_t changed = levels ^ button_levels;
+        button_levels = levels;
+
+        for (uint i = 0; i < 2; i++) {
+            if (changed & (1u << i)) {
+                edge_count[i]++;
+            }
+        }
 
-        // Atualiza o tempo decorrido
-        elapsed_time += period;
+        // '0' = pressionado: borda de descida do botão A
+        if ((changed & 1u) && !(levels & 1u)) {
+            pressA_count++;
+            printf("Botão A pressionado! Contagem = %d (bordas A/B: %d/%d)\n",
+                   pressA_count, edge_count[0], edge_count[1]);
+        }
 
-        // Checa se um segundo inteiro passou
-        if (elapsed_time / 1000 > current_second) {
-            current_second = elapsed_time / 1000;
-            printf("Tempo decorrido: %d segundos\n", current_second);
+        // Se chegou a 5 pressões e ainda não está piscando, inicia o modo de piscar
+        if (pressA_count >= 5 && !led_A_blinking_mode) {
+            led_A_blinking_mode = true;
+            pressA_count = 0;      // Zera contagem caso deseje reiniciar depois
+            dynamic_blink_led_10s();
         }
 
-        // Se o botão B foi pressionado, muda a frequência para 1Hz
-        if (change_to_1hz) {
-            period = 1000; // 1Hz = 1000ms
-            change_to_1hz = false; // Reseta o estado
+        // Borda de descida do botão B
+        if ((changed & 2u) && !(levels & 2u) && led_A_blinking_mode) {
+            // Uma escrita na FIFO: vale a partir do próximo período
+            blink_program_set_half_period_us(blink_pio, blink_sm, BLINK_1HZ_HALF_PERIOD_US);
+            printf("Botão B pressionado! Mudando frequência para 1Hz.\n");
         }
     }
-
-    // Apaga o LED após terminar
-    gpio_put(BLUE_LED_PIN, 0);
 }
 
 int main() {
     stdio_init_all();
     printf("Inicializando...\n");
 
-    // Configura o pino do LED como saída
-    gpio_init(BLUE_LED_PIN);
-    gpio_set_dir(BLUE_LED_PIN, GPIO_OUT);
-    gpio_put(BLUE_LED_PIN, 0); // LED inicialmente apagado
-
-    // Configura o pino do botão A como entrada com pull-up interno
-    gpio_init(BUTTON_A_PIN);
-    gpio_set_dir(BUTTON_A_PIN, GPIO_IN);
-    gpio_pull_up(BUTTON_A_PIN);
-    // Configura o pino do botão B como entrada com pull-up interno
-    gpio_init(BUTTON_B_PIN);
-    gpio_set_dir(BUTTON_B_PIN, GPIO_IN);
-    gpio_pull_up(BUTTON_B_PIN);
-
-    // Cria um timer repetitivo para verificar os botões a cada 10ms
-    repeating_timer_t timer_button;
-    add_repeating_timer_ms(10, timer_callback_button_check, NULL, &timer_button);
-
-    // Loop principal
+    // Pino do LED controlado pelo programa blink do PIO
+    blink_offset = pio_add_program(blink_pio, &blink_program);
+    blink_sm = pio_claim_unused_sm(blink_pio, true);
+    blink_program_init(blink_pio, blink_sm, blink_offset, BLUE_LED_PIN);
+    blink_program_stop(blink_pio, blink_sm); // LED inicialmente apagado
+
+    // Botões A e B com pull-up interno, debounce feito pelo PIO
+    uint offset = pio_add_program(button_pio, &debounce_program);
+    button_sm = pio_claim_unused_sm(button_pio, true);
+    debounce_program_init(button_pio, button_sm, offset, BUTTON_A_PIN, DEBOUNCE_MS);
+
+    irq_set_exclusive_handler(PIO0_IRQ_0, button_irq_handler);
+    pio_set_irq0_source_enabled(button_pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + button_sm), true);
+    irq_set_enabled(PIO0_IRQ_0, true);
+
+    // Loop principal: só mostra o estado, o piscar não depende dele
+    uint32_t current_second = 0;
     while (true) {
-        // Se estiver no modo de piscar, executa o piscar dinamicamente
-        if (led_A_blinking_mode) {
+        if (blink_started) {
+            blink_started = false;
+            current_second = 0;
             printf("Iniciando piscar de 10s a 10Hz...\n");
-            dynamic_blink_led_10s();
-            printf("Fim do piscar.\n");
+        }
+
+        // Checa se um segundo inteiro passou
+        if (led_A_blinking_mode) {
+            uint32_t elapsed_time = to_ms_since_boot(get_absolute_time()) - blink_start_ms;
+            if (elapsed_time / 1000 > current_second) {
+                current_second = elapsed_time / 1000;
+                printf("Tempo decorrido: %d segundos\n", current_second);
+            }
+        }
 
-            // Desativa modo piscando, LED fica apagado e volta ao loop normal
-            gpio_put(BLUE_LED_PIN, 0);
-            led_A_blinking_mode = false;
+        if (blink_finished) {
+            blink_finished = false;
+            printf("Fim do piscar.\n");
         }
 
         sleep_ms(50); // Pausa rápida para evitar loop muito rápido
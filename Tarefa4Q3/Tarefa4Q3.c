@@ -1,6 +1,9 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
+#include "uart_ring.h"
+#include "link.h"
 
 // Definições para UART0 e UART1
 #define UART0_ID uart0
@@ -15,11 +18,38 @@
 #define UART1_TX_PIN 4
 #define UART1_RX_PIN 5
 
+// Ligação: GP0 (TX da UART0) -> GP5 (RX da UART1)
+
 // Pinos do LED RGB
 #define LED_R_PIN 11
 #define LED_G_PIN 12
 #define LED_B_PIN 13
 
+// Benchmark: fluxo contínuo por BENCH_MS em cada baud, depois pings
+#define RING_SIZE 4096
+#define BENCH_MS 1000
+#define DRAIN_TIMEOUT_US 50000
+#define PING_COUNT 200
+#define PING_LEN 8
+#define PING_TIMEOUT_US 20000
+
+// Benchmark do link: mensagens de 8 bytes a baud fixo, com e sem juntar
+#define LINK_BENCH_BAUD 921600
+#define LINK_BENCH_QUEUE 512     // Bytes no máximo na fila de TX (segura a latência)
+#define LINK_MSG_DATA 1
+
+static const uint bench_bauds[] = { 115200, 460800, 921600, 1500000, 3000000, 4000000, 6000000 };
+static const uint32_t link_budgets_us[] = { 0, 100, 500, 2000 };
+
+static uint8_t uart0_rx_buf[RING_SIZE];
+static uint8_t uart0_tx_buf[RING_SIZE] UART_RING_ALIGNED(RING_SIZE);
+static uint8_t uart1_rx_buf[RING_SIZE];
+static uint8_t uart1_tx_buf[RING_SIZE] UART_RING_ALIGNED(RING_SIZE);
+static uart_ring_t link0;
+static uart_ring_t link1;
+static link_t frame_tx;
+static link_t frame_rx;
+
 // Função para configurar o LED RGB
 void set_rgb_color(bool r, bool g, bool b) {
     gpio_put(LED_R_PIN, r); // Vermelho
@@ -27,6 +57,209 @@ void set_rgb_color(bool r, bool g, bool b) {
     gpio_put(LED_B_PIN, b); // Azul
 }
 
+// O padrão enviado é o byte i = i & 0xFF. Um byte perdido desloca a
+// sequência: o receptor se ressincroniza pelo valor recebido e conta erro.
+typedef struct {
+    uint32_t tx_index;
+    uint32_t rx_index;
+    uint32_t errors;
+    uint64_t last_rx_us;
+} stream_t;
+
+static void stream_fill(stream_t *s) {
+    uint8_t *p;
+    uint32_t n;
+    while ((n = uart_ring_tx_reserve(&link0, &p)) > 0) {
+        for (uint32_t i = 0; i < n; i++) {
+            p[i] = (uint8_t)(s->tx_index + i);
+        }
+        s->tx_index += n;
+        uart_ring_tx_commit(&link0, n);
+    }
+}
+
+static void stream_check(stream_t *s) {
+    const uint8_t *p;
+    uint32_t n;
+    while ((n = uart_ring_rx_peek(&link1, &p)) > 0) {
+        for (uint32_t i = 0; i < n; i++) {
+            uint8_t expected = (uint8_t)s->rx_index;
+            if (p[i] != expected) {
+                s->errors++;
+                s->rx_index += (uint8_t)(p[i] - expected);
+            }
+            s->rx_index++;
+        }
+        uart_ring_rx_consume(&link1, n);
+        s->last_rx_us = time_us_64();
+    }
+}
+
+// Latência de uma mensagem curta: da escrita no ring até estar disponível
+// no ring do outro lado (inclui o tempo de linha e a IRQ de linha parada)
+static void measure_latency(uint32_t *min_us, uint32_t *avg_us, uint32_t *max_us, uint32_t *lost) {
+    uint8_t msg[PING_LEN] = { 0xA5, 1, 2, 3, 4, 5, 6, 0x5A };
+    uint8_t echo[PING_LEN];
+    uint64_t sum = 0;
+    uint32_t ok = 0;
+    *min_us = UINT32_MAX;
+    *max_us = 0;
+    *lost = 0;
+
+    for (int i = 0; i < PING_COUNT; i++) {
+        uint32_t t0 = time_us_32();
+        uart_ring_write(&link0, msg, PING_LEN);
+        while (uart_ring_rx_available(&link1) < PING_LEN && time_us_32() - t0 < PING_TIMEOUT_US) {
+            tight_loop_contents();
+        }
+        uint32_t dt = time_us_32() - t0;
+        if (uart_ring_read(&link1, echo, PING_LEN) < PING_LEN) {
+            (*lost)++;
+            continue;
+        }
+        sum += dt;
+        ok++;
+        if (dt < *min_us) *min_us = dt;
+        if (dt > *max_us) *max_us = dt;
+    }
+    *avg_us = ok ? (uint32_t)(sum / ok) : 0;
+    if (!ok) *min_us = 0;
+}
+
+static void run_benchmark(void) {
+    printf("\nBenchmark UART0 -> UART1 (8N1, FIFO RX em 1/2, ring %d B)\n", RING_SIZE);
+    printf("%8s %8s %8s %5s %5s %7s %16s %s\n", "baud", "real", "KB/s", "efic", "CPU", "IRQs",
+           "lat min/med/max", "erros (padrão/desc/OE/FE/PE/BE)");
+    bool any_error = false;
+    set_rgb_color(0, 0, 1);
+
+    for (size_t b = 0; b < sizeof(bench_bauds) / sizeof(bench_bauds[0]); b++) {
+        uint baud = uart_ring_set_baudrate(&link0, bench_bauds[b]);
+        uart_ring_set_baudrate(&link1, bench_bauds[b]);
+        uart_ring_reset_stats(&link0);
+        uart_ring_reset_stats(&link1);
+
+        // Vazão sustentada: o ring de TX fica sempre cheio
+        stream_t s = { 0 };
+        uint64_t start = time_us_64();
+        uint64_t stop = start + BENCH_MS * 1000ull;
+        while (time_us_64() < stop) {
+            stream_fill(&s);
+            stream_check(&s);
+        }
+        // Espera o resto chegar
+        uint64_t drain_start = time_us_64();
+        while (s.rx_index != s.tx_index && time_us_64() - drain_start < DRAIN_TIMEOUT_US) {
+            stream_check(&s);
+        }
+        uint64_t elapsed_us = (s.last_rx_us > start ? s.last_rx_us : time_us_64()) - start;
+        uint32_t received = link1.stats.rx_bytes;
+        uint32_t missing = (int32_t)(s.tx_index - s.rx_index) > 0 ? s.tx_index - s.rx_index : 0;
+        uint32_t irq_us = link0.stats.irq_us + link1.stats.irq_us;
+        uint32_t irqs = link1.stats.rx_irqs + link0.stats.tx_dma_runs;
+
+        uint32_t lat_min, lat_avg, lat_max, lost;
+        measure_latency(&lat_min, &lat_avg, &lat_max, &lost);
+
+        uint32_t errors = s.errors + missing + lost + link1.stats.rx_dropped + link1.stats.rx_overrun +
+                          link1.stats.rx_framing + link1.stats.rx_parity + link1.stats.rx_break;
+        any_error |= errors != 0;
+
+        // 10 bits por byte em 8N1
+        printf("%8u %8u %8.1f %4.0f%% %4.1f%% %7lu %5lu/%4lu/%5lu %lu/%lu/%lu/%lu/%lu/%lu\n",
+               bench_bauds[b], baud, received * 1000.0 / elapsed_us,
+               received * 10.0 * 1e6 / elapsed_us * 100.0 / baud,
+               irq_us * 100.0 / elapsed_us, (unsigned long)irqs,
+               (unsigned long)lat_min, (unsigned long)lat_avg, (unsigned long)lat_max,
+               (unsigned long)(s.errors + missing + lost), (unsigned long)link1.stats.rx_dropped,
+               (unsigned long)link1.stats.rx_overrun, (unsigned long)link1.stats.rx_framing,
+               (unsigned long)link1.stats.rx_parity, (unsigned long)link1.stats.rx_break);
+    }
+
+    uart_ring_set_baudrate(&link0, BAUD_RATE);
+    uart_ring_set_baudrate(&link1, BAUD_RATE);
+    set_rgb_color(any_error, !any_error, 0);
+    printf("Latência em us para %d bytes; CPU = tempo nas IRQs dos dois lados\n\n", PING_LEN);
+}
+
+// Lado que recebe: cada mensagem traz o instante de envio e um contador
+typedef struct {
+    uint32_t next;
+    uint32_t lost;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+    uint32_t count;
+} link_bench_t;
+
+static void link_bench_handler(void *ctx, uint8_t type, const uint8_t *payload, uint32_t len) {
+    link_bench_t *b = ctx;
+    uint32_t sent_us, counter;
+    if (type != LINK_MSG_DATA || len != 8) return;
+    memcpy(&sent_us, payload, 4);
+    memcpy(&counter, payload + 4, 4);
+
+    uint32_t latency = time_us_32() - sent_us;
+    b->latency_sum_us += latency;
+    if (latency > b->latency_max_us) b->latency_max_us = latency;
+    if (counter != b->next) b->lost += counter - b->next;
+    b->next = counter + 1;
+    b->count++;
+}
+
+static void run_link_benchmark(void) {
+    uint baud = uart_ring_set_baudrate(&link0, LINK_BENCH_BAUD);
+    uart_ring_set_baudrate(&link1, LINK_BENCH_BAUD);
+    printf("\nBenchmark do link (COBS + CRC-16) a %u baud, mensagens de 8 bytes\n", baud);
+    printf("%9s %8s %8s %8s %9s %16s %s\n", "orçamento", "msg/s", "quadro/s", "msg/quad", "bytes/msg",
+           "latência méd/máx", "perdas/CRC/COBS/seq");
+    bool any_error = false;
+    set_rgb_color(0, 0, 1);
+
+    for (size_t i = 0; i < sizeof(link_budgets_us) / sizeof(link_budgets_us[0]); i++) {
+        link_bench_t bench = { 0 };
+        link_init(&frame_tx, &link0, link_budgets_us[i], NULL, NULL);
+        link_init(&frame_rx, &link1, 0, link_bench_handler, &bench);
+
+        uint32_t counter = 0;
+        uint64_t start = time_us_64();
+        uint64_t stop = start + BENCH_MS * 1000ull;
+        while (time_us_64() < stop) {
+            // Fila rasa: mede o que o link entrega, não o tempo parado no ring
+            if (uart_ring_tx_free(&link0) > RING_SIZE - LINK_BENCH_QUEUE) {
+                uint32_t msg[2] = { time_us_32(), counter };
+                if (link_send(&frame_tx, LINK_MSG_DATA, msg, sizeof(msg))) counter++;
+            }
+            link_poll(&frame_tx);
+            link_poll(&frame_rx);
+        }
+        link_flush(&frame_tx);
+        uint64_t drain_start = time_us_64();
+        while (bench.next != counter && time_us_64() - drain_start < DRAIN_TIMEOUT_US) {
+            link_poll(&frame_rx);
+        }
+        uint64_t elapsed_us = time_us_64() - start;
+        bench.lost += counter - bench.next;
+
+        const link_stats_t *tx = &frame_tx.stats;
+        const link_stats_t *rx = &frame_rx.stats;
+        any_error |= bench.lost || rx->crc_errors || rx->cobs_errors || rx->seq_gaps;
+        printf("%7lu us %8.0f %8.0f %8.1f %9.1f %7lu/%8lu %lu/%lu/%lu/%lu\n",
+               (unsigned long)link_budgets_us[i], bench.count * 1e6 / elapsed_us,
+               rx->frames_rx * 1e6 / elapsed_us,
+               tx->frames_tx ? (double)tx->msgs_tx / tx->frames_tx : 0.0,
+               tx->msgs_tx ? (double)tx->wire_bytes_tx / tx->msgs_tx : 0.0,
+               (unsigned long)(bench.count ? bench.latency_sum_us / bench.count : 0),
+               (unsigned long)bench.latency_max_us, (unsigned long)bench.lost,
+               (unsigned long)rx->crc_errors, (unsigned long)rx->cobs_errors,
+               (unsigned long)rx->seq_gaps);
+    }
+
+    uart_ring_set_baudrate(&link0, BAUD_RATE);
+    uart_ring_set_baudrate(&link1, BAUD_RATE);
+    set_rgb_color(any_error, !any_error, 0);
+    printf("Orçamento 0 = um quadro por mensagem; latência em us do envio à entrega\n\n");
+}
+
 int main() {
     // Inicializa o console USB e configura GPIOs
     stdio_init_all();
@@ -37,43 +270,47 @@ int main() {
     gpio_set_dir(LED_G_PIN, GPIO_OUT);
     gpio_set_dir(LED_B_PIN, GPIO_OUT);
 
-    // Configuração da UART0
-    uart_init(UART0_ID, BAUD_RATE);
+    // Configuração da UART0: RX por IRQ e TX por DMA
+    if (!uart_ring_init(&link0, UART0_ID, BAUD_RATE, uart0_rx_buf, RING_SIZE, uart0_tx_buf, RING_SIZE)) {
+        printf("Falha ao iniciar a UART0\n");
+    }
     gpio_set_function(UART0_TX_PIN, GPIO_FUNC_UART); // Configura TX para UART0
     gpio_set_function(UART0_RX_PIN, GPIO_FUNC_UART); // Configura RX para UART0
 
     // Configuração da UART1
-    uart_init(UART1_ID, BAUD_RATE);
+    if (!uart_ring_init(&link1, UART1_ID, BAUD_RATE, uart1_rx_buf, RING_SIZE, uart1_tx_buf, RING_SIZE)) {
+        printf("Falha ao iniciar a UART1\n");
+    }
     gpio_set_function(UART1_TX_PIN, GPIO_FUNC_UART); // Configura TX para UART1
     gpio_set_function(UART1_RX_PIN, GPIO_FUNC_UART); // Configura RX para UART1
 
     printf("UART0 -> UART1 Comunicação inicializada.\n");
+    printf("Digite um caractere para enviar ('#' benchmark da UART, '$' benchmark do link)\n");
 
     while (true) {
-        // Solicita entrada de dados via console USB
-        printf("Digite um caractere para enviar: ");
-        char input_char;
-        scanf(" %c", &input_char);
-
-        // Acende a cor azul para indicar envio
-        set_rgb_color(1, 0, 0);
-        sleep_ms(50);
+        // Entrada do console USB sem bloquear
+        int c = getchar_timeout_us(0);
+        if (c == '#') {
+            run_benchmark();
+        } else if (c == '$') {
+            run_link_benchmark();
+        } else if (c > ' ' && c < 0x7f) {
+            char input_char = (char)c;
 
-        // Envia o dado de UART0 para UART1
-        uart_putc(UART1_ID, input_char);
-        printf("Dado '%c' enviado via UART0 -> UART1.\n", input_char);
+            // Acende o LED para indicar envio
+            set_rgb_color(1, 0, 0);
 
+            // Envia o dado de UART0 para UART1
+            uart_ring_write(&link0, &input_char, 1);
+            printf("Dado '%c' enviado via UART0 -> UART1.\n", input_char);
+        }
 
-        // Aguarda o dado ser recebido pela UART1
-        if (uart_is_readable(UART1_ID)) {
-            char received_char = uart_getc(UART1_ID);
-
-            // Exibe o dado recebido no console USB
+        // Exibe o que a UART1 recebeu, sem esperar por byte
+        char received_char;
+        while (uart_ring_read(&link1, &received_char, 1)) {
             printf("Dado recebido pela UART1: '%c'\n", received_char);
+            set_rgb_color(0, 0, 0);
         }
-
-        // Apaga o LED após processar
-        set_rgb_color(0, 0, 0);
     }
 
     return 0;
@@ -0,0 +1,220 @@
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "link.h"
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), o mesmo do
+// binascii.crc_hqx(data, 0xFFFF) no Python
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7, 0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6, 0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485, 0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4, 0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823, 0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12, 0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41, 0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70, 0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f, 0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e, 0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d, 0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c, 0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab, 0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a, 0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9, 0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8, 0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+static inline uint16_t crc16_byte(uint16_t crc, uint8_t b) {
+    return (uint16_t)(crc << 8) ^ crc16_table[(crc >> 8) ^ b];
+}
+
+// COBS no próprio ring: o byte 0 é o código do primeiro bloco e cada zero
+// dos dados vira o código do bloco seguinte. Com no máximo 254 bytes o
+// código nunca passa de 0xFF e o quadro cresce só 1 byte.
+static void cobs_encode_tx(uart_ring_t *r, uint32_t len) {
+    uint32_t code_pos = 0;
+    uint8_t code = 1;
+    for (uint32_t i = 1; i <= len; i++) {
+        uint8_t *b = uart_ring_tx_at(r, i);
+        if (*b == 0) {
+            *uart_ring_tx_at(r, code_pos) = code;
+            code_pos = i;
+            code = 1;
+        } else {
+            code++;
+        }
+    }
+    *uart_ring_tx_at(r, code_pos) = code;
+    *uart_ring_tx_at(r, len + 1) = 0;
+}
+
+// Decodifica os len bytes no começo do RX para o mesmo lugar (a saída
+// anda sempre atrás da entrada). Retorna o tamanho decodificado ou -1.
+static int32_t cobs_decode_rx(uart_ring_t *r, uint32_t len) {
+    uint32_t in = 0;
+    uint32_t out = 0;
+    while (in < len) {
+        uint8_t code = *uart_ring_rx_at(r, in++);
+        if (code == 0 || in + code - 1 > len) return -1;
+        for (uint8_t k = 1; k < code; k++) {
+            *uart_ring_rx_at(r, out++) = *uart_ring_rx_at(r, in++);
+        }
+        if (code != 0xFF && in < len) {
+            *uart_ring_rx_at(r, out++) = 0;
+        }
+    }
+    return (int32_t)out;
+}
+
+void link_init(link_t *l, uart_ring_t *ring, uint32_t budget_us, link_handler_t handler, void *ctx) {
+    memset(l, 0, sizeof(*l));
+    l->ring = ring;
+    l->budget_us = budget_us;
+    l->handler = handler;
+    l->ctx = ctx;
+}
+
+void link_flush(link_t *l) {
+    if (!l->open_len) return;
+    uart_ring_t *r = l->ring;
+
+    uint16_t crc = 0xFFFF;
+    for (uint32_t i = 1; i <= l->open_len; i++) {
+        crc = crc16_byte(crc, *uart_ring_tx_at(r, i));
+    }
+    *uart_ring_tx_at(r, l->open_len + 1) = (uint8_t)crc;
+    *uart_ring_tx_at(r, l->open_len + 2) = (uint8_t)(crc >> 8);
+
+    uint32_t frame_len = l->open_len + 2;
+    cobs_encode_tx(r, frame_len);
+    uart_ring_tx_commit(r, frame_len + 2);
+
+    l->stats.frames_tx++;
+    l->stats.wire_bytes_tx += frame_len + 2;
+    l->open_len = 0;
+}
+
+bool link_send(link_t *l, uint8_t type, const void *payload, uint32_t len) {
+    if (len > LINK_MAX_PAYLOAD) return false;
+    uart_ring_t *r = l->ring;
+
+    // Não cabe no quadro aberto (seq + mensagens + CRC <= 254): fecha ele
+    if (l->open_len && l->open_len + 2 + len + 2 > LINK_MAX_FRAME) {
+        link_flush(l);
+    }
+    uint32_t needed = (l->open_len ? l->open_len + 1 : 2) + 2 + len + 3; // + CRC e delimitador
+    if (needed > uart_ring_tx_free(r)) {
+        l->stats.send_full++;
+        return false;
+    }
+
+    if (!l->open_len) {
+        *uart_ring_tx_at(r, 1) = l->tx_seq++;
+        l->open_len = 1;
+        l->open_since_us = time_us_32();
+    }
+    uint32_t pos = l->open_len + 1;
+    *uart_ring_tx_at(r, pos) = (uint8_t)len;
+    *uart_ring_tx_at(r, pos + 1) = type;
+    const uint8_t *src = payload;
+    for (uint32_t i = 0; i < len; i++) {
+        *uart_ring_tx_at(r, pos + 2 + i) = src[i];
+    }
+    l->open_len += 2 + len;
+    l->stats.msgs_tx++;
+
+    // Linha parada: esperar não junta nada
+    if (!l->budget_us || r->tx_head == r->tx_tail) {
+        link_flush(l);
+    }
+    return true;
+}
+
+// Quadro decodificado no começo do RX: confere e entrega as mensagens
+static void deliver(link_t *l, uint32_t len) {
+    uart_ring_t *r = l->ring;
+    if (len < 3) {
+        l->stats.cobs_errors++;
+        return;
+    }
+    uint16_t crc = 0xFFFF;
+    for (uint32_t i = 0; i < len - 2; i++) {
+        crc = crc16_byte(crc, *uart_ring_rx_at(r, i));
+    }
+    uint16_t got = *uart_ring_rx_at(r, len - 2) | (*uart_ring_rx_at(r, len - 1) << 8);
+    if (crc != got) {
+        l->stats.crc_errors++;
+        return;
+    }
+
+    uint8_t seq = *uart_ring_rx_at(r, 0);
+    if (l->rx_seq_valid && seq != (uint8_t)(l->rx_seq + 1)) {
+        l->stats.seq_gaps += (uint8_t)(seq - l->rx_seq - 1);
+    }
+    l->rx_seq = seq;
+    l->rx_seq_valid = true;
+    l->stats.frames_rx++;
+
+    uint32_t pos = 1;
+    while (pos + 2 <= len - 2) {
+        uint32_t msg_len = *uart_ring_rx_at(r, pos);
+        uint8_t type = *uart_ring_rx_at(r, pos + 1);
+        if (pos + 2 + msg_len > len - 2) {
+            l->stats.cobs_errors++;
+            return;
+        }
+        // O payload normalmente é contíguo no ring; só o que cruza o fim
+        // do buffer é copiado
+        const uint8_t *payload = uart_ring_rx_at(r, pos + 2);
+        uint8_t bounce[LINK_MAX_PAYLOAD];
+        if (payload + msg_len > r->rx_buf + r->rx_mask + 1) {
+            for (uint32_t i = 0; i < msg_len; i++) {
+                bounce[i] = *uart_ring_rx_at(r, pos + 2 + i);
+            }
+            payload = bounce;
+        }
+        l->stats.msgs_rx++;
+        if (l->handler) l->handler(l->ctx, type, payload, msg_len);
+        pos += 2 + msg_len;
+    }
+}
+
+void link_poll(link_t *l) {
+    uart_ring_t *r = l->ring;
+
+    if (l->open_len && (r->tx_head == r->tx_tail || time_us_32() - l->open_since_us >= l->budget_us)) {
+        link_flush(l);
+    }
+
+    // Procura o delimitador a partir de onde parou na última vez
+    uint32_t available = uart_ring_rx_available(r);
+    while (l->rx_scanned < available) {
+        if (*uart_ring_rx_at(r, l->rx_scanned) != 0) {
+            l->rx_scanned++;
+            if (l->rx_scanned >= LINK_MAX_WIRE) {
+                // Lixo sem delimitador: descarta e espera o próximo zero
+                l->stats.cobs_errors++;
+                uart_ring_rx_consume(r, l->rx_scanned);
+                available -= l->rx_scanned;
+                l->rx_scanned = 0;
+            }
+            continue;
+        }
+        uint32_t wire_len = l->rx_scanned;
+        if (wire_len) {
+            int32_t len = cobs_decode_rx(r, wire_len);
+            if (len < 0) {
+                l->stats.cobs_errors++;
+            } else {
+                deliver(l, (uint32_t)len);
+            }
+        }
+        uart_ring_rx_consume(r, wire_len + 1);
+        available -= wire_len + 1;
+        l->rx_scanned = 0;
+    }
+}
+
+void link_reset_stats(link_t *l) {
+    memset(&l->stats, 0, sizeof(l->stats));
+}
@@ -0,0 +1,81 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "uart_ring.h"
+
+// Camada de enlace sobre uart_ring: várias mensagens curtas por quadro,
+// CRC e número de sequência, quadros delimitados por COBS.
+//
+// Quadro antes do COBS (no máximo 254 bytes, então o COBS acrescenta
+// sempre exatamente 1 byte):
+//   seq u8
+//   mensagens: len u8, type u8, payload[len]   (repetidas)
+//   CRC-16/CCITT-FALSE u16 little endian, sobre tudo o que vem antes
+// No fio: COBS(quadro) seguido de 0x00. tools/link_codec.py é o mesmo
+// codec no PC.
+//
+// O quadro é montado direto no espaço livre do ring de TX, depois do head,
+// e codificado ali mesmo; só então é entregue ao DMA. Na recepção o quadro
+// é decodificado no próprio ring de RX. O link passa a ser o único a
+// escrever no TX e a ler do RX do seu uart_ring.
+
+#define LINK_MAX_FRAME 254           // Quadro antes do COBS
+#define LINK_MAX_PAYLOAD (LINK_MAX_FRAME - 1 - 2 - 2) // seq, len+type, CRC
+#define LINK_MAX_WIRE (LINK_MAX_FRAME + 2) // Código COBS + delimitador
+
+// Chamada pelo link_poll para cada mensagem recebida. O payload só vale
+// durante a chamada.
+typedef void (*link_handler_t)(void *ctx, uint8_t type, const uint8_t *payload, uint32_t len);
+
+typedef struct {
+    uint32_t frames_tx;
+    uint32_t msgs_tx;
+    uint32_t wire_bytes_tx;
+    uint32_t send_full;              // link_send recusado: ring de TX sem espaço
+    uint32_t frames_rx;
+    uint32_t msgs_rx;
+    uint32_t crc_errors;
+    uint32_t cobs_errors;            // Quadro malformado ou grande demais
+    uint32_t seq_gaps;               // Quadros perdidos pelo número de sequência
+} link_stats_t;
+
+typedef struct {
+    uart_ring_t *ring;
+    uint32_t budget_us;              // Atraso máximo de uma mensagem na fila
+    link_handler_t handler;
+    void *ctx;
+
+    // Quadro aberto no ring de TX: bytes 1..open_len depois do head (o byte
+    // 0 fica para o código COBS)
+    uint32_t open_len;
+    uint32_t open_since_us;
+    uint8_t tx_seq;
+
+    uint32_t rx_scanned;             // Bytes já vistos sem delimitador
+    uint8_t rx_seq;
+    bool rx_seq_valid;
+
+    link_stats_t stats;
+} link_t;
+
+// budget_us = 0 manda cada mensagem em um quadro próprio. Com orçamento, a
+// mensagem sai logo se a linha estiver livre; se não, junta-se às
+// seguintes até o quadro encher ou o orçamento vencer.
+void link_init(link_t *l, uart_ring_t *ring, uint32_t budget_us, link_handler_t handler, void *ctx);
+
+// Enfileira uma mensagem; false se não couber (payload grande demais ou
+// ring de TX cheio). Não bloqueia.
+bool link_send(link_t *l, uint8_t type, const void *payload, uint32_t len);
+
+// Fecha e envia o quadro aberto agora
+void link_flush(link_t *l);
+
+// Envia o quadro aberto se for a hora e entrega as mensagens recebidas.
+// Chamar no loop principal.
+void link_poll(link_t *l);
+
+void link_reset_stats(link_t *l);
+
+#endif // LINK_H
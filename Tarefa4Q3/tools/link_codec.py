@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""Host side of the COBS link layer in link.c.
+
+Frame before COBS (at most 254 bytes):
+  seq u8, then messages (len u8, type u8, payload), then
+  CRC-16/CCITT-FALSE of everything before it, little endian
+On the wire: COBS(frame) followed by 0x00.
+
+  link_codec.py selftest            round trips and corruption checks
+  link_codec.py encode 7 1:0102 2:  frame with seq 7 and two messages, as hex
+  link_codec.py decode <hex>        messages in a captured byte stream
+
+Import it from test scripts: encode_frame(), Decoder.feed().
+"""
+
+import argparse
+import binascii
+import random
+import sys
+
+MAX_FRAME = 254
+MAX_PAYLOAD = MAX_FRAME - 1 - 2 - 2
+
+
+def crc16(data):
+    return binascii.crc_hqx(bytes(data), 0xFFFF)
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_pos, code = 0, 1
+    for i, b in enumerate(data):
+        if b == 0:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+        else:
+            out.append(b)
+            code += 1
+            # A full block only opens another if input remains, as in link.c
+            if code == 0xFF and i + 1 < len(data):
+                out[code_pos] = code
+                code_pos, code = len(out), 1
+                out.append(0)
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(seq, messages):
+    """messages: list of (type, payload); returns the bytes on the wire"""
+    frame = bytearray([seq & 0xFF])
+    for kind, payload in messages:
+        if len(payload) > MAX_PAYLOAD:
+            raise ValueError("payload too large")
+        frame += bytes([len(payload), kind]) + payload
+    if len(frame) + 2 > MAX_FRAME:
+        raise ValueError("frame too large")
+    frame += crc16(frame).to_bytes(2, "little")
+    return cobs_encode(frame) + b"\0"
+
+
+class Decoder:
+    """Feed it bytes as they arrive; returns (seq, [(type, payload)]) frames"""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.crc_errors = 0
+        self.cobs_errors = 0
+        self.seq_gaps = 0
+        self.last_seq = None
+
+    def feed(self, data):
+        frames = []
+        self.buf += data
+        while True:
+            end = self.buf.find(0)
+            if end < 0:
+                if len(self.buf) >= MAX_FRAME + 2:
+                    self.cobs_errors += 1
+                    self.buf.clear()
+                return frames
+            wire, self.buf = bytes(self.buf[:end]), self.buf[end + 1:]
+            if wire:
+                frame = self._frame(wire)
+                if frame:
+                    frames.append(frame)
+
+    def _frame(self, wire):
+        try:
+            frame = cobs_decode(wire)
+        except ValueError:
+            self.cobs_errors += 1
+            return None
+        if len(frame) < 3:
+            self.cobs_errors += 1
+            return None
+        body, crc = frame[:-2], int.from_bytes(frame[-2:], "little")
+        if crc16(body) != crc:
+            self.crc_errors += 1
+            return None
+        seq = body[0]
+        if self.last_seq is not None and seq != (self.last_seq + 1) & 0xFF:
+            self.seq_gaps += (seq - self.last_seq - 1) & 0xFF
+        self.last_seq = seq
+
+        messages = []
+        pos = 1
+        while pos + 2 <= len(body):
+            length, kind = body[pos], body[pos + 1]
+            if pos + 2 + length > len(body):
+                self.cobs_errors += 1
+                return None
+            messages.append((kind, bytes(body[pos + 2:pos + 2 + length])))
+            pos += 2 + length
+        return seq, messages
+
+
+def selftest():
+    rng = random.Random(1)
+    failures = 0
+
+    def check(cond, what):
+        nonlocal failures
+        if not cond:
+            failures += 1
+            print("FAIL " + what)
+
+    # COBS edge cases: zeros everywhere, 254 non-zero bytes
+    for data in (b"", b"\0", b"\0\0", b"\1" * 254, b"\1" * 253 + b"\0", bytes(range(256))[:254]):
+        enc = cobs_encode(data)
+        check(0 not in enc, f"no zero in COBS of {data[:8].hex()}")
+        check(cobs_decode(enc) == data, f"COBS round trip of {data[:8].hex()}")
+        check(len(enc) == len(data) + 1, f"COBS overhead of {data[:8].hex()}")
+
+    # A full frame without zeros is the longest on the wire: it must fit the
+    # receive buffer when it arrives a byte at a time
+    fill = next(f for f in range(1, 256)
+                if 0 not in encode_frame(1, [(1, bytes([f]) * MAX_PAYLOAD)])[:-1])
+    wire = encode_frame(1, [(1, bytes([fill]) * MAX_PAYLOAD)])
+    check(len(wire) == MAX_FRAME + 2, "full zero-free frame is 254 + 2 bytes on the wire")
+    dec = Decoder()
+    got = []
+    for b in wire:
+        got += dec.feed(bytes([b]))
+    check(got == [(1, [(1, bytes([fill]) * MAX_PAYLOAD)])], "full zero-free frame fed byte by byte")
+
+    # Random batches through a byte stream cut at random points
+    dec = Decoder()
+    sent = []
+    stream = bytearray()
+    seq = 0
+    while len(sent) < 2000:
+        batch, size = [], 3
+        while True:
+            payload = bytes(rng.choice((0, rng.randrange(256))) for _ in range(rng.randrange(0, 40)))
+            if size + 2 + len(payload) > MAX_FRAME or (batch and rng.random() < 0.3):
+                break
+            batch.append((rng.randrange(256), payload))
+            size += 2 + len(payload)
+        stream += encode_frame(seq, batch)
+        sent += batch
+        seq += 1
+    received = []
+    pos = 0
+    while pos < len(stream):
+        step = rng.randrange(1, 300)
+        for _, msgs in dec.feed(stream[pos:pos + step]):
+            received += msgs
+        pos += step
+    check(received == sent, "random batches round trip")
+    check(dec.crc_errors == dec.cobs_errors == dec.seq_gaps == 0, "no errors on a clean stream")
+
+    # A flipped bit is caught by the CRC, a dropped frame by the sequence
+    frames = [encode_frame(s, [(1, bytes([s]) * 8)]) for s in range(10)]
+    dec = Decoder()
+    bad = bytearray(frames[3])
+    bad[4] ^= 0x10
+    got = dec.feed(b"".join(frames[:3]) + bytes(bad) + b"".join(frames[5:]))
+    check(len(got) == 8, "corrupted and missing frames are not delivered")
+    check(dec.crc_errors + dec.cobs_errors == 1, "corruption counted once")
+    check(dec.seq_gaps == 2, "two frames missing by sequence")
+
+    print("selftest " + ("passed" if not failures else f"failed ({failures})"))
+    return 1 if failures else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("selftest")
+    enc = sub.add_parser("encode")
+    enc.add_argument("seq", type=int)
+    enc.add_argument("messages", nargs="*", help="type:hexpayload")
+    dec = sub.add_parser("decode")
+    dec.add_argument("hex")
+    args = parser.parse_args()
+
+    if args.command == "selftest":
+        sys.exit(selftest())
+    if args.command == "encode":
+        msgs = []
+        for m in args.messages:
+            kind, _, payload = m.partition(":")
+            msgs.append((int(kind, 0), bytes.fromhex(payload)))
+        print(encode_frame(args.seq, msgs).hex())
+        return
+    d = Decoder()
+    for seq, msgs in d.feed(bytes.fromhex(args.hex)):
+        print(f"seq {seq}: " + ", ".join(f"type {k} [{p.hex()}]" for k, p in msgs))
+    print(f"crc errors {d.crc_errors}, cobs errors {d.cobs_errors}, sequence gaps {d.seq_gaps}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,262 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "uart_ring.h"
+
+#define RX_ERROR_BITS (UART_UARTDR_OE_BITS | UART_UARTDR_BE_BITS | UART_UARTDR_PE_BITS | UART_UARTDR_FE_BITS)
+#define UART_RTMIS_BITS 0x40u // Interrupção de linha parada (receive timeout)
+
+// Um ring por UART, indexado por uart_get_index
+static uart_ring_t *rings[2];
+static bool dma_irq_installed = false;
+
+static bool is_pow2(uint32_t n) {
+    return n && !(n & (n - 1));
+}
+
+// Inicia o DMA com tudo que estiver pendente. Chamada com interrupções
+// desligadas ou de dentro da IRQ do DMA.
+static void tx_start(uart_ring_t *r) {
+    uint32_t pending = r->tx_head - r->tx_tail;
+    if (r->tx_in_flight || !pending) return;
+
+    // O modo ring do DMA faz a leitura voltar ao início do buffer sozinha
+    r->tx_in_flight = pending;
+    dma_channel_set_read_addr(r->tx_dma, &r->tx_buf[r->tx_tail & r->tx_mask], false);
+    dma_channel_set_trans_count(r->tx_dma, pending, true);
+    r->stats.tx_dma_runs++;
+}
+
+static void tx_kick(uart_ring_t *r) {
+    uint32_t irq = save_and_disable_interrupts();
+    tx_start(r);
+    restore_interrupts(irq);
+}
+
+// Fim de uma transferência: libera o espaço e já emenda a próxima
+static void dma_irq_handler(void) {
+    for (int i = 0; i < 2; i++) {
+        uart_ring_t *r = rings[i];
+        if (!r || !dma_channel_get_irq0_status(r->tx_dma)) continue;
+
+        uint32_t t0 = time_us_32();
+        dma_channel_acknowledge_irq0(r->tx_dma);
+        uint32_t free_before = uart_ring_tx_free(r);
+        r->tx_tail += r->tx_in_flight;
+        r->stats.tx_bytes += r->tx_in_flight;
+        r->tx_in_flight = 0;
+        tx_start(r);
+
+        if (r->tx_cb && free_before < r->tx_level && uart_ring_tx_free(r) >= r->tx_level) {
+            r->tx_cb(r->tx_ctx);
+        }
+        r->stats.irq_us += time_us_32() - t0;
+    }
+}
+
+// Esvazia a FIFO de hardware no ring; uma IRQ a cada meia FIFO ou quando a
+// linha para, nunca uma por byte
+static void rx_irq(uart_ring_t *r) {
+    uint32_t t0 = time_us_32();
+    uart_hw_t *hw = uart_get_hw(r->uart);
+    bool idle = hw->mis & UART_RTMIS_BITS;
+    uint32_t head = r->rx_head;
+    uint32_t received = 0;
+
+    while (!(hw->fr & UART_UARTFR_RXFE_BITS)) {
+        uint32_t dr = hw->dr;
+        if (dr & RX_ERROR_BITS) {
+            if (dr & UART_UARTDR_OE_BITS) r->stats.rx_overrun++;
+            if (dr & UART_UARTDR_FE_BITS) r->stats.rx_framing++;
+            if (dr & UART_UARTDR_PE_BITS) r->stats.rx_parity++;
+            if (dr & UART_UARTDR_BE_BITS) {
+                r->stats.rx_break++;
+                continue; // Break não é dado
+            }
+        }
+        if (head - r->rx_tail > r->rx_mask) {
+            r->stats.rx_dropped++;
+            continue;
+        }
+        r->rx_buf[head & r->rx_mask] = (uint8_t)dr;
+        head++;
+        received++;
+    }
+    r->rx_head = head;
+    r->stats.rx_bytes += received;
+    r->stats.rx_irqs++;
+
+    uint32_t available = head - r->rx_tail;
+    if (r->rx_cb && available && (available >= r->rx_level || idle)) {
+        r->rx_cb(r->rx_ctx);
+    }
+    r->stats.irq_us += time_us_32() - t0;
+}
+
+static void uart0_irq_handler(void) {
+    rx_irq(rings[0]);
+}
+
+static void uart1_irq_handler(void) {
+    rx_irq(rings[1]);
+}
+
+bool uart_ring_init(uart_ring_t *r, uart_inst_t *uart, uint baud,
+                    uint8_t *rx_buf, uint32_t rx_size, uint8_t *tx_buf, uint32_t tx_size) {
+    if (!is_pow2(rx_size) || !is_pow2(tx_size) || tx_size > 32768 ||
+        ((uintptr_t)tx_buf & (tx_size - 1))) {
+        return false;
+    }
+    int dma = dma_claim_unused_channel(false);
+    if (dma < 0) return false;
+
+    memset(r, 0, sizeof(*r));
+    r->uart = uart;
+    r->rx_buf = rx_buf;
+    r->rx_mask = rx_size - 1;
+    r->tx_buf = tx_buf;
+    r->tx_mask = tx_size - 1;
+    r->tx_ring_bits = __builtin_ctz(tx_size);
+    r->tx_dma = dma;
+    r->rx_level = 1;
+    r->baud = uart_init(uart, baud);
+    uart_set_fifo_enabled(uart, true);
+
+    // TX: bytes do ring direto para o registrador de dados, no ritmo do DREQ
+    dma_channel_config c = dma_channel_get_default_config(dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, r->tx_ring_bits);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, true));
+    dma_channel_configure(dma, &c, &uart_get_hw(uart)->dr, tx_buf, 0, false);
+    dma_channel_set_irq0_enabled(dma, true);
+
+    uint index = uart_get_index(uart);
+    rings[index] = r;
+    if (!dma_irq_installed) {
+        irq_add_shared_handler(DMA_IRQ_0, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+        dma_irq_installed = true;
+    }
+
+    // RX: FIFO no nível escolhido + linha parada
+    uart_ring_set_rx_fifo_level(r, 2);
+    uart_get_hw(uart)->imsc = UART_UARTIMSC_RXIM_BITS | UART_UARTIMSC_RTIM_BITS;
+    uint irq = index ? UART1_IRQ : UART0_IRQ;
+    irq_set_exclusive_handler(irq, index ? uart1_irq_handler : uart0_irq_handler);
+    irq_set_enabled(irq, true);
+    return true;
+}
+
+uint uart_ring_set_baudrate(uart_ring_t *r, uint baud) {
+    while (!uart_ring_tx_idle(r)) {
+        tight_loop_contents();
+    }
+    r->baud = uart_set_baudrate(r->uart, baud);
+
+    // O que chegou durante a troca é lixo
+    uart_hw_t *hw = uart_get_hw(r->uart);
+    uint32_t irq = save_and_disable_interrupts();
+    while (!(hw->fr & UART_UARTFR_RXFE_BITS)) {
+        (void)hw->dr;
+    }
+    r->rx_tail = r->rx_head;
+    restore_interrupts(irq);
+    return r->baud;
+}
+
+void uart_ring_set_rx_fifo_level(uart_ring_t *r, uint level) {
+    if (level > 4) level = 4;
+    hw_write_masked(&uart_get_hw(r->uart)->ifls, level << UART_UARTIFLS_RXIFLSEL_LSB,
+                    UART_UARTIFLS_RXIFLSEL_BITS);
+}
+
+void uart_ring_set_rx_watermark(uart_ring_t *r, uint32_t level, uart_ring_cb_t cb, void *ctx) {
+    uint32_t irq = save_and_disable_interrupts();
+    r->rx_level = level ? level : 1;
+    r->rx_cb = cb;
+    r->rx_ctx = ctx;
+    restore_interrupts(irq);
+}
+
+void uart_ring_set_tx_watermark(uart_ring_t *r, uint32_t level, uart_ring_cb_t cb, void *ctx) {
+    uint32_t irq = save_and_disable_interrupts();
+    r->tx_level = level;
+    r->tx_cb = cb;
+    r->tx_ctx = ctx;
+    restore_interrupts(irq);
+}
+
+uint32_t uart_ring_tx_reserve(uart_ring_t *r, uint8_t **p) {
+    uint32_t head = r->tx_head;
+    uint32_t offset = head & r->tx_mask;
+    uint32_t free = uart_ring_tx_free(r);
+    uint32_t contiguous = r->tx_mask + 1 - offset;
+    *p = &r->tx_buf[offset];
+    return free < contiguous ? free : contiguous;
+}
+
+void uart_ring_tx_commit(uart_ring_t *r, uint32_t n) {
+    if (!n) return;
+    r->tx_head += n;
+    tx_kick(r);
+}
+
+uint32_t uart_ring_write(uart_ring_t *r, const void *data, uint32_t len) {
+    const uint8_t *src = data;
+    uint32_t free = uart_ring_tx_free(r);
+    if (len > free) len = free;
+
+    // No máximo dois trechos: até o fim do buffer e a volta ao início
+    uint32_t offset = r->tx_head & r->tx_mask;
+    uint32_t first = r->tx_mask + 1 - offset;
+    if (first > len) first = len;
+    memcpy(&r->tx_buf[offset], src, first);
+    memcpy(r->tx_buf, src + first, len - first);
+    uart_ring_tx_commit(r, len);
+    return len;
+}
+
+uint32_t uart_ring_rx_peek(uart_ring_t *r, const uint8_t **p) {
+    uint32_t tail = r->rx_tail;
+    uint32_t offset = tail & r->rx_mask;
+    uint32_t available = r->rx_head - tail;
+    uint32_t contiguous = r->rx_mask + 1 - offset;
+    *p = &r->rx_buf[offset];
+    return available < contiguous ? available : contiguous;
+}
+
+void uart_ring_rx_consume(uart_ring_t *r, uint32_t n) {
+    r->rx_tail += n;
+}
+
+uint32_t uart_ring_read(uart_ring_t *r, void *data, uint32_t max) {
+    uint8_t *dst = data;
+    uint32_t done = 0;
+    while (done < max) {
+        const uint8_t *p;
+        uint32_t n = uart_ring_rx_peek(r, &p);
+        if (!n) break;
+        if (n > max - done) n = max - done;
+        memcpy(dst + done, p, n);
+        uart_ring_rx_consume(r, n);
+        done += n;
+    }
+    return done;
+}
+
+bool uart_ring_tx_idle(const uart_ring_t *r) {
+    return r->tx_head == r->tx_tail && !r->tx_in_flight &&
+           !(uart_get_hw(r->uart)->fr & UART_UARTFR_BUSY_BITS);
+}
+
+void uart_ring_reset_stats(uart_ring_t *r) {
+    uint32_t irq = save_and_disable_interrupts();
+    memset(&r->stats, 0, sizeof(r->stats));
+    restore_interrupts(irq);
+}
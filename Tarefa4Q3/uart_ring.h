@@ -0,0 +1,121 @@
+#ifndef UART_RING_H
+#define UART_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hardware/uart.h"
+
+// UART com buffers circulares nos dois sentidos:
+//  - RX: a interrupção da UART (FIFO meio cheia ou linha parada) esvazia a
+//    FIFO de hardware no ring, contando erros de quadro/paridade/overrun.
+//  - TX: o DMA lê direto do ring (modo ring do DMA, sem cópia e sem CPU por
+//    byte); a CPU só age no fim de cada transferência para iniciar a próxima.
+// Um produtor e um consumidor por sentido: o loop principal e a IRQ.
+
+// Os dois rings precisam ter tamanho potência de 2 (até 32 KB) e, o de TX,
+// alinhamento igual ao tamanho por causa do modo ring do DMA:
+//   static uint8_t tx_buf[4096] UART_RING_ALIGNED(4096);
+#define UART_RING_ALIGNED(size) __attribute__((aligned(size)))
+
+// Chamada da IRQ quando um watermark é cruzado
+typedef void (*uart_ring_cb_t)(void *ctx);
+
+typedef struct {
+    volatile uint32_t rx_bytes;
+    volatile uint32_t rx_dropped;    // Ring de RX cheio: byte descartado
+    volatile uint32_t rx_overrun;    // FIFO de hardware estourou (OE)
+    volatile uint32_t rx_framing;    // FE
+    volatile uint32_t rx_parity;     // PE
+    volatile uint32_t rx_break;      // BE
+    volatile uint32_t rx_irqs;
+    volatile uint32_t tx_bytes;      // Já entregues à FIFO pelo DMA
+    volatile uint32_t tx_dma_runs;
+    volatile uint32_t irq_us;        // Tempo total dentro das IRQs deste ring
+} uart_ring_stats_t;
+
+typedef struct {
+    uart_inst_t *uart;
+    uint baud;                       // Baud real obtido do divisor
+
+    uint8_t *rx_buf;
+    uint32_t rx_mask;
+    volatile uint32_t rx_head;       // Escrito pela IRQ
+    volatile uint32_t rx_tail;       // Escrito pelo consumidor
+
+    uint8_t *tx_buf;
+    uint32_t tx_mask;
+    uint32_t tx_ring_bits;
+    volatile uint32_t tx_head;       // Escrito pelo produtor
+    volatile uint32_t tx_tail;       // Avança no fim de cada transferência
+    volatile uint32_t tx_in_flight;  // Bytes da transferência DMA atual
+    int tx_dma;
+
+    // Watermarks: RX avisa com pelo menos rx_level bytes no ring (ou quando
+    // a linha para com algo pendente); TX avisa quando o espaço livre volta
+    // a pelo menos tx_level bytes
+    uint32_t rx_level;
+    uart_ring_cb_t rx_cb;
+    void *rx_ctx;
+    uint32_t tx_level;
+    uart_ring_cb_t tx_cb;
+    void *tx_ctx;
+
+    uart_ring_stats_t stats;
+} uart_ring_t;
+
+// Inicializa a UART (os pinos ficam com quem chama) e liga a IRQ de RX e o
+// canal DMA de TX. Retorna false se os tamanhos forem inválidos ou não
+// houver canal DMA livre.
+bool uart_ring_init(uart_ring_t *r, uart_inst_t *uart, uint baud,
+                    uint8_t *rx_buf, uint32_t rx_size, uint8_t *tx_buf, uint32_t tx_size);
+
+// Troca o baud rate; espera o TX esvaziar e descarta o que houver no RX
+uint uart_ring_set_baudrate(uart_ring_t *r, uint baud);
+
+// Nível da FIFO de RX que gera interrupção: 0..4 = 1/8, 1/4, 1/2, 3/4, 7/8
+// de 32 bytes. Mais alto = menos IRQs, mais latência (a interrupção de
+// linha parada cobre o resto após 32 bits sem dados).
+void uart_ring_set_rx_fifo_level(uart_ring_t *r, uint level);
+
+void uart_ring_set_rx_watermark(uart_ring_t *r, uint32_t level, uart_ring_cb_t cb, void *ctx);
+void uart_ring_set_tx_watermark(uart_ring_t *r, uint32_t level, uart_ring_cb_t cb, void *ctx);
+
+// Cópia para o ring de TX; retorna quantos bytes couberam (não bloqueia)
+uint32_t uart_ring_write(uart_ring_t *r, const void *data, uint32_t len);
+
+// Cópia do ring de RX; retorna quantos bytes foram lidos (não bloqueia)
+uint32_t uart_ring_read(uart_ring_t *r, void *data, uint32_t max);
+
+// Acesso sem cópia. reserve devolve o trecho contíguo livre do TX, commit
+// entrega n bytes escritos nele ao DMA. peek devolve o trecho contíguo
+// recebido, consume libera n bytes dele.
+uint32_t uart_ring_tx_reserve(uart_ring_t *r, uint8_t **p);
+void uart_ring_tx_commit(uart_ring_t *r, uint32_t n);
+uint32_t uart_ring_rx_peek(uart_ring_t *r, const uint8_t **p);
+void uart_ring_rx_consume(uart_ring_t *r, uint32_t n);
+
+// Byte i depois do head do TX (ainda não entregue ao DMA) e depois do tail
+// do RX (ainda não consumido), com a volta do buffer. Para quem monta ou
+// desmonta dados direto no ring sem achar um trecho contíguo.
+static inline uint8_t *uart_ring_tx_at(uart_ring_t *r, uint32_t i) {
+    return &r->tx_buf[(r->tx_head + i) & r->tx_mask];
+}
+
+static inline uint8_t *uart_ring_rx_at(uart_ring_t *r, uint32_t i) {
+    return &r->rx_buf[(r->rx_tail + i) & r->rx_mask];
+}
+
+static inline uint32_t uart_ring_rx_available(const uart_ring_t *r) {
+    return r->rx_head - r->rx_tail;
+}
+
+static inline uint32_t uart_ring_tx_free(const uart_ring_t *r) {
+    return r->tx_mask + 1 - (r->tx_head - r->tx_tail);
+}
+
+// Tudo já saiu pelo pino (ring, FIFO e registrador de deslocamento vazios)
+bool uart_ring_tx_idle(const uart_ring_t *r);
+
+void uart_ring_reset_stats(uart_ring_t *r);
+
+#endif // UART_RING_H